@@ -25,7 +25,7 @@ import os
 
 class MeenRecipe(ConanFile):
     name = "meen"
-    version = "2.1.0"
+    version = "2.2.0"
     package_type = "library"
     test_package_folder = "tests/conan_package_test"
 
@@ -23,6 +23,8 @@ SOFTWARE.
 #ifndef BASE_H
 #define BASE_H
 
+#include <cstdint>
+
 namespace meen
 {
 	/** Interrupt service routines
@@ -54,6 +56,64 @@ namespace meen
 		Quit,					/**< Exit the IMachine::Run control loop */
 		NoInterrupt,			/**< No interrupt has occurred */
 	};
+
+	/** Watchpoint types
+
+		The type of guest memory access that triggers an armed watchpoint.
+
+		@see		IMachine::ArmWatchpoint
+	*/
+	enum class Watch
+	{
+		Read,					/**< The address was read from */
+		Write,					/**< The address was written to */
+		Exec					/**< An instruction was fetched from the address */
+	};
+
+	/** Machine command
+
+		A request posted to a running machine from any thread, see IMachine::PostCommand.
+
+		@since		version 2.2.0
+	*/
+	struct Command
+	{
+		enum class Type : uint8_t
+		{
+			Interrupt,			/**< Raise the interrupt in isr */
+			Save,				/**< Save the machine state */
+			Load,				/**< Load the machine state */
+			ClockSamplingFreq,	/**< Change the rate at which the clock is synchronised with the host, see the `clockSamplingFreq` option */
+			Pause,				/**< Pause the machine, see IMachine::Pause */
+			Quit				/**< Exit the IMachine::Run control loop */
+		};
+
+		Type type;						/**< The command */
+		ISR isr{ ISR::NoInterrupt };	/**< The interrupt to raise for Type::Interrupt */
+		double clockSamplingFreq{};		/**< The clock sampling frequency in Hertz for Type::ClockSamplingFreq, -1 runs the machine as fast as possible */
+	};
+
+	/** Cpu registers
+
+		The cpu registers that a trap handler can read and modify.
+
+		@see		IMachine::OnTrap
+
+		@since		version 2.2.0
+	*/
+	struct Registers
+	{
+		uint16_t pc;			/**< The return address of the trapped call */
+		uint16_t sp;			/**< The stack pointer */
+		uint8_t a;				/**< The accumulator */
+		uint8_t b;				/**< Register B */
+		uint8_t c;				/**< Register C */
+		uint8_t d;				/**< Register D */
+		uint8_t e;				/**< Register E */
+		uint8_t h;				/**< Register H */
+		uint8_t l;				/**< Register L */
+		uint8_t flags;			/**< The condition flags, the low byte of the program status word (PSW) */
+	};
 } // namespace meen
 
 #endif // BASE_H
\ No newline at end of file
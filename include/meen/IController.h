@@ -24,10 +24,13 @@ SOFTWARE.
 #define ICONTROLLER_H
 
 #include <array>
+#include <bitset>
 #include <cstdint>
 #include <memory>
+#include <span>
 
 #include "meen/Base.h"
+#include "meen/IScheduler.h"
 
 #ifdef _WINDOWS
 #if meen_STATIC
@@ -47,6 +50,14 @@ SOFTWARE.
 
 namespace meen
 {
+	/** Dirty page map
+
+		One bit for each 256 byte page of the 16 bit address space.
+
+		@see	IController::DirtyPages
+	*/
+	using DirtyPageMap = std::bitset<256>;
+
 	/** Device interface
 
 		An interface to a device that can interact with the cpu.
@@ -115,6 +126,112 @@ namespace meen
 		*/
 		virtual ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) = 0;
 
+		/** Dirty pages
+
+			Query the pages of this device that have been written to since
+			they were last cleared.
+
+			A controller that tracks dirty pages sets the bit of the 256 byte page
+			(address >> 8) that each Write lands in, reads are unaffected. The machine
+			clears the bits it has consumed, this allows a save to only read back the pages
+			that have changed since the last save instead of the entire address space.
+
+			@return				A pointer to the dirty page map owned by this controller or
+								nullptr (the default) when this controller does not track
+								dirty pages.
+
+			@remark				The returned map must remain valid for the lifetime of the controller.
+
+			@see				DirtyPageMap
+
+			@since				version 2.2.0
+		*/
+		virtual DirtyPageMap* DirtyPages() { return nullptr; }
+
+		/** Memory
+
+			Direct access to the backing store of a memory controller.
+
+			When the controller exposes its memory the machine transfers rom and ram blocks
+			to and from it with memcpy during loads and saves instead of calling Read and
+			Write for each byte. Bytes written this way are marked in the map returned
+			from DirtyPages.
+
+			@return				A span over the memory of this device starting at address 0 or
+								an empty span (the default) when the memory can only be accessed
+								via Read and Write.
+
+			@remark				The returned span must remain valid for the lifetime of the controller.
+
+			@since				version 2.2.0
+		*/
+		virtual std::span<uint8_t> Memory() { return {}; }
+
+		/** Memory view
+
+			Direct read only access to the backing store of a memory controller.
+
+			The machine reads rom and ram blocks from it with memcpy during saves instead of calling
+			Read for each byte, this allows a controller whose memory can not be written directly
+			(a read only mapping for example) to still be read directly.
+
+			@return				A read only span over the memory of this device starting at address 0 or
+								an empty span when the memory can only be read via Read. The default
+								implementation returns the span returned from Memory.
+
+			@remark				The returned span must remain valid for the lifetime of the controller.
+
+			@since				version 2.2.0
+		*/
+		virtual std::span<const uint8_t> MemoryView() { return Memory(); }
+
+		/** Set scheduler
+
+			Called with the machine event scheduler when the machine starts running and
+			with nullptr when it stops.
+
+			A controller that knows when it next needs to interrupt the cpu can schedule the
+			interrupt instead of reporting it from GenerateInterrupt, this allows the `isrFreq`
+			option to be lowered without losing cycle accurate interrupt delivery.
+
+			@param	scheduler	The scheduler of the machine this controller is attached to or nullptr.
+								The default implementation ignores it.
+
+			@see				IScheduler
+
+			@since				version 2.2.0
+		*/
+		virtual void SetScheduler([[maybe_unused]] IScheduler* scheduler) {}
+
+		/** Next poll
+
+			Called after each call to GenerateInterrupt to query when this controller next needs
+			attention.
+
+			A controller that knows it has nothing to report until a point in time, for example one
+			that generates an interrupt once per second, can return that time and the machine will
+			not poll it again until then instead of polling it at the rate set by the `isrFreq`
+			configuration option (or after each instruction by default).
+
+			@param	currTime	The time in nanoseconds of the machine clock, as passed to GenerateInterrupt.
+			@param	cycles		The total number of cycles that have elapsed, as passed to GenerateInterrupt.
+
+			@return				The machine clock time in nanoseconds at which this controller next needs to be polled
+								or 0 (the default) to be polled at the `isrFreq` rate. A time that has already passed
+								polls the controller after the next instruction. When the clock is throttled the controller
+								is polled at the first instruction boundary at which the machine time has reached this time.
+
+			@remark				A controller that returns a time must call IScheduler::Wake when it has work to report
+								before then, for example when a Write latches a request that is reported from
+								GenerateInterrupt. Interrupts due on a specific cycle should be scheduled via IScheduler::Schedule.
+
+			@remark				The IMachine::OnIdle handler is still called at the `isrFreq` rate when the io
+								controller returns a time.
+
+			@since				version 2.2.0
+		*/
+		virtual uint64_t NextPoll([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles) { return 0; }
+
 		/** Destroys the controller
 
 			Release all resources used by this controller instance.
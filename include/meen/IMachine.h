@@ -23,12 +23,14 @@ SOFTWARE.
 #ifndef IMACHINE_H
 #define IMACHINE_H
 
+#include <chrono>
 #include <expected>
 #include <functional>
 #include <system_error>
 
 #include "meen/Error.h"
 #include "meen/IController.h"
+#include "meen/RunAwaitable.h"
 
 namespace meen
 {
@@ -68,6 +70,72 @@ namespace meen
 		*/
 		virtual std::expected<uint64_t, std::error_code> Run() = 0;
 
+		/** Run the machine for a number of cycles
+
+			Execute instructions on the calling thread until the machine quits or the cycle budget is spent, whichever
+			comes first. When the budget is spent the run is suspended with all of its state intact, the next call to
+			IMachine::RunFor or IMachine::Run resumes it exactly where it stopped. A run that is not suspended starts
+			the same way as IMachine::Run.
+
+			@param	cycles			The number of cpu cycles to run for. The last instruction may overrun the budget, the
+									cycles it overran by are taken from the budget of the next call.
+
+			@remark					The run is always synchronous, the `runAsync` configuration option is ignored. The
+									IMachine::OnIdle handler is called as it is when `runAsync` is false.
+
+			@remark					A halted cpu lets the clock run to the end of the budget (or to its next interrupt).
+
+			@remark					While a run is suspended the machine is busy, the methods that return `busy` while
+									it is running also return `busy` until the run quits.
+
+			@remark					RunFor is intended for hosts that drive the machine from their own frame loop. These
+									would normally set the `clockSamplingFreq` option to -1 and pace the machine themselves.
+
+			@return					A `std::expected` with an expected value of true when the run was suspended and false
+									when the machine quit and an unexpected value of one of the MEEN std error codes
+									returned by IMachine::Run.
+
+			@since					version 2.2.0
+		*/
+		virtual std::expected<bool, std::error_code> RunFor(uint64_t cycles) = 0;
+
+		/** Run the machine for a duration
+
+			Run the machine for the number of cpu cycles that the emulated cpu executes in the duration
+			at its clock speed, see IMachine::RunFor(uint64_t). The fraction of a cycle that remains is
+			carried over to the next call so that calling it with a fixed duration per frame does not drift.
+
+			@param	duration		The emulated time to run for.
+
+			@return					A `std::expected` with an expected value of true when the run was suspended and false
+									when the machine quit and an unexpected value of invalid_argument when the duration
+									is negative or one of the MEEN std error codes returned by IMachine::Run.
+
+			@since					version 2.2.0
+		*/
+		virtual std::expected<bool, std::error_code> RunFor(std::chrono::nanoseconds duration) = 0;
+
+		/** Run the machine on an executor
+
+			Returns an awaitable that a coroutine can `co_await` to run the machine to completion on the
+			host supplied executor instead of a thread owned by the machine. The machine is run in slices
+			via IMachine::RunFor, each slice is a separate executor task so many machines can share a single
+			executor. The awaiting coroutine is resumed on the executor when the machine quits.
+
+			@param	executor		The executor that runs the machine slices.
+			@param	slice			The number of cpu cycles to run per executor task, 0 runs the machine to
+									completion in a single task.
+
+			@remark					The machine must not be used by any other thread until the awaiting coroutine is resumed.
+
+			@return					The RunAwaitable, awaiting it yields an empty std::error_code when the machine
+									quit, invalid_argument when the executor is empty or one of the MEEN std error codes
+									returned by IMachine::Run.
+
+			@since					version 2.2.0
+		*/
+		virtual RunAwaitable RunAwait(Executor&& executor, uint64_t slice) = 0;
+
 		/** Attach a custom memory controller
 
 			The machine will use this controller when it needs to read
@@ -159,6 +227,61 @@ namespace meen
 		*/
 		virtual std::expected<IControllerPtr, std::error_code> DetachIoController() = 0;
 
+		/** Attach an io controller to a range of ports
+
+			Compose a machine from reusable devices, the cpu IN and OUT instructions for the ports
+			in the range are routed to this controller instead of the controller attached via
+			IMachine::AttachIoController(IControllerPtr&&).
+
+			@param	controller			The io controller to attach.
+			@param	firstPort			The first port in the range.
+			@param	lastPort			The last port in the range (inclusive).
+			@param	isrFreq				The number of times per emulated cpu clock speed that IController::GenerateInterrupt
+										of this controller is polled, 0 polls it at the completion of each instruction unless
+										the controller returns a later time from IController::NextPoll.
+										This has the same meaning as the `isrFreq` configuration option, which only applies
+										to the default io controller.
+
+			@return					One of the following MEEN std error codes:
+
+			| MEEN error code         | Explanation                                                                 |
+			|:------------------------|:----------------------------------------------------------------------------|
+			| invalid_argument        | The controller is empty, the range is invalid, the range overlaps another   |
+			|                         | attached range or the isrFreq is negative                                   |
+			| busy                    | MEEN is currently running                                                   |
+
+			@remark					The routing is resolved into a flat port table once when the machine starts running,
+									it costs nothing per IN and OUT over a single io controller.
+
+			@remark					Ports mapped via IMachine::MapIoPort take precedence over the controller.
+
+			@remark					The IController* passed to the machine handlers remains the default io controller.
+
+			@sa					DetachIoController(uint8_t)
+
+			@since					version 2.2.0
+		*/
+		virtual std::error_code AttachIoController(IControllerPtr&& controller, uint8_t firstPort, uint8_t lastPort, double isrFreq) = 0;
+
+		/** Detach an io controller from a range of ports
+
+			Transfer ownership of a controller attached via IMachine::AttachIoController(IControllerPtr&&, uint8_t, uint8_t, double)
+			back to the caller, the ports in its range are routed to the default io controller.
+
+			@param	port				Any port in the range of the controller to detach.
+
+			@return					A `std::expected` with an expected value of a `std::unique_ptr` to the detached controller
+									and an unexpected value of one of the following MEEN std error codes:
+
+			| MEEN error code         | Explanation                                        |
+			|:------------------------|:---------------------------------------------------|
+			| io_controller           | No io controller is attached to the port           |
+			| busy                    | MEEN is currently running                          |
+
+			@since					version 2.2.0
+		*/
+		virtual std::expected<IControllerPtr, std::error_code> DetachIoController(uint8_t port) = 0;
+
 		/** Set machine options
 
 			See the `Configuration Options` section for a complete list of options and their defaults.
@@ -416,6 +539,11 @@ namespace meen
 			| file:// 		  | load a resource located at the path specifed by the remainder of the bytes property into memory |
 			| base64://               | base64 decode the remaining bytes and load them into memory.                                    |
 			| base64://zlib://	  | Decompress the remaining bytes, base64 decode them and load them into memory                    |
+			| memfd://                | The bytes already reside in the attached memory controller and are left untouched               |
+
+			The `memfd://` protocol is used to load the machine state into a MemfdController that maps the memory of
+			another machine. A rom block with `memfd://` bytes must specify its offset and size, the memory:ram bytes
+			can also be set to `memfd://`.
 
 			The size and offset parameters of memory:rom:[block] are optional and will default to 0 for the offset and the length of the remaining bytes in the bytes parameter for size.
 			NOTE: the size parameter is mandatory for "zlib://" and MUST be the length of the uncompressed bytes.
@@ -488,6 +616,14 @@ namespace meen
 			@remark						When the configuration option `runAsync` is false, this method should be lightweight
 										and non-blocking as superfluous delays here can have an impact on overall performace.
 
+			@remark						When the configuration option `runAsync` is false, the handler is called each time the io controller
+										is due to be serviced at the `isrFreq` rate, including when the io controller has asked not to be
+										polled until later via IController::NextPoll.
+
+			@remark						When the configuration option `runAsync` is true and the `idlePeriod` option is non zero, the handler is
+										called at least every `idlePeriod` milliseconds instead of continuously. It is called early when the
+										machine quits, a load or save completes or an io controller calls IScheduler::Wake.
+
 			@return						One of the following MEEN std error codes:
 
 			| MEEN error code         | Explanation                                     |
@@ -535,6 +671,396 @@ namespace meen
 		*/
 		virtual std::error_code OnError(std::function<void(std::error_code ec, const char* fileName, const char* functionName, uint32_t line, uint32_t column, IController* ioController)>&& onError) = 0;
 
+		/** Memory access profile
+
+			Read the memory access counters collected while the `memoryProfile` configuration option is enabled.
+
+			The `visitor` signature:
+
+			| Return Type      | Explanation                                    |
+			|:-----------------|------------------------------------------------|
+			| void             | The method does not return anything            |
+
+			| Parameter        | Explanation                                                                                  |
+			|:-----------------|:---------------------------------------------------------------------------------------------|
+			| address          | The guest address, or the first address of the 256 byte page when profiling per page         |
+			| reads            | The number of data reads made by the cpu                                                     |
+			| writes           | The number of data writes made by the cpu                                                    |
+			| fetches          | The number of instruction fetches made by the cpu                                            |
+
+			@param		visitor			Called once for each address or page that has been accessed at least once, in ascending
+										address order.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The profile was read successfully                |
+			| invalid_argument        | The visitor is nullptr                           |
+
+			@remark						Every cpu access is counted, the profile is exact rather than sampled. Counting adds
+										a load and a store to each memory access, the per address profile holds 1.5MB of
+										counters.
+
+			@remark						This method may be called from any thread while the machine is running, but the
+										counters are still being written then, so the counts of different addresses may be
+										from different points in time. The profile is only consistent once IMachine::Run
+										has returned. The counts accumulate across runs and are reset when the
+										`memoryProfile` option changes.
+
+			@remark						The visitor is not called when the `memoryProfile` option is `none`.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code MemoryProfile(std::function<void(uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)>&& visitor) = 0;
+
+		/** Arm a watchpoint
+
+			Watch a guest memory address for the specified type of access.
+
+			@param		address			The 16 bit guest address to watch.
+			@param		watch			The type of access to watch for, Watch::Read and Watch::Write
+										watch the data accesses made by the cpu, Watch::Exec watches
+										instruction fetches (an execution breakpoint).
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                              |
+			|:------------------------|:-----------------------------------------|
+			| no_error                | The watchpoint was armed successfully    |
+			| busy                    | MEEN is currently running                |
+			| invalid_argument        | The watch type is invalid                |
+
+			@remark						When no watchpoints are armed the cpu accesses the memory controller directly,
+										watchpoints have no impact on performance until they are armed.
+
+			@remark						Accesses made by MEEN itself when loading and saving the machine state do
+										not trigger watchpoints.
+
+			@see						IMachine::OnWatch
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code ArmWatchpoint(uint16_t address, Watch watch) = 0;
+
+		/** Disarm a watchpoint
+
+			Stop watching a guest memory address for the specified type of access.
+
+			@param		address			The 16 bit guest address to stop watching.
+			@param		watch			The type of access to stop watching for.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                              |
+			|:------------------------|:-----------------------------------------|
+			| no_error                | The watchpoint was disarmed successfully |
+			| busy                    | MEEN is currently running                |
+			| invalid_argument        | The watch type is invalid                |
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code DisarmWatchpoint(uint16_t address, Watch watch) = 0;
+
+		/** Machine on watch handler
+
+			Registers a handler that will be called when an armed watchpoint is hit.
+
+			The `onWatch` signature:
+
+			| Return Type      | Value | Explanation                              |
+			|:-----------------|:------|:-----------------------------------------|
+			| bool             | True  | Quit the running machine instance        |
+			| ^                | False | Continue running the machine             |
+
+			| Parameter        | Explanation                                                                                  |
+			|:-----------------|:---------------------------------------------------------------------------------------------|
+			| address          | The guest address that was accessed                                                          |
+			| watch            | The type of access that was made                                                             |
+			| ioController     | A pointer to the io controller that was attached via the IMachine::AttachIoController method |
+
+			@param		onWatch			The on watch handler to register.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The on watch handler was registered successfully |
+			| busy                    | MEEN is currently running                        |
+
+			@remark						The handler is invoked by the machine control loop at the next instruction boundary
+										after the instruction that made the access has completed, it does not interrupt the cpu.
+
+			@remark						When the `runAsync` configuration option is set to true, the handler will be called
+										from a different thread from which IMachine::Run was invoked.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code OnWatch(std::function<bool(uint16_t address, Watch watch, IController* ioController)>&& onWatch) = 0;
+
+		/** Machine on trap handler
+
+			Registers a handler that is run in place of the subroutine called at the given address,
+			allowing the subroutine to be emulated natively (high level emulation), for example the
+			CP/M BDOS entry point at address 5 (see CpmBdos).
+
+			The `onTrap` signature:
+
+			| Return Type      | Value | Explanation                                                                        |
+			|:-----------------|:------|:-----------------------------------------------------------------------------------|
+			| int              | >= 0  | The call was handled, the number of cycles it took in addition to the call and return |
+			| ^                | < 0   | The call was not handled, the cpu makes the call as normal                          |
+
+			| Parameter        | Explanation                                                                                      |
+			|:-----------------|:-------------------------------------------------------------------------------------------------|
+			| registers        | The cpu registers, `pc` holds the return address and `sp` the stack pointer before the call, any changes are written back to the cpu when the call is handled |
+			| memoryController | A pointer to the memory controller that was attached via the IMachine::AttachMemoryController method |
+
+			@param		address			The address of the subroutine to trap.
+			@param		onTrap			The on trap handler to register, nullptr to remove it.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                     |
+			|:------------------------|:------------------------------------------------|
+			| no_error                | The on trap handler was registered successfully |
+			| busy                    | MEEN is currently running                       |
+
+			@remark						Every call (CALL and the conditional calls that are taken) to the address is trapped
+										from any code, regardless of what resides at the address, until the handler is removed.
+										A handler that only services some of the calls, for example while the guest has not
+										loaded its own subroutine at the address, must return a negative value for the others.
+										Jumps to the address and interrupts execute the subroutine as normal.
+
+			@remark						Only one address can be trapped, registering a handler replaces the previous one.
+
+			@remark						The handler is called from the cpu thread in the middle of the call instruction.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code OnTrap(uint16_t address, std::function<int(Registers& registers, IController* memoryController)>&& onTrap) = 0;
+
+		/** Post an interrupt
+
+			Deliver an interrupt to the machine from any thread.
+
+			Controllers that are fed by host threads (a keyboard, a serial port or a timer for example)
+			can post their interrupts directly to the machine instead of latching them until the next
+			time IController::GenerateInterrupt is polled. Posting is lock free, the machine control loop
+			checks the mailbox after each instruction and delivers the pending interrupts in ascending
+			order (ISR::Zero through ISR::Seven followed by ISR::Save, ISR::Load and ISR::Quit).
+
+			@param		isr				The interrupt to post.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The interrupt was posted successfully            |
+			| invalid_argument        | The isr is ISR::NoInterrupt or is invalid        |
+
+			@remark						Posting an interrupt that is already pending has no effect.
+
+			@remark						Interrupts posted while the machine is not running remain pending until it next runs.
+
+			@remark						Cpu level interrupts are latched by the interrupt controller the same way as
+										those returned from IController::GenerateInterrupt.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code PostInterrupt(ISR isr) = 0;
+
+		/** Pause the machine
+
+			Request the running machine to pause at the next instruction boundary. The run loop waits in place
+			with the cpu, clock and cycle counts intact until IMachine::Resume is called, the time spent paused
+			is excluded from the machine time.
+
+			@remark						This method may be called from any thread and returns without waiting for the machine
+										to pause. A pause only applies to the run in progress, one requested while the machine
+										is not running is dropped when the next run starts.
+
+			@remark						A paused machine can only be resumed from a thread other than the one running the machine.
+										It stops waiting when an ISR::Quit interrupt or a Quit command is posted and when the
+										IMachine::OnIdle handler quits the machine. The handler is still called while a synchronous
+										run is paused, once every `idlePeriod` milliseconds.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The pause was requested successfully             |
+			| not_implemented         | Pausing is not supported on this platform        |
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code Pause() = 0;
+
+		/** Post a command
+
+			Queue a command for the machine from any thread. The commands are kept in a bounded lock free
+			queue that the run loop drains in the order they were posted each time it services its events,
+			at the latest after the instruction that is executing when the command is posted.
+
+			Interrupt, Save, Load and Quit commands are serviced the same way as the interrupts returned from
+			IController::GenerateInterrupt. A Pause command pauses the machine at the point it is drained, it
+			must still be resumed via IMachine::Resume.
+
+			@param		command			The command to post.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                                |
+			|:------------------------|:-----------------------------------------------------------|
+			| no_error                | The command was queued successfully                        |
+			| busy                    | The queue is full, the command was not queued              |
+			| invalid_argument        | The command type is unknown or its isr is ISR::NoInterrupt |
+
+			@remark						Commands posted while the machine is not running remain queued until it next runs.
+
+			@remark						When a command quits the machine the commands behind it remain queued.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code PostCommand(const Command& command) = 0;
+
+		/** Resume the machine
+
+			Resume a machine that was paused via IMachine::Pause, it carries on from the instruction
+			boundary it paused at. Resuming a machine that is not paused has no effect.
+
+			@remark						This method may be called from any thread.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The machine was resumed successfully             |
+			| not_implemented         | Pausing is not supported on this platform        |
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code Resume() = 0;
+
+		/** Set the interrupt mask
+
+			The machine latches each cpu level interrupt (ISR::Zero to ISR::Seven), whether it is returned from
+			IController::GenerateInterrupt, scheduled via IScheduler or posted via IMachine::PostInterrupt, in an
+			8259 style interrupt controller. The highest priority unmasked pending interrupt is delivered to the cpu
+			as soon as it has interrupts enabled (after the instruction following EI), interrupts raised while the
+			cpu has interrupts disabled remain pending instead of being dropped.
+
+			@param		mask			A bit mask of the interrupts to hold pending, bit n masks ISR n.
+										All interrupts are unmasked by default.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The mask was set successfully                    |
+
+			@remark						This method may be called from any thread, including from an io handler while the machine is running.
+
+			@remark						The pending interrupts are cleared each time IMachine::Run is called and are not
+										part of the saved machine state.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code SetInterruptMask(uint8_t mask) = 0;
+
+		/** Set the interrupt priority
+
+			Rotate the priority of the interrupt controller.
+
+			@param		highest			The interrupt with the highest priority, the priority decreases with each
+										subsequent interrupt wrapping from ISR::Seven to ISR::Zero. ISR::Zero has
+										the highest priority by default.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The priority was set successfully                |
+			| invalid_argument        | The isr is not a cpu level interrupt             |
+
+			@remark						This method may be called from any thread, including from an io handler while the machine is running.
+
+			@see						IMachine::SetInterruptMask
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code SetInterruptPriority(ISR highest) = 0;
+
+		/** Map an io port to a latch
+
+			Route the cpu IN and OUT instructions for a port directly to a byte in host memory.
+
+			@param		port			The io port to map.
+			@param		latch			The byte that IN reads from and OUT writes to, nullptr unmaps the port.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The port was mapped successfully                 |
+			| busy                    | MEEN is currently running                        |
+
+			@remark						The latch is accessed without synchronisation from the thread running the machine,
+										it must remain valid until the port is unmapped or the machine is destroyed.
+
+			@remark						Ports that are not mapped are routed to the io controller attached via
+										IMachine::AttachIoController. When no ports are mapped the cpu calls the io
+										controller directly.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code MapIoPort(uint8_t port, uint8_t* latch) = 0;
+
+		/** Map an io port to handlers
+
+			Route the cpu IN and OUT instructions for a port to a pair of handlers.
+
+			| Handler          | Explanation                                                                                   |
+			|:-----------------|:----------------------------------------------------------------------------------------------|
+			| read             | Called with the port number on IN, returns the value to load into the accumulator             |
+			| write            | Called with the port number and the accumulator on OUT                                        |
+
+			@param		port			The io port to map.
+			@param		read			The IN handler, when nullptr IN returns 0.
+			@param		write			The OUT handler, when nullptr OUT is ignored.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The port was mapped successfully                 |
+			| busy                    | MEEN is currently running                        |
+			| invalid_argument        | Both handlers are nullptr                        |
+
+			@remark						When the `runAsync` configuration option is set to true, the handlers will be called
+										from a different thread from which IMachine::Run was invoked.
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code MapIoPort(uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write) = 0;
+
+		/** Unmap an io port
+
+			Route the cpu IN and OUT instructions for a port back to the io controller.
+
+			@param		port			The io port to unmap.
+
+			@return						One of the following MEEN std::error_codes:
+
+			| MEEN error code         | Explanation                                      |
+			|:------------------------|:-------------------------------------------------|
+			| no_error                | The port was unmapped successfully               |
+			| busy                    | MEEN is currently running                        |
+
+			@since						version 2.2.0
+		*/
+		virtual std::error_code UnmapIoPort(uint8_t port) = 0;
+
 		/** Destruct the machine
 
 			Release all resources used by this machine instance.
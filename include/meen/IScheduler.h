@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ISCHEDULER_H
+#define ISCHEDULER_H
+
+#include <cstdint>
+#include <system_error>
+
+#include "meen/Base.h"
+
+namespace meen
+{
+	/** Event scheduler interface
+
+		A machine level queue of interrupts keyed on the cpu cycle count.
+
+		Controllers that know in advance when they next need to interrupt the cpu, for example
+		a timer tick or a vertical blank, schedule the interrupt here instead of waiting to be
+		polled via IController::GenerateInterrupt. The machine executes instructions straight
+		through to the next deadline and delivers the interrupt at the first instruction
+		boundary on or after the scheduled cycle.
+
+		@remark		The scheduler is handed to each attached controller via IController::SetScheduler
+					when the machine starts running. It must only be used from the thread that calls
+					the controller methods and all pending events are discarded when the machine stops.
+
+		@since		version 2.2.0
+	*/
+	class IScheduler
+	{
+	public:
+		/** Now
+
+			The current cpu cycle count.
+
+			@return			The total number of cycles that have elapsed since the machine started running.
+		*/
+		virtual uint64_t Now() const = 0;
+
+		/** Schedule an interrupt
+
+			Queue an interrupt to be delivered when the cpu cycle count reaches the specified value.
+
+			@param	cycle	The absolute cycle count at which the interrupt should be delivered. A cycle
+							count that has already elapsed is delivered at the next instruction boundary.
+			@param	isr		The interrupt to deliver.
+
+			@return			errc::invalid_argument when the isr is ISR::NoInterrupt.
+
+			@remark			Interrupts scheduled for the same cycle are delivered in the order they were scheduled.
+		*/
+		virtual std::error_code Schedule(uint64_t cycle, ISR isr) = 0;
+
+		/** Cancel an interrupt
+
+			Remove all pending events for the specified interrupt.
+
+			@param	isr		The interrupt to remove.
+		*/
+		virtual void Cancel(ISR isr) = 0;
+
+		/** Wake
+
+			Discard the poll times returned from IController::NextPoll, the io controllers are polled via
+			IController::GenerateInterrupt at their `isrFreq` rate again (at the next instruction boundary by default).
+
+			@remark			Unlike the other methods this method may be called from any thread.
+
+			@since			version 2.2.0
+		*/
+		virtual void Wake() = 0;
+
+		/** Destruction
+		*/
+		virtual ~IScheduler() = default;
+	};
+} // namespace meen
+
+#endif // ISCHEDULER_H
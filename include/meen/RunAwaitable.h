@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RUN_AWAITABLE_H
+#define RUN_AWAITABLE_H
+
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <system_error>
+
+#include "meen/IController.h"
+
+namespace meen
+{
+	struct IMachine;
+
+	/** Executor
+
+		Schedules a task to be run by the host, for example by posting it to a thread pool or an event loop.
+
+		@since		version 2.2.0
+	*/
+	using Executor = std::function<void(std::function<void()>&& task)>;
+
+	/** Run awaitable
+
+		The awaitable returned by IMachine::RunAwait. Awaiting it runs the machine on the host executor
+		in slices of IMachine::RunFor, each slice is posted to the executor as a separate task so the
+		executor can interleave the machine with its other tasks. The awaiting coroutine is resumed on
+		the executor once the machine quits.
+
+		@remark		Only the completion of the run is awaitable, the awaiting coroutine is not resumed between
+					slices. A host that needs to act between slices calls IMachine::RunFor from its own loop.
+
+		@code
+
+		Task Emulate(IMachine* machine, Executor executor)
+		{
+			auto err = co_await machine->RunAwait(executor, 40000);
+		}
+
+		@endcode
+
+		@since		version 2.2.0
+	*/
+	class DLL_EXP_IMP RunAwaitable final
+	{
+	private:
+		IMachine* machine_{};
+		Executor executor_;
+		uint64_t slice_{};
+		std::error_code err_;
+
+		void Slice(std::coroutine_handle<> handle);
+	public:
+		/** Run awaitable
+
+			@param	machine		The machine to run.
+			@param	executor	The executor that runs the slices and resumes the awaiting coroutine.
+			@param	slice		The number of cpu cycles to run per slice, 0 runs the machine to completion in a single slice.
+		*/
+		RunAwaitable(IMachine* machine, Executor&& executor, uint64_t slice);
+
+		/** The machine always runs on the executor
+		*/
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		/** Post the first slice to the executor
+
+			@return		false when the machine or executor is empty, the coroutine is resumed straight away with invalid_argument.
+		*/
+		bool await_suspend(std::coroutine_handle<> handle);
+
+		/** The run result
+
+			@return		An empty std::error_code when the machine quit, otherwise one of the MEEN std error codes returned by IMachine::RunFor.
+		*/
+		std::error_code await_resume() const noexcept
+		{
+			return err_;
+		}
+	};
+} // namespace meen
+
+#endif // RUN_AWAITABLE_H
@@ -98,6 +98,7 @@ namespace meen
 		~CpuClock() = default;
 
 		void Reset() final;
+		void Skip(std::chrono::nanoseconds duration) final;
 		std::error_code SetSamplingFrequency(double samplingFrequency) final;
 		uint64_t GetSpeed() const final;
 		//Returns the host CPU time.
@@ -94,6 +94,15 @@ namespace meen
 		*/
 		virtual void Reset() = 0;
 
+		/** Skip.
+
+			Excludes a period of host time from the clock, the time of the machine
+			carries on from where it was before the period began.
+
+			@param	duration			The period of host time to exclude, for example the time the machine was paused for.
+		*/
+		virtual void Skip(std::chrono::nanoseconds duration) = 0;
+
 		virtual ~ICpuClock() = default;
 	};
 } // namespace meen
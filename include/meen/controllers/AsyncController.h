@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ASYNCCONTROLLER_H
+#define ASYNCCONTROLLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "meen/IController.h"
+#include "meen/IScheduler.h"
+#include "meen/controllers/SpscRing.h"
+
+namespace meen
+{
+	/** Asynchronous io controller
+
+		A base class for io devices that talk to host io, for example a file, a pipe or a terminal,
+		without stalling the cpu thread.
+
+		The guest side of the device (Read and Write, called from the cpu thread) exchanges bytes
+		with the host side through a pair of lock free single producer single consumer rings. The
+		host side is serviced by a worker thread that is started when the machine starts running
+		and is stopped (after servicing any remaining output) when it stops running.
+
+		Derived classes implement Read and Write in terms of GuestRead and GuestWrite and implement
+		Service in terms of HostRead and HostWrite.
+
+		When the host side writes to an empty ring the machine is woken and GenerateInterrupt
+		returns the interrupt passed to the constructor, otherwise the machine does not poll this
+		controller for interrupts.
+
+		@remark		Not available on baremetal platforms.
+
+		@since		version 2.2.0
+	*/
+	class DLL_EXP_IMP AsyncController : public IController
+	{
+	public:
+		/** The capacity in bytes of each ring
+		*/
+		static constexpr size_t ringSize_ = 1024;
+	private:
+		// Bytes written by the guest for the host
+		SpscRing<uint8_t, ringSize_> toHost_;
+		// Bytes written by the host for the guest
+		SpscRing<uint8_t, ringSize_> toGuest_;
+		// The machine scheduler while the machine is running
+		std::atomic<IScheduler*> scheduler_{};
+		// The host has written data for the guest since the last poll
+		std::atomic_bool ready_{};
+		ISR isr_{};
+		std::chrono::nanoseconds servicePeriod_{};
+		std::thread worker_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		bool stop_{};
+		// The worker is waiting on cv_, the guest only takes the mutex to wake it
+		std::atomic_bool sleeping_{};
+
+		void Start();
+		void Stop();
+		void Notify();
+		void Work();
+	protected:
+		/** Asynchronous controller constructor
+
+			@param	isr				The interrupt to generate when the host has written data for the guest, ISR::NoInterrupt
+									for devices that are only polled by the guest.
+			@param	servicePeriod	The maximum amount of time the worker waits for guest output before calling Service again,
+									this sets the latency of host input for devices that have to poll for it.
+		*/
+		explicit AsyncController(ISR isr = ISR::NoInterrupt, std::chrono::nanoseconds servicePeriod = std::chrono::milliseconds(10));
+
+		/** Guest write
+
+			Queue a byte for the host, called from the cpu thread.
+
+			@param	value	The byte to queue.
+
+			@return			false when the ring is full, the byte is dropped.
+		*/
+		bool GuestWrite(uint8_t value);
+
+		/** Guest read
+
+			Take the next byte written by the host, called from the cpu thread.
+
+			@param	value	Receives the byte.
+
+			@return			false when the host has not written any data, value is unchanged.
+		*/
+		bool GuestRead(uint8_t& value);
+
+		/** Guest ready
+
+			@return			true when there is data from the host for the guest to read.
+		*/
+		bool GuestReady() const;
+
+		/** Host write
+
+			Queue a byte for the guest, called from the worker thread.
+
+			@param	value	The byte to queue.
+
+			@return			false when the ring is full, the byte is not queued.
+		*/
+		bool HostWrite(uint8_t value);
+
+		/** Host read
+
+			Take the next byte written by the guest, called from the worker thread.
+
+			@param	value	Receives the byte.
+
+			@return			false when the guest has not written any data, value is unchanged.
+		*/
+		bool HostRead(uint8_t& value);
+
+		/** Service
+
+			Called from the worker thread when the guest has written data and at least once per service
+			period. It is also called once more after the machine stops running so the remaining guest
+			output can be flushed.
+
+			Implementations move data between the rings and the host, they may block on host io.
+		*/
+		virtual void Service() = 0;
+	public:
+		/** Asynchronous controller destructor
+
+			@remark			The worker thread must not be running when the controller is destroyed as it calls
+							Service on the derived class. The machine stops it when the machine stops running,
+							including when a machine with a run suspended by IMachine::RunFor is destroyed, so a
+							controller must not be destroyed while it is attached to a running machine.
+		*/
+		~AsyncController();
+
+		/** Generate interrupt
+
+			@return			The interrupt passed to the constructor when the host has written data for
+							the guest since the last call, ISR::NoInterrupt otherwise.
+		*/
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) override;
+
+		/** Next poll
+
+			@return			The maximum time, the machine is woken when the host writes data for the guest.
+		*/
+		uint64_t NextPoll(uint64_t currTime, uint64_t cycles) override;
+
+		/** Set scheduler
+
+			Starts the worker thread when the machine starts running and stops it when the machine stops.
+		*/
+		void SetScheduler(IScheduler* scheduler) override;
+	};
+} // namespace meen
+
+#endif // ASYNCCONTROLLER_H
@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef CPMBDOS_H
+#define CPMBDOS_H
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "meen/Base.h"
+#include "meen/IController.h"
+#include "meen/controllers/CpmConsoleController.h"
+
+namespace meen
+{
+	/** CP/M BDOS high level emulation
+
+		Implements the CP/M 2.2 BDOS console and file functions natively. Register the Call method
+		as the trap handler for the BDOS entry point so the guest calls to address 5 are serviced
+		without executing any BIOS or BDOS code:
+
+		@code
+
+		CpmConsoleController console;
+		CpmBdos bdos(&console, "disk");
+
+		machine->OnTrap(0x0005, [&bdos](Registers& registers, IController* memoryController)
+		{
+			return bdos.Call(registers, memoryController);
+		});
+
+		@endcode
+
+		Console output and input go through the console controller. Files are read from and written
+		to a host directory, CP/M file names are matched case insensitively against the host file
+		names that fit the 8.3 format. The drive and user numbers are ignored.
+
+		Results are returned in A and L with B and H cleared, the version number is returned in HL
+		with A and B holding its low and high bytes. The registers are left unchanged by functions
+		that do not return a result.
+
+		Unsupported functions are not handled so the guest BDOS is called instead.
+
+		@remark		Not available on baremetal platforms.
+
+		@since		version 2.2.0
+	*/
+	class DLL_EXP_IMP CpmBdos final
+	{
+	public:
+		/** The supported BDOS functions, the function number is passed in register C
+		*/
+		enum class Function : uint8_t
+		{
+			SystemReset = 0,		/**< Warm boot, returns to address 0 */
+			ConsoleInput = 1,		/**< Read a key and echo it, 1Ah when there is no input */
+			ConsoleOutput = 2,		/**< Output the character in E */
+			DirectConsoleIo = 6,	/**< E = FFh reads a key (0 when there is none), E = FEh returns the console status, otherwise output E */
+			PrintString = 9,		/**< Output the '$' terminated string at DE */
+			ReadConsoleBuffer = 10,	/**< Read a line into the buffer at DE */
+			ConsoleStatus = 11,		/**< FFh when a key is ready, 0 otherwise */
+			Version = 12,			/**< Returns 0022h, CP/M 2.2 */
+			ResetDisk = 13,			/**< Resets the DMA address to 80h */
+			SelectDisk = 14,		/**< Ignored */
+			OpenFile = 15,			/**< Open the file named by the FCB at DE */
+			CloseFile = 16,			/**< Close the file named by the FCB at DE */
+			SearchFirst = 17,		/**< Find the first file matching the FCB at DE, '?' matches any character */
+			SearchNext = 18,		/**< Find the next matching file */
+			DeleteFile = 19,		/**< Delete the files matching the FCB at DE */
+			ReadSequential = 20,	/**< Read the next record into the DMA buffer */
+			WriteSequential = 21,	/**< Write the DMA buffer to the next record */
+			MakeFile = 22,			/**< Create the file named by the FCB at DE */
+			RenameFile = 23,		/**< Rename the file named by the FCB at DE to the name at DE + 16 */
+			CurrentDisk = 25,		/**< Returns 0, drive A */
+			SetDma = 26,			/**< Set the DMA address to DE */
+			ReadRandom = 33,		/**< Read the record selected by the FCB random record number */
+			WriteRandom = 34,		/**< Write the record selected by the FCB random record number */
+			FileSize = 35,			/**< Set the FCB random record number to the size of the file in records */
+			SetRandomRecord = 36	/**< Set the FCB random record number to the current sequential record */
+		};
+
+		/** The size in bytes of a CP/M record
+		*/
+		static constexpr size_t recordSize_ = 128;
+	private:
+		// The size in bytes of a file control block (including the random record number)
+		static constexpr size_t fcbSize_ = 36;
+		using Fcb = std::array<uint8_t, fcbSize_>;
+
+		CpmConsoleController* console_{};
+		std::filesystem::path directory_;
+		uint16_t dma_{ 0x80 };
+		// The open files keyed by their host path
+		std::map<std::filesystem::path, std::fstream> files_;
+		// The files found by the last SearchFirst and the next one to return
+		std::vector<std::string> found_;
+		size_t next_{};
+
+		static std::string Name(const uint8_t* name);
+		static bool Match(const uint8_t* pattern, const std::string& name);
+		std::vector<std::string> Find(const uint8_t* pattern) const;
+		std::fstream* Open(const Fcb& fcb, bool create);
+		uint8_t ReadRecord(std::fstream& file, uint32_t record, IController* memoryController);
+		uint8_t WriteRecord(std::fstream& file, uint32_t record, IController* memoryController);
+		uint8_t Search(IController* memoryController);
+		int Console(Function function, Registers& registers, IController* memoryController);
+		int File(Function function, Registers& registers, IController* memoryController);
+	public:
+		/** CP/M BDOS constructor
+
+			@param	console		The console that characters are written to and keys are read from.
+			@param	directory	The host directory that holds the CP/M files.
+		*/
+		CpmBdos(CpmConsoleController* console, const char* directory);
+
+		/** Call a BDOS function
+
+			@param	registers			The cpu registers at the call, C holds the function number and DE its parameter.
+			@param	memoryController	The memory controller holding the guest memory.
+
+			@return						0 when the function was handled, -1 when it is not supported.
+
+			@see						IMachine::OnTrap
+		*/
+		int Call(Registers& registers, IController* memoryController);
+	};
+} // namespace meen
+
+#endif // CPMBDOS_H
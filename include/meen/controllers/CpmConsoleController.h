@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef CPMCONSOLECONTROLLER_H
+#define CPMCONSOLECONTROLLER_H
+
+#include <atomic>
+#include <span>
+
+#include "meen/IController.h"
+#include "meen/controllers/SpscRing.h"
+
+namespace meen
+{
+	/** CP/M console io controller
+
+		Emulates the CP/M BDOS console output (function 2) and output string (function 9)
+		system calls. The output is written to a fixed capacity ring that the host drains
+		as contiguous views without copying, see Output and Consume.
+
+		Console input typed by the host (see Type) is read by the BDOS high level emulation,
+		see CpmBdos.
+
+		A BDOS stub writes the function number to Port::PrintMode, the high byte of the
+		string address to Port::AddrHi (function 9 only) and then the character or the low
+		byte of the string address to Port::Process.
+
+		Function 9 strings are scanned for the terminating '$' through the memory view of
+		the memory controller when it has one (see IController::Memory), otherwise they are
+		read a byte at a time.
+
+		@remark		The machine (the producer) and the host (the consumer) can run on different
+					threads, only one thread at a time may drain the output.
+
+		@since		version 2.2.0
+	*/
+	class CpmConsoleController final : public IController
+	{
+	public:
+		/** CP/M console io ports
+		*/
+		enum class Port
+		{
+			PrintMode,	/**< 2 - output a single character, 9 - output the '$' terminated string */
+			AddrHi,		/**< The high byte of the string address when the print mode is 9 */
+			Process		/**< The character to output or the low byte of the string address */
+		};
+
+		/** The capacity in bytes of the output ring
+		*/
+		static constexpr size_t outputSize_ = 16384;
+
+		/** The capacity in bytes of the input ring
+		*/
+		static constexpr size_t inputSize_ = 256;
+	private:
+		SpscRing<uint8_t, outputSize_> output_;
+		SpscRing<uint8_t, inputSize_> input_;
+		std::atomic<size_t> dropped_{};
+		uint8_t printMode_{};
+		uint8_t addrHi_{};
+	public:
+		/** Print
+
+			Append text to the output, called from the machine thread.
+
+			@param	text		The text to output.
+		*/
+		void Print(std::span<const uint8_t> text);
+
+		/** Print a string
+
+			Append a '$' terminated string to the output, called from the machine thread.
+
+			@param	address				The guest address of the string.
+			@param	memoryController	The memory controller to read the string from.
+		*/
+		void PrintString(uint16_t address, IController* memoryController);
+
+		/** Type
+
+			Queue console input, called from the host.
+
+			@param	text		The keys to queue.
+
+			@return				The number of keys queued, less than the size of text when the input ring is full.
+		*/
+		size_t Type(std::span<const uint8_t> text);
+
+		/** Key
+
+			Take the next key of console input, called from the machine thread.
+
+			@param	key			Receives the key.
+
+			@return				false when there is no input, key is unchanged.
+		*/
+		bool Key(uint8_t& key);
+
+		/** Key ready
+
+			@return				true when there is console input.
+		*/
+		bool KeyReady() const;
+
+		/**	Uuid
+
+			@return				The uuid as a 16 byte array.
+		*/
+		std::array<uint8_t, 16> Uuid() const final;
+
+		/** Read
+
+			@return				0, console input is not supported.
+		*/
+		uint8_t Read(uint16_t port, IController* controller) final;
+
+		/** Write
+
+			@param	port		The Port to write to.
+			@param	value		The value to write to the port.
+			@param	controller	The memory controller that function 9 strings are read from.
+		*/
+		void Write(uint16_t port, uint8_t value, IController* controller) final;
+
+		/** Generate interrupt
+
+			@return				ISR::NoInterrupt, this controller does not generate interrupts.
+		*/
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+
+		/** Output
+
+			@return				A view of the oldest output that is contiguous in the ring, empty when
+								there is no output. When the output wraps around the end of the ring the
+								remainder is returned once this view has been consumed.
+
+			@remark				The view remains valid until it is consumed.
+		*/
+		std::span<const uint8_t> Output() const;
+
+		/** Consume
+
+			@param	count		The number of output bytes to release, typically the size of the view
+								returned by Output.
+		*/
+		void Consume(size_t count);
+
+		/** Dropped
+
+			@return				The number of output bytes that were discarded because the output ring
+								was full.
+		*/
+		size_t Dropped() const;
+	};
+} // namespace meen
+
+#endif // CPMCONSOLECONTROLLER_H
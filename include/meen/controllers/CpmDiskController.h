@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef CPMDISKCONTROLLER_H
+#define CPMDISKCONTROLLER_H
+
+#include <array>
+#include <system_error>
+
+#include "meen/IController.h"
+
+namespace meen
+{
+	/** CP/M disk image controller
+
+		A disk controller for raw CP/M disk images. Each image is mapped into memory with mmap
+		so sectors are served straight from the mapping, the kernel page cache acts as the write
+		back cache for the image file.
+
+		A transfer moves one or more consecutive sectors between the image and guest memory
+		(via the memory controller view when it has one, see IController::Memory) in a single
+		block copy, continuing onto the next track when a transfer runs past the last sector
+		of a track.
+
+		The ports are decoded from the low 3 bits of the port number so the controller can be
+		attached to any 8 port aligned range via IMachine::AttachIoController:
+
+		- Port::Drive, Port::Track and Port::Sector select the first sector of the transfer.
+		- Port::DmaLo and Port::DmaHi set the guest memory address of the transfer.
+		- Port::Count sets the number of sectors to transfer, 0 transfers 1 sector.
+		- Writing a Command to Port::Command performs the transfer, the result is read from Port::Status.
+
+		@remark		Only available on Linux.
+
+		@since		version 2.2.0
+	*/
+	class CpmDiskController final : public IController
+	{
+	public:
+		/** Disk geometry
+
+			The track and sector ports are 8 bits wide, a geometry with more than 256 tracks or whose
+			last sector number is larger than 255 can not be addressed and is rejected by Mount.
+		*/
+		struct Geometry
+		{
+			uint16_t tracks;		/**< The number of tracks */
+			uint16_t sectors;		/**< The number of sectors per track */
+			uint16_t sectorSize;	/**< The number of bytes per sector */
+			uint8_t firstSector;	/**< The number of the first sector of each track */
+		};
+
+		/** 8" single sided single density, 77 tracks of 26 128 byte sectors numbered from 1
+		*/
+		static constexpr Geometry ibm3740{ 77, 26, 128, 1 };
+
+		/** 4MB hard disk, 255 tracks of 128 128 byte sectors numbered from 0
+		*/
+		static constexpr Geometry hd4Mb{ 255, 128, 128, 0 };
+
+		/** Disk controller ports, relative to the 8 port aligned base port
+		*/
+		enum class Port
+		{
+			Drive,		/**< The drive to transfer to or from */
+			Track,		/**< The track of the first sector */
+			Sector,		/**< The first sector */
+			Command,	/**< Write a Command to start the transfer */
+			Status,		/**< Read the Status of the last command */
+			DmaLo,		/**< The low byte of the guest memory address */
+			DmaHi,		/**< The high byte of the guest memory address */
+			Count		/**< The number of sectors to transfer */
+		};
+
+		/** Disk controller commands
+		*/
+		enum class Command : uint8_t
+		{
+			Read,		/**< Copy sectors from the image to guest memory */
+			Write,		/**< Copy sectors from guest memory to the image */
+			Flush		/**< Write the modified sectors of all images back to their files */
+		};
+
+		/** Disk controller status
+		*/
+		enum class Status : uint8_t
+		{
+			Ok,			/**< The command completed */
+			NoDrive,	/**< No image is mounted on the selected drive */
+			BadTrack,	/**< The track is out of range */
+			BadSector,	/**< The sector is out of range or the transfer runs past the end of the disk */
+			ReadOnly,	/**< The image is mounted read only */
+			BadCommand,	/**< The command is unknown */
+			IoError		/**< The images could not be written back to their files */
+		};
+
+		/** The number of drives, A to P
+		*/
+		static constexpr size_t MaxDrives = 16;
+	private:
+		struct Drive
+		{
+			uint8_t* image;
+			size_t size;
+			Geometry geometry;
+			bool readOnly;
+		};
+
+		std::array<Drive, MaxDrives> drives_{};
+		uint16_t dma_{};
+		uint8_t drive_{};
+		uint8_t track_{};
+		uint8_t sector_{};
+		uint8_t count_{};
+		Status status_{};
+
+		Status Transfer(Command command, IController* memoryController);
+	public:
+		/** Disk controller destructor
+
+			Unmounts all drives.
+		*/
+		~CpmDiskController();
+
+		/** Mount a disk image
+
+			@param	drive		The drive to mount the image on, 0 (A) to 15 (P). An image that is already mounted
+								on the drive is unmounted first.
+			@param	path		The path of the disk image file.
+			@param	geometry	The geometry of the disk image.
+			@param	readOnly	When true the image is mapped read only and writes fail with Status::ReadOnly.
+
+			@return				errc::invalid_argument when the drive or geometry is invalid, the geometry can not be
+								addressed by the track and sector ports or the image is smaller than the geometry, errc::io_controller when the image could not be opened or mapped.
+		*/
+		std::error_code Mount(uint8_t drive, const char* path, const Geometry& geometry, bool readOnly = false);
+
+		/** Unmount a disk image
+
+			Writes the modified sectors back to the image file and unmaps it.
+
+			@param	drive		The drive to unmount.
+
+			@return				errc::invalid_argument when no image is mounted on the drive.
+		*/
+		std::error_code Unmount(uint8_t drive);
+
+		/** Flush
+
+			Writes the modified sectors of all mounted images back to their files.
+
+			@return				errc::io_controller when an image could not be written.
+		*/
+		std::error_code Flush();
+
+		/**	Uuid
+
+			@return				The uuid as a 16 byte array.
+		*/
+		std::array<uint8_t, 16> Uuid() const final;
+
+		/** Read
+
+			@param	port		The port to read, only Port::Status is readable.
+			@param	controller	Unused by this implementation.
+
+			@return				The Status of the last command for Port::Status, 0 otherwise.
+		*/
+		uint8_t Read(uint16_t port, IController* controller) final;
+
+		/** Write
+
+			@param	port		The Port to write.
+			@param	value		The value to write.
+			@param	controller	The memory controller that sectors are transferred to and from.
+		*/
+		void Write(uint16_t port, uint8_t value, IController* controller) final;
+
+		/** Generate interrupt
+
+			@return				ISR::NoInterrupt, transfers complete before the OUT instruction that starts them.
+		*/
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+
+		/** Next poll
+
+			@return				The maximum time, this controller never needs to be polled.
+		*/
+		uint64_t NextPoll(uint64_t currTime, uint64_t cycles) final;
+	};
+} // namespace meen
+
+#endif // CPMDISKCONTROLLER_H
@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEMFDCONTROLLER_H
+#define MEMFDCONTROLLER_H
+
+#include <expected>
+#include <memory>
+#include <system_error>
+
+#include "meen/IController.h"
+
+namespace meen
+{
+	class MemfdController;
+
+	/** Convenience using directive
+
+		A MemfdControllerPtr converts to an IControllerPtr and can be attached to a machine
+		via IMachine::AttachMemoryController.
+	*/
+	using MemfdControllerPtr = std::unique_ptr<MemfdController, ControllerDeleter>;
+
+	/** memfd backed memory controller
+
+		A 16 bit memory controller whose memory is backed by an anonymous Linux memfd
+		mapping.
+
+		The memfd file descriptor can be passed to another process (via fork, a unix
+		domain socket or /proc/<pid>/fd/<fd>) which can then map the same guest memory:
+
+		- MemfdController::Mapping::Shared: reads and writes are seen by all processes sharing the memory.
+		- MemfdController::Mapping::Private: a snapshot of the guest memory in a new memfd, neither the
+		  snapshot nor the source see the writes made to the other after the snapshot is taken.
+		  This can be used to start a child machine from the current state of the parent.
+		- MemfdController::Mapping::ReadOnly: zero copy inspection of the guest memory, writes are ignored.
+
+		When a machine is loaded with memory that already resides in this controller,
+		the `memfd://` scheme can be used for the rom and ram bytes to instruct the machine
+		to leave the memory as it is, see IMachine::OnLoad.
+
+		@remark		Only available on Linux.
+
+		@since		version 2.2.0
+	*/
+	class MemfdController final : public IController
+	{
+	public:
+		/** Mapping types
+
+			@see	MemfdController
+		*/
+		enum class Mapping
+		{
+			Shared,		/**< Writes are visible to all mappings */
+			Private,	/**< A snapshot of the memory, writes are private to this controller */
+			ReadOnly	/**< Writes are ignored */
+		};
+	private:
+		/**
+			The size of the memory in bytes
+
+			This is a 16 bit memory controller.
+		*/
+		static constexpr size_t memorySize_{ 1 << 16 };
+
+		int fd_{ -1 };
+		uint8_t* memory_{};
+		Mapping mapping_{};
+
+		/**
+			Pages written to since the machine last cleared them
+		*/
+		DirtyPageMap dirtyPages_;
+
+		MemfdController(int fd, uint8_t* memory, Mapping mapping);
+	public:
+		/** Create a memfd backed memory controller
+
+			Creates a new anonymous memfd which is shared mapped and initialised to 0.
+
+			@param	name		The name of the memfd, it is used for debugging purposes only
+								and appears as the target of the symlink in /proc/<pid>/fd/.
+
+			@return				The new controller or errc::memory_controller if the memfd
+								could not be created or mapped.
+		*/
+		static std::expected<MemfdControllerPtr, std::error_code> Make(const char* name);
+
+		/** Map an existing memfd
+
+			Creates a controller that maps the guest memory of another MemfdController.
+
+			@param	fd			A file descriptor that refers to the memfd of another controller,
+								the descriptor is duplicated and can be closed once this method returns.
+			@param	mapping		How the memory should be mapped.
+
+			@remark				A MAP_PRIVATE mapping of a memfd still sees the source writes to the pages
+								that have not been written through the mapping, so Mapping::Private copies
+								the memory into a new memfd instead. The snapshot should be taken while the
+								machine writing to the source memory is not running. Fd returns the new memfd.
+
+			@return				The new controller, errc::invalid_argument if the descriptor is
+								invalid or too small or errc::memory_controller if it could not be mapped.
+		*/
+		static std::expected<MemfdControllerPtr, std::error_code> Map(int fd, Mapping mapping);
+
+		/** Memfd controller destructor
+
+			Unmaps the guest memory and closes the memfd.
+		*/
+		~MemfdController();
+
+		/** Memfd file descriptor
+
+			@return				The file descriptor of the memfd backing the guest memory.
+
+			@remark				The descriptor is owned by this controller.
+		*/
+		int Fd() const;
+
+		/**	Uuid
+
+			Unique universal identifier for this controller.
+
+			@return				The uuid as a 16 byte array.
+
+			@remark				All memfd controllers share the same uuid, this allows the machine state to be
+								loaded into any controller mapping the same memfd.
+		*/
+		std::array<uint8_t, 16> Uuid() const final;
+
+		/** Read a byte of memory
+
+			@param	address		The 16 bit address to read from.
+			@param	controller	Unused by this implementation.
+
+			@return				The 8 bits residing at the 16 bit memory address.
+		*/
+		uint8_t Read(uint16_t address, IController* controller) final;
+
+		/** Write a byte of data to memory
+
+			@param	address		The 16 bit address to write to.
+			@param	value		The 8 bit value to write.
+			@param	controller	Unused by this implementation.
+
+			@remark				Writes are ignored for read only mappings.
+		*/
+		void Write(uint16_t address, uint8_t value, IController* controller) final;
+
+		/** Memory interrupt handler
+
+			@param	currTime	The time in nanoseconds of the machine clock.
+			@param	cycles		The total number of cycles that have elapsed.
+			@param	controller	Unused by this implementation.
+
+			@return				ISR::NoInterrupt, this controller never generates any interrupts.
+		*/
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+
+		/** Dirty pages
+
+			Each write marks the 256 byte page it lands in as dirty.
+
+			@return				The dirty page map of this controller.
+		*/
+		DirtyPageMap* DirtyPages() final;
+
+		/** Memory
+
+			@return				A span over the mapped memory or an empty span when the
+								mapping is read only so that all writes go through Write.
+		*/
+		std::span<uint8_t> Memory() final;
+
+		/** Memory view
+
+			@return				A read only span over the mapped memory, including when the mapping is read only.
+		*/
+		std::span<const uint8_t> MemoryView() final;
+	};
+} // namespace meen
+
+#endif // MEMFDCONTROLLER_H
@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+namespace meen
+{
+	/** Single producer single consumer ring
+
+		A lock free fixed capacity queue where one thread pushes and another thread pops.
+
+		@tparam		T	The element type.
+		@tparam		N	The capacity of the ring, it must be a power of 2.
+
+		@since		version 2.2.0
+	*/
+	template<typename T, size_t N>
+	class SpscRing
+	{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "The ring capacity must be a power of 2");
+
+		// The producer and consumer indices live on their own cache lines so the two threads don't contend for them
+		static constexpr size_t cacheLine_ = 64;
+
+		alignas(cacheLine_) std::atomic<size_t> head_{};
+		alignas(cacheLine_) std::atomic<size_t> tail_{};
+		alignas(cacheLine_) std::array<T, N> buffer_{};
+	public:
+		/** Push
+
+			Called from the producer thread only.
+
+			@param	value	The value to append to the ring.
+
+			@return			false when the ring is full, the value is not added.
+		*/
+		bool Push(const T& value)
+		{
+			auto tail = tail_.load(std::memory_order_relaxed);
+
+			if (tail - head_.load(std::memory_order_acquire) == N)
+			{
+				return false;
+			}
+
+			buffer_[tail & (N - 1)] = value;
+			tail_.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/** Pop
+
+			Called from the consumer thread only.
+
+			@param	value	Receives the oldest value in the ring.
+
+			@return			false when the ring is empty, value is left unchanged.
+		*/
+		bool Pop(T& value)
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+
+			if (head == tail_.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			value = buffer_[head & (N - 1)];
+			head_.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		/** Push a range
+
+			Called from the producer thread only.
+
+			@param	values	The values to append to the ring.
+
+			@return			The number of values added, less than the size of values when the ring fills up.
+		*/
+		size_t Push(std::span<const T> values)
+		{
+			auto tail = tail_.load(std::memory_order_relaxed);
+			auto count = std::min(values.size(), N - (tail - head_.load(std::memory_order_acquire)));
+			auto index = tail & (N - 1);
+			// the free space may wrap around the end of the buffer
+			auto first = std::min(count, N - index);
+
+			std::copy_n(values.begin(), first, buffer_.begin() + index);
+			std::copy_n(values.begin() + first, count - first, buffer_.begin());
+			tail_.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		/** Front
+
+			Called from the consumer thread only.
+
+			@return			A view of the oldest values in the ring that are contiguous in memory, empty when
+							the ring is empty. When the values wrap around the end of the ring the remaining
+							values are returned once the view has been dropped.
+
+			@remark			The view remains valid until its values are dropped.
+		*/
+		std::span<const T> Front() const
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+			auto index = head & (N - 1);
+			return { buffer_.data() + index, std::min(tail_.load(std::memory_order_acquire) - head, N - index) };
+		}
+
+		/** Drop
+
+			Called from the consumer thread only.
+
+			@param	count	The number of the oldest values to remove from the ring, typically the size
+							of the view returned by Front.
+		*/
+		void Drop(size_t count)
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+			head_.store(head + std::min(count, tail_.load(std::memory_order_acquire) - head), std::memory_order_release);
+		}
+
+		/** Size
+
+			@return			The number of values in the ring, a snapshot when called from
+							a thread that is neither the producer nor the consumer.
+		*/
+		size_t Size() const
+		{
+			// load the head first, the tail can only move further ahead of it
+			auto head = head_.load(std::memory_order_acquire);
+			return tail_.load(std::memory_order_acquire) - head;
+		}
+
+		/** Empty
+
+			@return			true when there are no values in the ring.
+		*/
+		bool Empty() const
+		{
+			return Size() == 0;
+		}
+
+		/** Capacity
+
+			@return			The maximum number of values the ring can hold.
+		*/
+		static constexpr size_t Capacity()
+		{
+			return N;
+		}
+	};
+} // namespace meen
+
+#endif // SPSCRING_H
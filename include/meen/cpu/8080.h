@@ -117,6 +117,11 @@ namespace meen
 #endif
 		IController* memoryController_{};
 		IController* ioController_{};
+		// Opcode fetches are made through this controller, it is usually the memory controller
+		IController* fetchController_{};
+		const IoPortTable* ioPorts_{};
+		std::function<int(Registers& registers)> trap_;
+		uint16_t trapAddress_{};
 
 		static uint8_t Value(const Register& r) { return static_cast<uint8_t>(r.to_ulong()); }
 		static uint16_t Uint16(const Register& hi, const Register& low) { return (Value(hi) << 8) | Value(low); }
@@ -184,6 +189,7 @@ namespace meen
 		inline uint8_t Pop(Register& hi, Register& low);
 		inline uint8_t JmpOnFlag(bool status, std::string_view instructionName);
 		inline uint8_t CallOnFlag(bool status, std::string_view instructionName);
+		int Trap();
 		inline uint8_t Push(const Register& hi, const Register& low);
 		inline uint8_t Adi(const Register& r);
 		inline uint8_t Rst();
@@ -201,13 +207,19 @@ namespace meen
 		/* I8080 overrides */
 		uint8_t Execute() final;
 		uint8_t Interrupt(ISR isr);
+		bool InterruptsEnabled() const final;
 		std::error_code Load(const std::string&& json, bool checkUuid) final;
+		std::expected<CpuState, std::error_code> Parse(const std::string&& json, bool checkUuid) const final;
+		void Apply(const CpuState& state) final;
 #ifdef ENABLE_MEEN_SAVE
 		std::expected<std::string, std::error_code> Save() const final;
 #endif // ENABLE_MEEN_SAVE
 		void Reset() final;
 		void SetMemoryController(IController* memoryController) final;
 		void SetIoController(IController* ioController) final;
+		void SetFetchController(IController* fetchController) final;
+		void SetIoPorts(const IoPortTable* ioPorts) final;
+		void SetTrap(uint16_t address, std::function<int(Registers& registers)>&& trap) final;
 		/* End I8080 overrides */
 
 		Intel8080();
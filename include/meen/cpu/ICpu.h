@@ -23,9 +23,12 @@ SOFTWARE.
 #ifndef ICPU_H
 #define ICPU_H
 
+#include <array>
 #include <cstdint>
 #include <expected>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <system_error>
 
@@ -34,21 +37,65 @@ SOFTWARE.
 
 namespace meen
 {
+	// An entry in the io port table, a latched port reads and writes the latch byte directly, otherwise the controller is called
+	struct IoPort
+	{
+		uint8_t* latch;
+		IController* controller;
+	};
+
+	using IoPortTable = std::array<IoPort, 256>;
+
+	// A cpu state read from json, the registers that are absent keep their value when it is applied
+	struct CpuState
+	{
+		// The json has no registers object, all registers are reset before the state is applied
+		bool resetRegisters{};
+		std::optional<uint8_t> a;
+		std::optional<uint8_t> b;
+		std::optional<uint8_t> c;
+		std::optional<uint8_t> d;
+		std::optional<uint8_t> e;
+		std::optional<uint8_t> h;
+		std::optional<uint8_t> l;
+		std::optional<uint8_t> s;
+		std::optional<uint16_t> pc;
+		std::optional<uint16_t> sp;
+	};
+
 	struct ICpu
 	{
 		virtual void SetMemoryController(IController* memoryController) = 0;
 
 		virtual void SetIoController(IController* ioController) = 0;
 
+		// The controller to fetch opcodes from, SetMemoryController resets it to the memory controller
+		virtual void SetFetchController(IController* fetchController) = 0;
+
+		// The per port dispatch table for IN and OUT, when nullptr all ports are routed to the io controller
+		virtual void SetIoPorts(const IoPortTable* ioPorts) = 0;
+
+		// A handler run in place of a call to address, it returns the cycles it took or a negative value to make the call
+		virtual void SetTrap(uint16_t address, std::function<int(Registers& registers)>&& trap) = 0;
+
 		//Executes the next instruction
 		virtual uint8_t Execute() = 0;
 
 		virtual uint8_t Interrupt(ISR isr) = 0;
 
+		// True when the cpu will accept an interrupt at the current instruction boundary
+		virtual bool InterruptsEnabled() const = 0;
+
 		virtual void Reset() = 0;
 
 		virtual std::error_code Load(const std::string&& json, bool checkUuid) = 0;
 
+		// Read a json cpu state without changing the cpu, it may be called from another thread while the cpu is executing
+		virtual std::expected<CpuState, std::error_code> Parse(const std::string&& json, bool checkUuid) const = 0;
+
+		// Apply a state read by Parse, Load is Parse followed by Apply
+		virtual void Apply(const CpuState& state) = 0;
+
 #ifdef ENABLE_MEEN_SAVE
 		virtual std::expected<std::string, std::error_code> Save() const = 0;
 #endif // ENABLE_MEEN_SAVE
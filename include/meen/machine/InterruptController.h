@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef INTERRUPTCONTROLLER_H
+#define INTERRUPTCONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "meen/Base.h"
+
+namespace meen
+{
+	/** Programmable interrupt controller
+
+		Modelled on the 8259, it latches the cpu level interrupts (ISR::Zero to ISR::Seven) raised
+		by the io controllers, the scheduler and the interrupt mailbox into per line pending bits.
+		The highest priority unmasked pending line is delivered once the cpu has interrupts enabled,
+		an interrupt raised while the cpu has interrupts disabled is no longer lost.
+
+		There is no in-service register, the cpu clears its interrupt enable flag when it acknowledges
+		an interrupt which serialises delivery until the guest executes EI.
+
+		The pending bits are only accessed by the thread running the machine, the mask and the priority
+		may be changed from any thread.
+	*/
+	class InterruptController
+	{
+	private:
+		uint8_t pending_{};
+		std::atomic<uint8_t> mask_{};
+		// The line with the highest priority, the priority decreases with each subsequent line wrapping from seven to zero
+		std::atomic<uint8_t> highest_{};
+	public:
+		/** Raise
+
+			Latch an interrupt line.
+
+			@param	isr		The interrupt to latch, ISR::Zero to ISR::Seven.
+		*/
+		void Raise(ISR isr)
+		{
+			pending_ |= 1 << static_cast<uint8_t>(isr);
+		}
+
+		/** Requested
+
+			@return		True when an unmasked line is pending.
+		*/
+		bool Requested() const
+		{
+			return (pending_ & ~mask_.load(std::memory_order_relaxed)) != 0;
+		}
+
+		/** Acknowledge
+
+			Clear the highest priority unmasked pending line.
+
+			@return		The interrupt for the line or ISR::NoInterrupt when no unmasked lines are pending.
+		*/
+		ISR Acknowledge();
+
+		/** Reset
+
+			Clear all pending lines, the mask and priority are retained.
+		*/
+		void Reset();
+
+		void SetMask(uint8_t mask);
+		void SetPriority(ISR highest);
+	};
+} // namespace meen
+
+#endif // INTERRUPTCONTROLLER_H
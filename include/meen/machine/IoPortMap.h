@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef IOPORTMAP_H
+#define IOPORTMAP_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "meen/IController.h"
+#include "meen/cpu/ICpu.h"
+
+namespace meen
+{
+	/** IO port map
+
+		The ports that have been mapped to a latch byte or to a pair of handlers via IMachine::MapIoPort
+		and the io controllers that have been attached to a range of ports.
+
+		When the machine starts running the map is resolved into a flat 256 entry table that the cpu
+		indexes with the port number on each IN and OUT. A port mapped via IMachine::MapIoPort takes
+		precedence over a controller attached to a range that contains it, the ports that have not been
+		mapped are routed to the default io controller.
+	*/
+	class IoPortMap
+	{
+	private:
+		/** Port handler
+
+			Adapts the read and write handlers of a port to the controller interface.
+		*/
+		struct Handler final : public IController
+		{
+			std::function<uint8_t(uint8_t port)> read;
+			std::function<void(uint8_t port, uint8_t value)> write;
+
+			std::array<uint8_t, 16> Uuid() const final;
+			uint8_t Read(uint16_t port, IController* controller) final;
+			void Write(uint16_t port, uint8_t value, IController* controller) final;
+			ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+		};
+
+	public:
+		/** An io controller attached to a range of ports
+		*/
+		struct Device
+		{
+			IControllerPtr controller;
+			uint8_t firstPort;
+			uint8_t lastPort;
+			// The number of times per second of cpu time that the controller is polled for interrupts, 0 polls after each instruction.
+			// Either way the controller is not polled again before the time it returns from IController::NextPoll.
+			double isrFreq;
+		};
+	private:
+		std::array<uint8_t*, 256> latches_{};
+		std::vector<Device> devices_;
+		std::array<std::unique_ptr<Handler>, 256> handlers_;
+		IoPortTable table_{};
+		// The number of mapped ports
+		int mapped_{};
+	public:
+		void Map(uint8_t port, uint8_t* latch);
+		void Map(uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write);
+		void Unmap(uint8_t port);
+
+		/** Overlaps
+
+			@return		True when the port range overlaps the range of an attached device.
+		*/
+		bool Overlaps(uint8_t firstPort, uint8_t lastPort) const;
+
+		void Attach(IControllerPtr&& controller, uint8_t firstPort, uint8_t lastPort, double isrFreq);
+
+		/** Detach a device
+
+			@param	port	A port in the range of the device to detach.
+
+			@return			The detached device controller or nullptr when no device is attached to the port.
+		*/
+		IControllerPtr Detach(uint8_t port);
+
+		const std::vector<Device>& Devices() const;
+
+		/** Resolve
+
+			Build the port table.
+
+			@param	ioController	The controller the unmapped ports are routed to.
+
+			@return					The port table or nullptr when no ports are mapped, in which
+									case the cpu calls the io controller directly.
+		*/
+		const IoPortTable* Resolve(IController* ioController);
+	};
+} // namespace meen
+
+#endif // IOPORTMAP_H
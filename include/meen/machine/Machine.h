@@ -27,15 +27,24 @@ SOFTWARE.
 #ifdef PICO_BOARD
 #include <mutex>
 #else
+#include <condition_variable>
 #include <future>
+#include <mutex>
+#include <thread>
 #endif
-#include <map>
 #include <source_location>
 
 #include "meen/IController.h"
 #include "meen/cpu/ICpu.h"
 #include "meen/clock/ICpuClock.h"
 #include "meen/IMachine.h"
+#include "meen/machine/InterruptController.h"
+#include "meen/machine/IoPortMap.h"
+#include "meen/machine/MemoryRegions.h"
+#include "meen/machine/MpscQueue.h"
+#include "meen/machine/ProfileController.h"
+#include "meen/machine/Scheduler.h"
+#include "meen/machine/WatchController.h"
 #include "meen/opt/Opt.h"
 
 namespace meen
@@ -61,13 +70,72 @@ namespace meen
 		int64_t ticksPerIsr_{};
 		uint64_t runTime_{};
 		std::atomic_bool quit_{};
+		// A machine state decoded from the json returned by the onLoad handler
+		struct LoadImage;
+		// The run loop state of a run that was suspended by RunFor, nullptr when no run is in progress
+		struct RunState;
+		std::unique_ptr<RunState> runState_;
+		// Marks the machine as no longer running if a synchronous run exits with an exception
+		struct RunGuard;
+		// The fraction of a cycle left over from the last RunFor duration
+		double cycleFraction_{};
+		// The run mode of the current run, RunFor always runs synchronously
+		bool async_{};
 #ifdef PICO_BOARD
 
 #else
 		std::future<void> fut_;
+		// The worker that services the async runs, started by the first async run and reused by the following ones
+		std::thread worker_;
+		std::mutex workerMutex_;
+		std::condition_variable workerCv_;
+		// The completion of the requested run, fulfilled by the worker when RunMachine returns
+		std::promise<void> runDone_;
+		bool runRequested_{};
+		bool workerExit_{};
+		void Worker();
+		// Wakes the idle loop early when the machine quits, a load or save completes or a controller calls IScheduler::Wake
+		std::mutex idleMutex_;
+		std::condition_variable idleCv_;
+		bool idleEvent_{};
+		// Holds the run loop while the machine is paused
+		std::mutex pauseMutex_;
+		std::condition_variable pauseCv_;
+		bool paused_{};
+		// Set when a quit is posted so that a paused machine stops waiting and services it
+		bool quitPosted_{};
 #endif // PICO_BOARD
-		std::map<uint16_t, uint16_t> romMetadata_;
-		std::map<uint16_t, uint16_t> ramMetadata_;
+		// The rom and ram layout of the last load
+		MemoryRegions memoryRegions_;
+#ifdef ENABLE_MEEN_SAVE
+		// The memory read back by the last save, kept across runs so that subsequent saves only re-read the pages that the memory controller reports as dirty
+		std::vector<uint8_t> savedRam_;
+		// savedRam_ encoded and compressed, only re-encoded when a ram page changes
+		std::string savedRamTxt_;
+		std::array<uint8_t, 16> savedRomMd5_{};
+		// Cleared by a load, a memory controller change or an options change
+		bool savedMemoryValid_{};
+#endif // ENABLE_MEEN_SAVE
+		// One bit per posted interrupt: ISR::Zero to ISR::Seven then ISR::Save, ISR::Load and ISR::Quit
+		std::atomic<uint32_t> mailbox_{};
+		// The mailbox bit that requests the run loop to poll the io controllers at the next instruction boundary
+		static constexpr uint32_t wake_ = 1u << 31;
+		// The mailbox bit that requests the run loop to pause at the next instruction boundary
+		static constexpr uint32_t pause_ = 1u << 30;
+		// The mailbox bit that tells the run loop that commands have been posted
+		static constexpr uint32_t command_ = 1u << 29;
+		// The commands posted via PostCommand
+		MpscQueue<Command, 64> commands_;
+		// Interrupts scheduled by the attached controllers, bound to the run loop cycle count while running
+		Scheduler scheduler_{ &mailbox_, wake_, [this] { NotifyIdle(); } };
+		// The io ports mapped to latches or handlers, resolved into the cpu port table when the machine runs
+		IoPortMap ioPortMap_;
+		// Latches the cpu level interrupts until the cpu accepts them
+		InterruptController interruptController_;
+		// Created on demand when the first watchpoint is armed
+		std::unique_ptr<WatchController> watchController_;
+		// Created when the memoryProfile option is enabled
+		std::unique_ptr<ProfileController> profileController_;
 		//cppcheck-suppress unusedStructMember
 		bool running_{};
 		std::function<void(std::error_code ec, const char* fileName, const char* functionName, uint32_t line, uint32_t column, IController* ioController)> onError_;
@@ -75,6 +143,9 @@ namespace meen
 		std::function<errc(IController* ioController)> onInit_;
 		std::function<errc(char* json, int* jsonLen, IController* ioController)> onLoad_;
 		std::function<errc(IController* ioController)> onLoadComplete_;
+		std::function<bool(uint16_t address, Watch watch, IController* ioController)> onWatch_;
+		std::function<int(Registers& registers, IController* memoryController)> onTrap_;
+		uint16_t trapAddress_{};
 #ifdef ENABLE_MEEN_SAVE
 		std::function<errc(char* uri, int* uriLen, IController* ioController)> onSaveBegin_;
 		std::function<errc(const char* location, const char* json, IController* ioController)> onSave_;
@@ -86,10 +157,22 @@ namespace meen
 		std::once_flag initOnceFlag_;
 		std::error_code HandleError(std::error_code err, std::source_location&& sl);
 		std::error_code HandleError(errc ec, std::source_location&& sl);
-		friend void RunMachine(Machine* machine);
+		void NotifyIdle();
+		std::error_code StartRun(bool async);
+		void EndRun();
+		bool WaitWhilePaused();
+		void StopPauseWait();
+
+		// The mutating methods are unavailable while the machine is running or suspended by RunFor
+		bool Busy() const
+		{
+			return running_ == true || runState_ != nullptr;
+		}
+
+		friend void RunMachine(Machine* machine, int64_t cycles);
 	public:
 		Machine(Cpu cpu);
-		~Machine() = default;
+		~Machine();
 
 		/** Run
 
@@ -97,6 +180,24 @@ namespace meen
 		*/
 		std::expected<uint64_t, std::error_code> Run() final;
 
+		/** RunFor
+
+			@see IMachine::RunFor
+		*/
+		std::expected<bool, std::error_code> RunFor(uint64_t cycles) final;
+
+		/** RunFor
+
+			@see IMachine::RunFor
+		*/
+		std::expected<bool, std::error_code> RunFor(std::chrono::nanoseconds duration) final;
+
+		/** RunAwait
+
+			@see IMachine::RunAwait
+		*/
+		RunAwaitable RunAwait(Executor&& executor, uint64_t slice) final;
+
 		/** AttachMemoryController
 
 			@see IMachine::AttachMemoryController
@@ -121,6 +222,18 @@ namespace meen
 		*/
 		std::expected<IControllerPtr, std::error_code> DetachIoController () final;
 
+		/** AttachIoController
+
+			@see IMachine::AttachIoController
+		*/
+		std::error_code AttachIoController(IControllerPtr&& controller, uint8_t firstPort, uint8_t lastPort, double isrFreq) final;
+
+		/** DetachIoController
+
+			@see IMachine::DetachIoController
+		*/
+		std::expected<IControllerPtr, std::error_code> DetachIoController(uint8_t port) final;
+
 		/** SetOptions
 
 			@see IMachine::SetOpts
@@ -156,6 +269,90 @@ namespace meen
 			@see IMachine::OnError
 		*/
 		std::error_code OnError(std::function<void(std::error_code ec, const char* fileName, const char* functionName, uint32_t line, uint32_t column, IController* ioController)>&& onError) final;
+
+		/** MemoryProfile
+
+			@see IMachine::MemoryProfile
+		*/
+		std::error_code MemoryProfile(std::function<void(uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)>&& visitor) final;
+
+		/** ArmWatchpoint
+
+			@see IMachine::ArmWatchpoint
+		*/
+		std::error_code ArmWatchpoint(uint16_t address, Watch watch) final;
+
+		/** DisarmWatchpoint
+
+			@see IMachine::DisarmWatchpoint
+		*/
+		std::error_code DisarmWatchpoint(uint16_t address, Watch watch) final;
+
+		/** OnWatch
+
+			@see IMachine::OnWatch
+		*/
+		std::error_code OnWatch(std::function<bool(uint16_t address, Watch watch, IController* ioController)>&& onWatch) final;
+
+		/** OnTrap
+
+			@see IMachine::OnTrap
+		*/
+		std::error_code OnTrap(uint16_t address, std::function<int(Registers& registers, IController* memoryController)>&& onTrap) final;
+
+		/** PostInterrupt
+
+			@see IMachine::PostInterrupt
+		*/
+		std::error_code PostInterrupt(ISR isr) final;
+
+		/** Pause
+
+			@see IMachine::Pause
+		*/
+		std::error_code Pause() final;
+
+		/** PostCommand
+
+			@see IMachine::PostCommand
+		*/
+		std::error_code PostCommand(const Command& command) final;
+
+		/** Resume
+
+			@see IMachine::Resume
+		*/
+		std::error_code Resume() final;
+
+		/** SetInterruptMask
+
+			@see IMachine::SetInterruptMask
+		*/
+		std::error_code SetInterruptMask(uint8_t mask) final;
+
+		/** SetInterruptPriority
+
+			@see IMachine::SetInterruptPriority
+		*/
+		std::error_code SetInterruptPriority(ISR highest) final;
+
+		/** MapIoPort
+
+			@see IMachine::MapIoPort
+		*/
+		std::error_code MapIoPort(uint8_t port, uint8_t* latch) final;
+
+		/** MapIoPort
+
+			@see IMachine::MapIoPort
+		*/
+		std::error_code MapIoPort(uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write) final;
+
+		/** UnmapIoPort
+
+			@see IMachine::UnmapIoPort
+		*/
+		std::error_code UnmapIoPort(uint8_t port) final;
 	};
 } // namespace meen
 
@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEMORYREGIONS_H
+#define MEMORYREGIONS_H
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "meen/IController.h"
+
+namespace meen
+{
+	/** Memory regions
+
+		A compact description of the rom and ram layout of the 16 bit address space.
+
+		The rom blocks are kept in a vector sorted by offset from which the ram blocks (the gaps
+		between the rom blocks) are derived, along with a map of the 256 byte pages that each
+		of them touch. The blocks are transferred to and from a memory controller with memcpy
+		when the controller supports direct memory access and a byte at a time otherwise.
+	*/
+	class MemoryRegions
+	{
+	public:
+		struct Extent
+		{
+			uint16_t offset;
+			uint16_t size;
+		};
+	private:
+		std::vector<Extent> rom_;
+		std::vector<Extent> ram_;
+		std::bitset<256> romPages_;
+		std::bitset<256> ramPages_;
+		size_t romSize_{};
+		size_t ramSize_{};
+	public:
+		/** Clear the rom blocks
+
+			The ram blocks are left unchanged until the next call to Build.
+		*/
+		void ClearRom();
+
+		/** Add a rom block
+
+			The block is ignored when a block already exists at the same offset.
+		*/
+		void AddRom(uint16_t offset, uint16_t size);
+
+		/** Build the ram blocks
+
+			Derive the ram blocks from the rom blocks, all memory below 0xFFFF that is not rom is ram.
+		*/
+		void Build();
+
+		const std::vector<Extent>& Rom() const;
+		const std::vector<Extent>& Ram() const;
+
+		/** Rom size
+
+			@return		The total number of bytes in all rom blocks.
+		*/
+		size_t RomSize() const;
+
+		/** Ram size
+
+			@return		The total number of bytes in all ram blocks.
+		*/
+		size_t RamSize() const;
+
+		/** Rom pages
+
+			@return		The 256 byte pages that contain at least one byte of rom.
+		*/
+		const std::bitset<256>& RomPages() const;
+
+		/** Ram pages
+
+			@return		The 256 byte pages that contain at least one byte of ram.
+		*/
+		const std::bitset<256>& RamPages() const;
+
+		/** Gather the bytes of each extent
+
+			@param	memoryController	The controller to read from.
+			@param	extents				The blocks to read in order.
+			@param	dst					The buffer to write the bytes to, it must be large enough to hold all extents.
+			@param	ioController		The controller passed to each IController::Read.
+		*/
+		static void Gather(IController* memoryController, const std::vector<Extent>& extents, uint8_t* dst, IController* ioController);
+
+		/** Scatter bytes to each extent
+
+			@param	memoryController	The controller to write to.
+			@param	extents				The blocks to write in order.
+			@param	src					The bytes to write, it must hold the bytes for all extents.
+			@param	ioController		The controller passed to each IController::Write.
+		*/
+		static void Scatter(IController* memoryController, const std::vector<Extent>& extents, const uint8_t* src, IController* ioController);
+
+		/** Read a contiguous block of memory
+
+			Uses a direct memcpy from IController::Memory when available.
+		*/
+		static void Read(IController* memoryController, uint16_t offset, uint8_t* dst, size_t len, IController* ioController);
+
+		/** Write a contiguous block of memory
+
+			Uses a direct memcpy to IController::Memory when available and marks the written pages dirty.
+		*/
+		static void Write(IController* memoryController, uint16_t offset, const uint8_t* src, size_t len, IController* ioController);
+
+		/** Fill a contiguous block of memory
+
+			Uses a direct memset of IController::Memory when available and marks the written pages dirty.
+		*/
+		static void Fill(IController* memoryController, uint16_t offset, uint8_t value, size_t len, IController* ioController);
+	};
+} // namespace meen
+
+#endif // MEMORYREGIONS_H
@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace meen
+{
+	/** Multiple producer single consumer queue
+
+		A lock free bounded queue where any number of threads push and a single thread pops.
+
+		Each cell carries a sequence number that tells a producer whether the cell is free for the
+		position it claimed and tells the consumer whether the value in the cell has been published.
+		Producers claim a position with a compare and swap on the tail, the consumer owns the head.
+
+		@tparam		T	The element type.
+		@tparam		N	The capacity of the queue, it must be a power of 2.
+	*/
+	template<typename T, size_t N>
+	class MpscQueue
+	{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "The queue capacity must be a power of 2");
+
+		static constexpr size_t cacheLine_ = 64;
+
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		alignas(cacheLine_) std::atomic<size_t> tail_{};
+		alignas(cacheLine_) size_t head_{};
+		alignas(cacheLine_) std::array<Cell, N> cells_;
+	public:
+		MpscQueue()
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				cells_[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/** Push
+
+			May be called from any thread.
+
+			@param	value	The value to append to the queue.
+
+			@return			false when the queue is full, the value is not added.
+		*/
+		bool Push(const T& value)
+		{
+			auto pos = tail_.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				auto& cell = cells_[pos & (N - 1)];
+				auto diff = static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+
+				if (diff == 0)
+				{
+					// the cell is free, claim the position
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) == true)
+					{
+						cell.value = value;
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					// the consumer has not popped the value a lap behind
+					return false;
+				}
+				else
+				{
+					// another producer claimed the position
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/** Pop
+
+			Called from the consumer thread only.
+
+			@param	value	Receives the oldest value in the queue.
+
+			@return			false when the queue is empty.
+		*/
+		bool Pop(T& value)
+		{
+			auto& cell = cells_[head_ & (N - 1)];
+
+			if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+			{
+				return false;
+			}
+
+			value = cell.value;
+			// free the cell for the producers on the next lap
+			cell.sequence.store(head_ + N, std::memory_order_release);
+			head_++;
+			return true;
+		}
+
+		/** Capacity
+
+			@return		The maximum number of values the queue can hold.
+		*/
+		static constexpr size_t Capacity()
+		{
+			return N;
+		}
+	};
+} // namespace meen
+
+#endif // MPSCQUEUE_H
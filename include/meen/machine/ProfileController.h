@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PROFILECONTROLLER_H
+#define PROFILECONTROLLER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "meen/IController.h"
+
+namespace meen
+{
+	/** Memory profile controller
+
+		A proxy that sits between the cpu and the attached memory controller and
+		counts the reads, writes and instruction fetches made by the cpu, either per
+		256 byte page or per address.
+
+		The machine only installs this proxy into the cpu when the `memoryProfile`
+		option is enabled. Every access is counted, there is no sampling. The counters are
+		only ever written by the thread running the machine, they are incremented without
+		a read-modify-write so they remain cheap, while still allowing them to be read from
+		another thread while the machine is running.
+
+		The direct memory access of the attached controller is forwarded, io devices that
+		transfer guest memory through it (DMA) are not counted as only the cpu accesses are
+		profiled.
+	*/
+	class ProfileController final : public IController
+	{
+	private:
+		/** Instruction fetch proxy
+
+			The cpu uses this controller to fetch opcodes, reads are counted as fetches.
+		*/
+		struct FetchController final : public IController
+		{
+			ProfileController* profileController_{};
+
+			std::array<uint8_t, 16> Uuid() const final;
+			uint8_t Read(uint16_t address, IController* controller) final;
+			void Write(uint16_t address, uint8_t value, IController* controller) final;
+			ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+			DirtyPageMap* DirtyPages() final;
+			std::span<uint8_t> Memory() final;
+			std::span<const uint8_t> MemoryView() final;
+		};
+
+		enum Counter
+		{
+			Reads,
+			Writes,
+			Fetches,
+			Count
+		};
+
+		IController* memoryController_{};
+		FetchController fetchController_;
+		// 8 when counting per page, 0 when counting per address
+		int shift_{};
+		// Counter::Count counters for each page or address
+		std::unique_ptr<std::atomic<uint64_t>[]> counters_;
+
+		void Increment(uint16_t address, Counter counter)
+		{
+			auto& c = counters_[(address >> shift_) * Counter::Count + counter];
+			c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	public:
+		/** Profile controller constructor
+
+			@param	perAddress	True to count each address, false to count each 256 byte page.
+		*/
+		explicit ProfileController(bool perAddress);
+
+		void SetMemoryController(IController* memoryController);
+
+		/** Instruction fetch controller
+
+			@return		The controller the cpu should fetch opcodes from.
+		*/
+		IController* Fetch();
+
+		/** Per address counters
+
+			@return		True when counting each address, false when counting each page.
+		*/
+		bool PerAddress() const;
+
+		/** Visit the counters
+
+			Call the visitor for each page or address that has been accessed at least once.
+
+			@param	visitor		Called with the address (the first address of the page when counting
+								per page) and its read, write and fetch counts.
+
+			@remark				This method is safe to call while the machine is running, but the counts are
+								only consistent with each other once the machine has stopped.
+		*/
+		void Visit(const std::function<void(uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)>& visitor) const;
+
+		std::array<uint8_t, 16> Uuid() const final;
+		uint8_t Read(uint16_t address, IController* controller) final;
+		void Write(uint16_t address, uint8_t value, IController* controller) final;
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+		DirtyPageMap* DirtyPages() final;
+		std::span<uint8_t> Memory() final;
+		std::span<const uint8_t> MemoryView() final;
+	};
+} // namespace meen
+
+#endif // PROFILECONTROLLER_H
@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "meen/IScheduler.h"
+
+namespace meen
+{
+	/** Event scheduler
+
+		A min-heap of interrupts keyed on the cycle count at which they are due.
+
+		Alongside the scheduled events the scheduler tracks the cycle count at which the
+		io controller is next polled, the run loop only needs to compare the cycle count
+		against a single deadline after each instruction: the earlier of the two.
+	*/
+	class Scheduler final : public IScheduler
+	{
+	private:
+		struct Event
+		{
+			int64_t cycle;
+			// The order the event was scheduled in, events due on the same cycle are delivered first in first out
+			uint64_t sequence;
+			ISR isr;
+		};
+
+		static constexpr int64_t never_{ std::numeric_limits<int64_t>::max() };
+
+		std::vector<Event> events_;
+		uint64_t sequence_{};
+		// The cycle count of the running machine, nullptr when the machine is not running
+		const int64_t* cycles_{};
+		// The machine interrupt mailbox and the bit that requests a poll
+		std::atomic<uint32_t>* mailbox_{};
+		uint32_t wake_{};
+		// Called from Wake, notifies the machine idle loop
+		std::function<void()> onWake_;
+		int64_t poll_{};
+		int64_t deadline_{ never_ };
+
+		static bool Later(const Event& lhs, const Event& rhs);
+		void Update();
+	public:
+		uint64_t Now() const final;
+		std::error_code Schedule(uint64_t cycle, ISR isr) final;
+		void Cancel(ISR isr) final;
+		void Wake() final;
+
+		/** Scheduler
+
+			@param	mailbox		The machine interrupt mailbox.
+			@param	wake		The mailbox bit that requests the run loop to poll the io controllers.
+			@param	onWake		An optional handler called from Wake after the mailbox bit is set.
+		*/
+		Scheduler(std::atomic<uint32_t>* mailbox, uint32_t wake, std::function<void()>&& onWake = nullptr);
+
+		/** Start
+
+			Bind the scheduler to the cycle count of the run loop and discard any pending events.
+
+			@param	cycles	The cycle count of the run loop or nullptr when the machine stops running.
+		*/
+		void Start(const int64_t* cycles);
+
+		/** Next poll
+
+			@param	cycle	The cycle count at which the io controller is next polled for interrupts.
+		*/
+		void SetPoll(int64_t cycle);
+
+		/** Poll
+
+			@return		The cycle count at which the io controller is next polled for interrupts.
+		*/
+		int64_t Poll() const
+		{
+			return poll_;
+		}
+
+		/** Deadline
+
+			@return		The earlier of the next poll and the next scheduled event.
+		*/
+		int64_t Deadline() const
+		{
+			return deadline_;
+		}
+
+		/** Next event
+
+			@return		The cycle count of the next scheduled event or the maximum int64_t value when there are none.
+		*/
+		int64_t Next() const;
+
+		/** Pop
+
+			Remove the next event that is due.
+
+			@return		The interrupt of the next event that is due or ISR::NoInterrupt when no events are due.
+		*/
+		ISR Pop();
+	};
+} // namespace meen
+
+#endif // SCHEDULER_H
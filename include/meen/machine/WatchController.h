@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef WATCHCONTROLLER_H
+#define WATCHCONTROLLER_H
+
+#include <array>
+#include <bitset>
+#include <functional>
+#include <vector>
+
+#include "meen/Base.h"
+#include "meen/IController.h"
+
+namespace meen
+{
+	/** Watchpoint memory controller
+
+		A proxy that sits between the cpu and the attached memory controller and
+		records the accesses to armed guest addresses.
+
+		The machine only installs this proxy into the cpu when at least one watchpoint
+		is armed, the cpu talks directly to the memory controller otherwise. Each access
+		consults a per page flag before the per address bitmap is checked, hence accesses
+		to pages without any armed addresses only pay for the page lookup.
+
+		The direct memory access of the attached controller is forwarded, io devices that
+		transfer guest memory through it (DMA) do not trigger watchpoints as only the cpu
+		accesses are watched.
+	*/
+	class WatchController final : public IController
+	{
+	private:
+		/** Instruction fetch proxy
+
+			The cpu uses this controller to fetch opcodes, reads are reported as Watch::Exec.
+		*/
+		struct FetchController final : public IController
+		{
+			WatchController* watchController_{};
+
+			std::array<uint8_t, 16> Uuid() const final;
+			uint8_t Read(uint16_t address, IController* controller) final;
+			void Write(uint16_t address, uint8_t value, IController* controller) final;
+			ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+			DirtyPageMap* DirtyPages() final;
+			std::span<uint8_t> Memory() final;
+			std::span<const uint8_t> MemoryView() final;
+		};
+
+		static constexpr int watchTypes_ = 3;
+
+		IController* memoryController_{};
+		// The controller that opcodes are fetched from when exec watchpoints are armed
+		IController* fetchMemoryController_{};
+		FetchController fetchController_;
+		// A bit per watch type for each page that contains at least one armed address
+		std::array<uint8_t, 256> pages_{};
+		std::array<std::bitset<1 << 16>, watchTypes_> addresses_;
+		std::vector<std::pair<uint16_t, Watch>> hits_;
+		std::function<void()> onHit_;
+
+		void Hit(uint16_t address, Watch watch);
+	public:
+		WatchController();
+
+		/** Set the proxied controllers
+
+			@param	memoryController		The controller that data reads and writes are forwarded to.
+			@param	fetchMemoryController	The controller that instruction fetches are forwarded to.
+		*/
+		void SetMemoryController(IController* memoryController, IController* fetchMemoryController);
+
+		/** Instruction fetch controller
+
+			@return		The controller the cpu should fetch opcodes from when exec watchpoints are armed.
+		*/
+		IController* Fetch();
+
+		void Arm(uint16_t address, Watch watch);
+		void Disarm(uint16_t address, Watch watch);
+
+		/** Armed
+
+			@return		True if at least one address is armed for the specified watch type.
+		*/
+		bool Armed(Watch watch) const;
+
+		/** Hit notification
+
+			Registers a handler that is invoked from the cpu thread each time an armed address is accessed.
+		*/
+		void OnHit(std::function<void()>&& onHit);
+
+		/** Hits
+
+			@return		The watchpoints that have been hit in the order they occurred since the last call to ClearHits.
+		*/
+		const std::vector<std::pair<uint16_t, Watch>>& Hits() const;
+		void ClearHits();
+
+		std::array<uint8_t, 16> Uuid() const final;
+		uint8_t Read(uint16_t address, IController* controller) final;
+		void Write(uint16_t address, uint8_t value, IController* controller) final;
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+		DirtyPageMap* DirtyPages() final;
+		std::span<uint8_t> Memory() final;
+		std::span<const uint8_t> MemoryView() final;
+	};
+} // namespace meen
+
+#endif // WATCHCONTROLLER_H
@@ -11,6 +11,7 @@ namespace meen
         void Write(uint16_t address, uint8_t value, IController* controller) final;
         meen::ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
         std::array<uint8_t, 16> Uuid() const final;
+        void SetScheduler(IScheduler* scheduler) final;
     };
 } // namespace meen
 
@@ -36,7 +36,8 @@ namespace meen
 {
 	/** Machine options
 
-		A wrapper around json option parsing.
+		A wrapper around json option parsing. The options are compiled into a typed
+		snapshot each time they are set so reading them does not perform a json lookup.
 
 		@see	meen::MakeMachine for configuration options.
 
@@ -55,12 +56,41 @@ namespace meen
 #else
 			JsonDocument json_{};
 
-			mutable std::string encoder_;
-
-			mutable std::string compressor_;
-
 			static void Merge(JsonVariant dst, JsonVariantConst src);
 #endif
+			/**
+				Typed options
+
+				The merged json options compiled by SetOptions, the accessors read these values.
+			*/
+			struct Values
+			{
+				double clockSamplingFreq{};
+				double isrFreq{};
+				bool runAsync{};
+				int idlePeriod{};
+				std::string compressor;
+				std::string encoder;
+				bool loadAsync{};
+#ifdef ENABLE_MEEN_SAVE
+				bool saveAsync{};
+#endif // ENABLE_MEEN_SAVE
+				int maxLoadStateLen{};
+				std::string memoryProfile;
+				std::vector<int> cpuAffinity;
+				std::string schedPolicy;
+				int schedPriority{};
+				bool lockMemory{};
+			};
+
+			Values values_{};
+
+			/**
+				Compile the options
+
+				Read the merged json options into the typed options.
+			*/
+			void Compile();
 			/**
 				Default options
 
@@ -90,7 +120,8 @@ namespace meen
 
 				@return		no_error: all options were set successfully.<br>
 							json_parse: the json input is malformed.<br>
-							json_config: the isr frequency is negative.<br>
+							json_config: the isr frequency, idle period or scheduling priority is negative, the cpu affinity is not an array of cpu indices
+							or the memory profile or scheduling policy is unknown.<br>
 							compressor: a compressor option was specifed but that compressor has been disabled.
 			*/
 			std::error_code SetOptions(const char* json);
@@ -99,52 +130,133 @@ namespace meen
 
 				The frequency in Hertz at which the host clock is sampled.
 			*/
-			double ClockSamplingFreq() const;
+			double ClockSamplingFreq() const
+			{
+				return values_.clockSamplingFreq;
+			}
 
 			/** Interrupt service routine frequency
 
 				A multipler applied to the machine clock resolution to alter the rate
 				at which interrupts are serviced.
 			*/
-			double ISRFreq() const;
+			double ISRFreq() const
+			{
+				return values_.isrFreq;
+			}
 
 			/** Machine run mode
 
 				True for asynchronous, false for synchronous.
 			*/
-			bool RunAsync() const;
+			bool RunAsync() const
+			{
+				return values_.runAsync;
+			}
+
+			/** Idle period
+
+				The maximum time in milliseconds that the idle loop waits between calls to the
+				IMachine::OnIdle handler when the machine is running asynchronously, 0 calls it continuously.
+			*/
+			int IdlePeriod() const
+			{
+				return values_.idlePeriod;
+			}
 
 			/** Compressor
 
 				Supported compressors, currently only zlib is supported.
 			*/
-			const std::string& Compressor() const;
+			const std::string& Compressor() const
+			{
+				return values_.compressor;
+			}
 
 			/** Text to binary encoder
 
 				Supported encoders, currently only base64 is supported.
 			*/
-			const std::string& Encoder() const;
+			const std::string& Encoder() const
+			{
+				return values_.encoder;
+			}
 
 			/** Machine state load mode
 
 				True for asynchronous, false for synchronous.
 			*/
-			bool LoadAsync() const;
+			bool LoadAsync() const
+			{
+				return values_.loadAsync;
+			}
 
 #ifdef ENABLE_MEEN_SAVE
 			/** Machine state save mode
 
 				True for asynchronous, false for synchronous.
 			*/
-			bool SaveAsync() const;
+			bool SaveAsync() const
+			{
+				return values_.saveAsync;
+			}
 #endif
 			/**	The maximum length of the json machine state asset
 
 				This is the length of the buffer passed to the OnLoad
 				registration handler.
 			*/
-			int MaxLoadStateLength() const;
+			int MaxLoadStateLength() const
+			{
+				return values_.maxLoadStateLen;
+			}
+
+			/** Memory access profile mode
+
+				none: no profiling, page: count accesses per 256 byte page, address: count accesses per address.
+			*/
+			const std::string& MemoryProfile() const
+			{
+				return values_.memoryProfile;
+			}
+
+			/** Machine thread cpu affinity
+
+				The host cpus the asynchronous machine thread may run on, empty for no restriction.
+			*/
+			const std::vector<int>& CpuAffinity() const
+			{
+				return values_.cpuAffinity;
+			}
+
+			/** Machine thread scheduling policy
+
+				other: the default time sharing policy, fifo: SCHED_FIFO, rr: SCHED_RR.
+			*/
+			const std::string& SchedPolicy() const
+			{
+				return values_.schedPolicy;
+			}
+
+			/** Machine thread scheduling priority
+
+				The real time priority used with the fifo and rr scheduling policies.
+			*/
+			int SchedPriority() const
+			{
+				return values_.schedPriority;
+			}
+
+			/** Lock memory
+
+				True to lock the process memory into ram when the asynchronous machine thread runs. The lock
+				is process wide, it is held until every machine that wanted it has had a run with the option
+				cleared or has been destroyed.
+			*/
+			bool LockMemory() const
+			{
+				return values_.lockMemory;
+			}
 	};
 } // namespace meen
 
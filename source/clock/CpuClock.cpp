@@ -251,4 +251,16 @@ namespace meen
 #endif
 		lastTime_ = epoch_;
 	}
+
+	void CpuClock::Skip(nanoseconds duration)
+	{
+#ifdef PICO_BOARD
+		auto us = duration_cast<microseconds>(duration).count();
+		epoch_ = delayed_by_us(epoch_, us);
+		lastTime_ = delayed_by_us(lastTime_, us);
+#else
+		epoch_ += duration_cast<steady_clock::duration>(duration);
+		lastTime_ += duration_cast<steady_clock::duration>(duration);
+#endif
+	}
 } // namespace meen
@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <limits>
+
+#include "meen/controllers/AsyncController.h"
+
+namespace meen
+{
+	AsyncController::AsyncController(ISR isr, std::chrono::nanoseconds servicePeriod)
+	{
+		isr_ = isr;
+		servicePeriod_ = servicePeriod;
+	}
+
+	AsyncController::~AsyncController()
+	{
+		// The worker calls Service, which the derived class has already destroyed by now
+		assert(worker_.joinable() == false);
+		Stop();
+	}
+
+	void AsyncController::Start()
+	{
+		if (worker_.joinable() == false)
+		{
+			stop_ = false;
+			worker_ = std::thread(&AsyncController::Work, this);
+		}
+	}
+
+	void AsyncController::Stop()
+	{
+		if (worker_.joinable() == true)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+
+			cv_.notify_one();
+			worker_.join();
+		}
+	}
+
+	void AsyncController::Work()
+	{
+		for (;;)
+		{
+			Service();
+
+			std::unique_lock<std::mutex> lock(mutex_);
+
+			if (stop_ == true)
+			{
+				break;
+			}
+
+			sleeping_.store(true, std::memory_order_relaxed);
+			// pairs with the fence in Notify, either the guest sees us sleeping or we see its output
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			cv_.wait_for(lock, servicePeriod_, [this] { return stop_ == true || toHost_.Empty() == false; });
+			sleeping_.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	void AsyncController::Notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// Only take the lock when the worker has nothing to do, the common case is lock free
+		if (sleeping_.load(std::memory_order_relaxed) == true)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			cv_.notify_one();
+		}
+	}
+
+	bool AsyncController::GuestWrite(uint8_t value)
+	{
+		if (toHost_.Push(value) == false)
+		{
+			return false;
+		}
+
+		Notify();
+		return true;
+	}
+
+	bool AsyncController::GuestRead(uint8_t& value)
+	{
+		return toGuest_.Pop(value);
+	}
+
+	bool AsyncController::GuestReady() const
+	{
+		return toGuest_.Empty() == false;
+	}
+
+	bool AsyncController::HostWrite(uint8_t value)
+	{
+		if (toGuest_.Push(value) == false)
+		{
+			return false;
+		}
+
+		if (ready_.exchange(true, std::memory_order_acq_rel) == false)
+		{
+			auto scheduler = scheduler_.load(std::memory_order_acquire);
+
+			if (scheduler != nullptr)
+			{
+				scheduler->Wake();
+			}
+		}
+
+		return true;
+	}
+
+	bool AsyncController::HostRead(uint8_t& value)
+	{
+		return toHost_.Pop(value);
+	}
+
+	ISR AsyncController::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
+	{
+		return ready_.exchange(false, std::memory_order_acq_rel) == true ? isr_ : ISR::NoInterrupt;
+	}
+
+	uint64_t AsyncController::NextPoll([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles)
+	{
+		return std::numeric_limits<uint64_t>::max();
+	}
+
+	void AsyncController::SetScheduler(IScheduler* scheduler)
+	{
+		scheduler_.store(scheduler, std::memory_order_release);
+
+		if (scheduler != nullptr)
+		{
+			Start();
+		}
+		else
+		{
+			Stop();
+		}
+	}
+} // namespace meen
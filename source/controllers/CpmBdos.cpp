@@ -0,0 +1,526 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cctype>
+
+#include "meen/controllers/CpmBdos.h"
+#include "meen/machine/MemoryRegions.h"
+
+namespace meen
+{
+	// The sequential record number held in the extent (ex), module (s2) and current record (cr) fields of a FCB
+	static uint32_t SequentialRecord(const uint8_t* fcb)
+	{
+		return ((fcb[14] & 0x3F) * 32 + (fcb[12] & 0x1F)) * 128 + fcb[32];
+	}
+
+	static void SetSequentialRecord(uint8_t* fcb, uint32_t record)
+	{
+		fcb[32] = record % 128;
+		fcb[12] = (record / 128) % 32;
+		fcb[14] = static_cast<uint8_t>(record / 4096);
+	}
+
+	// A byte result is returned in A and L, B and H are cleared
+	static void Result(Registers& registers, uint8_t value)
+	{
+		registers.a = registers.l = value;
+		registers.b = registers.h = 0;
+	}
+
+	CpmBdos::CpmBdos(CpmConsoleController* console, const char* directory)
+	{
+		console_ = console;
+		directory_ = directory != nullptr ? directory : ".";
+	}
+
+	std::string CpmBdos::Name(const uint8_t* name)
+	{
+		std::string str;
+
+		for (int i = 0; i < 11; i++)
+		{
+			auto c = static_cast<char>(std::toupper(name[i] & 0x7F));
+
+			if (i == 8)
+			{
+				str.push_back('.');
+			}
+
+			if (c != ' ')
+			{
+				str.push_back(c);
+			}
+		}
+
+		// no file type
+		if (str.back() == '.')
+		{
+			str.pop_back();
+		}
+
+		return str;
+	}
+
+	bool CpmBdos::Match(const uint8_t* pattern, const std::string& name)
+	{
+		auto dot = name.rfind('.');
+		auto base = name.substr(0, dot);
+		auto type = dot != std::string::npos ? name.substr(dot + 1) : std::string{};
+
+		// only host files that fit the 8.3 format are visible
+		if (base.empty() == true || base.size() > 8 || type.size() > 3)
+		{
+			return false;
+		}
+
+		base.resize(8, ' ');
+		type.resize(3, ' ');
+		auto fcbName = base + type;
+
+		for (int i = 0; i < 11; i++)
+		{
+			auto p = pattern[i] & 0x7F;
+
+			if (p != '?' && std::toupper(p) != std::toupper(static_cast<unsigned char>(fcbName[i])))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<std::string> CpmBdos::Find(const uint8_t* pattern) const
+	{
+		std::vector<std::string> names;
+		std::error_code ec;
+
+		for (const auto& entry : std::filesystem::directory_iterator(directory_, ec))
+		{
+			auto name = entry.path().filename().string();
+
+			if (entry.is_regular_file(ec) == true && Match(pattern, name) == true)
+			{
+				names.push_back(name);
+			}
+		}
+
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	std::fstream* CpmBdos::Open(const Fcb& fcb, bool create)
+	{
+		std::filesystem::path path;
+
+		if (create == true)
+		{
+			path = directory_ / Name(fcb.data() + 1);
+			files_.erase(path);
+			files_[path].open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		}
+		else
+		{
+			auto names = Find(fcb.data() + 1);
+
+			if (names.empty() == true)
+			{
+				return nullptr;
+			}
+
+			path = directory_ / names.front();
+
+			if (files_.contains(path) == true)
+			{
+				return &files_[path];
+			}
+
+			auto& file = files_[path];
+			file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+
+			// fall back to read only for write protected files
+			if (file.is_open() == false)
+			{
+				file.open(path, std::ios::in | std::ios::binary);
+			}
+		}
+
+		if (files_[path].is_open() == false)
+		{
+			files_.erase(path);
+			return nullptr;
+		}
+
+		return &files_[path];
+	}
+
+	uint8_t CpmBdos::ReadRecord(std::fstream& file, uint32_t record, IController* memoryController)
+	{
+		std::array<char, recordSize_> buffer;
+
+		file.clear();
+		file.seekg(static_cast<std::streamoff>(record) * recordSize_);
+		file.read(buffer.data(), buffer.size());
+		auto count = file.gcount();
+
+		if (count <= 0)
+		{
+			return 1; // end of file
+		}
+
+		// a partial record is padded with the CP/M end of file character
+		std::fill(buffer.begin() + count, buffer.end(), 0x1A);
+		MemoryRegions::Write(memoryController, dma_, reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size(), nullptr);
+		return 0;
+	}
+
+	uint8_t CpmBdos::WriteRecord(std::fstream& file, uint32_t record, IController* memoryController)
+	{
+		std::array<char, recordSize_> buffer;
+
+		MemoryRegions::Read(memoryController, dma_, reinterpret_cast<uint8_t*>(buffer.data()), buffer.size(), nullptr);
+		file.clear();
+		file.seekp(static_cast<std::streamoff>(record) * recordSize_);
+		file.write(buffer.data(), buffer.size());
+		file.flush();
+		return file.good() == true ? 0 : 2; // 2 - disk full
+	}
+
+	uint8_t CpmBdos::Search(IController* memoryController)
+	{
+		if (next_ >= found_.size())
+		{
+			return 0xFF;
+		}
+
+		const auto& name = found_[next_++];
+		std::error_code ec;
+		auto records = (std::filesystem::file_size(directory_ / name, ec) + recordSize_ - 1) / recordSize_;
+		// the directory entry is returned in the first quarter of the DMA buffer, the rest is unused
+		std::array<uint8_t, recordSize_> entry;
+		entry.fill(0xE5);
+		std::fill_n(entry.begin(), 32, 0);
+
+		auto dot = name.rfind('.');
+		auto base = name.substr(0, dot);
+		auto type = dot != std::string::npos ? name.substr(dot + 1) : std::string{};
+		base.resize(8, ' ');
+		type.resize(3, ' ');
+		std::transform(base.begin(), base.end(), entry.begin() + 1, [](char c) { return static_cast<uint8_t>(std::toupper(c)); });
+		std::transform(type.begin(), type.end(), entry.begin() + 9, [](char c) { return static_cast<uint8_t>(std::toupper(c)); });
+		entry[15] = static_cast<uint8_t>(std::min<uintmax_t>(ec ? 0 : records, 128));
+
+		MemoryRegions::Write(memoryController, dma_, entry.data(), entry.size(), nullptr);
+		return 0;
+	}
+
+	int CpmBdos::Console(Function function, Registers& registers, IController* memoryController)
+	{
+		uint8_t key = 0;
+
+		switch (function)
+		{
+			case Function::ConsoleInput:
+			{
+				if (console_->Key(key) == false)
+				{
+					key = 0x1A;
+				}
+				else
+				{
+					console_->Print({ &key, 1 });
+				}
+
+				Result(registers, key);
+				break;
+			}
+			case Function::ConsoleOutput:
+			{
+				console_->Print({ &registers.e, 1 });
+				break;
+			}
+			case Function::DirectConsoleIo:
+			{
+				if (registers.e == 0xFF)
+				{
+					console_->Key(key);
+					Result(registers, key);
+				}
+				else if (registers.e == 0xFE)
+				{
+					Result(registers, console_->KeyReady() == true ? 0xFF : 0x00);
+				}
+				else
+				{
+					console_->Print({ &registers.e, 1 });
+				}
+				break;
+			}
+			case Function::PrintString:
+			{
+				console_->PrintString((registers.d << 8) | registers.e, memoryController);
+				break;
+			}
+			case Function::ReadConsoleBuffer:
+			{
+				uint16_t buffer = (registers.d << 8) | registers.e;
+				auto max = memoryController->Read(buffer, nullptr);
+				uint8_t count = 0;
+
+				while (count < max && console_->Key(key) == true && key != '\r' && key != '\n')
+				{
+					memoryController->Write(buffer + 2 + count++, key, nullptr);
+					console_->Print({ &key, 1 });
+				}
+
+				memoryController->Write(buffer + 1, count, nullptr);
+				break;
+			}
+			case Function::ConsoleStatus:
+			{
+				Result(registers, console_->KeyReady() == true ? 0xFF : 0x00);
+				break;
+			}
+			default:
+			{
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	int CpmBdos::File(Function function, Registers& registers, IController* memoryController)
+	{
+		uint16_t address = (registers.d << 8) | registers.e;
+		Fcb fcb{};
+		MemoryRegions::Read(memoryController, address, fcb.data(), fcb.size(), nullptr);
+		auto result = uint8_t{ 0xFF };
+		auto updateFcb = false;
+
+		switch (function)
+		{
+			case Function::OpenFile:
+			{
+				auto file = Open(fcb, false);
+
+				if (file != nullptr)
+				{
+					file->clear();
+					file->seekg(0, std::ios::end);
+					auto records = (static_cast<uint32_t>(file->tellg()) + recordSize_ - 1) / recordSize_;
+					auto extentRecords = static_cast<int64_t>(records) - SequentialRecord(fcb.data()) / 128 * 128;
+					// the record count of the opened extent
+					fcb[15] = static_cast<uint8_t>(std::clamp<int64_t>(extentRecords, 0, 128));
+					updateFcb = true;
+					result = 0;
+				}
+				break;
+			}
+			case Function::CloseFile:
+			{
+				auto names = Find(fcb.data() + 1);
+
+				if (names.empty() == false)
+				{
+					files_.erase(directory_ / names.front());
+					result = 0;
+				}
+				break;
+			}
+			case Function::SearchFirst:
+			{
+				found_ = Find(fcb.data() + 1);
+				next_ = 0;
+				result = Search(memoryController);
+				break;
+			}
+			case Function::SearchNext:
+			{
+				result = Search(memoryController);
+				break;
+			}
+			case Function::DeleteFile:
+			{
+				for (const auto& name : Find(fcb.data() + 1))
+				{
+					std::error_code ec;
+					files_.erase(directory_ / name);
+
+					if (std::filesystem::remove(directory_ / name, ec) == true)
+					{
+						result = 0;
+					}
+				}
+				break;
+			}
+			case Function::ReadSequential:
+			case Function::WriteSequential:
+			{
+				auto file = Open(fcb, false);
+				result = function == Function::ReadSequential ? 1 : 2;
+
+				if (file != nullptr)
+				{
+					auto record = SequentialRecord(fcb.data());
+					result = function == Function::ReadSequential ? ReadRecord(*file, record, memoryController) : WriteRecord(*file, record, memoryController);
+
+					if (result == 0)
+					{
+						SetSequentialRecord(fcb.data(), record + 1);
+						updateFcb = true;
+					}
+				}
+				break;
+			}
+			case Function::MakeFile:
+			{
+				if (Open(fcb, true) != nullptr)
+				{
+					fcb[12] = fcb[14] = fcb[15] = 0;
+					updateFcb = true;
+					result = 0;
+				}
+				break;
+			}
+			case Function::RenameFile:
+			{
+				auto names = Find(fcb.data() + 1);
+
+				if (names.empty() == false)
+				{
+					std::error_code ec;
+					files_.erase(directory_ / names.front());
+					std::filesystem::rename(directory_ / names.front(), directory_ / Name(fcb.data() + 17), ec);
+					result = ec ? 0xFF : 0;
+				}
+				break;
+			}
+			case Function::ReadRandom:
+			case Function::WriteRandom:
+			{
+				auto file = Open(fcb, false);
+				// 6 - the record number is out of range
+				result = fcb[35] != 0 ? 6 : function == Function::ReadRandom ? 1 : 2;
+
+				if (file != nullptr && fcb[35] == 0)
+				{
+					uint32_t record = fcb[33] | (fcb[34] << 8);
+					result = function == Function::ReadRandom ? ReadRecord(*file, record, memoryController) : WriteRecord(*file, record, memoryController);
+					// sequential access continues from the random record
+					SetSequentialRecord(fcb.data(), record);
+					updateFcb = true;
+				}
+				break;
+			}
+			case Function::FileSize:
+			{
+				auto names = Find(fcb.data() + 1);
+
+				if (names.empty() == false)
+				{
+					std::error_code ec;
+					auto records = (std::filesystem::file_size(directory_ / names.front(), ec) + recordSize_ - 1) / recordSize_;
+					fcb[33] = records & 0xFF;
+					fcb[34] = (records >> 8) & 0xFF;
+					fcb[35] = (records >> 16) & 0xFF;
+					updateFcb = true;
+					result = 0;
+				}
+				break;
+			}
+			case Function::SetRandomRecord:
+			{
+				auto record = SequentialRecord(fcb.data());
+				fcb[33] = record & 0xFF;
+				fcb[34] = (record >> 8) & 0xFF;
+				fcb[35] = (record >> 16) & 0xFF;
+				updateFcb = true;
+				result = 0;
+				break;
+			}
+			default:
+			{
+				return -1;
+			}
+		}
+
+		if (updateFcb == true)
+		{
+			MemoryRegions::Write(memoryController, address, fcb.data(), fcb.size(), nullptr);
+		}
+
+		Result(registers, result);
+		return 0;
+	}
+
+	int CpmBdos::Call(Registers& registers, IController* memoryController)
+	{
+		auto function = static_cast<Function>(registers.c);
+
+		switch (function)
+		{
+			case Function::SystemReset:
+			{
+				// return to the warm boot entry point instead of the caller
+				registers.pc = 0;
+				return 0;
+			}
+			case Function::Version:
+			{
+				registers.a = registers.l = 0x22;
+				registers.b = registers.h = 0x00;
+				return 0;
+			}
+			case Function::ResetDisk:
+			{
+				dma_ = 0x80;
+				found_.clear();
+				Result(registers, 0);
+				return 0;
+			}
+			case Function::SelectDisk:
+			{
+				return 0;
+			}
+			case Function::CurrentDisk:
+			{
+				Result(registers, 0);
+				return 0;
+			}
+			case Function::SetDma:
+			{
+				dma_ = (registers.d << 8) | registers.e;
+				return 0;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		auto handled = Console(function, registers, memoryController);
+		return handled == 0 ? handled : File(function, registers, memoryController);
+	}
+} // namespace meen
@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "meen/controllers/CpmConsoleController.h"
+
+namespace meen
+{
+	std::array<uint8_t, 16> CpmConsoleController::Uuid() const
+	{
+		return{ 0xFA, 0x57, 0x06, 0x19, 0xBD, 0xBC, 0x4B, 0x73, 0x88, 0xC7, 0xD5, 0xD4, 0xF4, 0xBE, 0x70, 0xA7 };
+	}
+
+	uint8_t CpmConsoleController::Read([[maybe_unused]] uint16_t port, [[maybe_unused]] IController* controller)
+	{
+		return 0;
+	}
+
+	void CpmConsoleController::Print(std::span<const uint8_t> text)
+	{
+		auto count = output_.Push(text);
+
+		if (count < text.size())
+		{
+			dropped_.fetch_add(text.size() - count, std::memory_order_relaxed);
+		}
+	}
+
+	void CpmConsoleController::PrintString(uint16_t address, IController* memoryController)
+	{
+		auto memory = memoryController->MemoryView();
+
+		if (memory.size() > address)
+		{
+			// Scan up to the end of memory then wrap around once, the string can't be longer than the address space
+			for (size_t remaining = memory.size(); remaining > 0;)
+			{
+				auto start = memory.data() + address;
+				auto length = std::min(remaining, memory.size() - address);
+				auto end = static_cast<const uint8_t*>(std::memchr(start, '$', length));
+
+				Print({ start, end != nullptr ? end : start + length });
+
+				if (end != nullptr)
+				{
+					break;
+				}
+
+				remaining -= length;
+				address = 0;
+			}
+		}
+		else
+		{
+			uint8_t text[64];
+			size_t len = 0;
+
+			for (size_t remaining = 1 << 16; remaining > 0; --remaining, ++address)
+			{
+				auto aChar = memoryController->Read(address, nullptr);
+
+				if (aChar == '$')
+				{
+					break;
+				}
+
+				text[len++] = aChar;
+
+				if (len == sizeof(text))
+				{
+					Print(text);
+					len = 0;
+				}
+			}
+
+			Print({ text, len });
+		}
+	}
+
+	void CpmConsoleController::Write(uint16_t port, uint8_t value, IController* controller)
+	{
+		switch (static_cast<Port>(port))
+		{
+			case Port::PrintMode:
+			{
+				printMode_ = value;
+				break;
+			}
+			case Port::AddrHi:
+			{
+				addrHi_ = value;
+				break;
+			}
+			case Port::Process:
+			{
+				if (printMode_ == 9)
+				{
+					PrintString((addrHi_ << 8) | value, controller);
+				}
+				else if (printMode_ == 2)
+				{
+					Print({ &value, 1 });
+				}
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	size_t CpmConsoleController::Type(std::span<const uint8_t> text)
+	{
+		return input_.Push(text);
+	}
+
+	bool CpmConsoleController::Key(uint8_t& key)
+	{
+		return input_.Pop(key);
+	}
+
+	bool CpmConsoleController::KeyReady() const
+	{
+		return input_.Empty() == false;
+	}
+
+	ISR CpmConsoleController::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
+	{
+		return ISR::NoInterrupt;
+	}
+
+	std::span<const uint8_t> CpmConsoleController::Output() const
+	{
+		return output_.Front();
+	}
+
+	void CpmConsoleController::Consume(size_t count)
+	{
+		output_.Drop(count);
+	}
+
+	size_t CpmConsoleController::Dropped() const
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+} // namespace meen
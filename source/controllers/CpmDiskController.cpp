@@ -0,0 +1,240 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "meen/controllers/CpmDiskController.h"
+#include "meen/machine/MemoryRegions.h"
+#include "meen/utils/ErrorCode.h"
+
+namespace meen
+{
+	CpmDiskController::~CpmDiskController()
+	{
+		for (uint8_t drive = 0; drive < MaxDrives; drive++)
+		{
+			Unmount(drive);
+		}
+	}
+
+	std::error_code CpmDiskController::Mount(uint8_t drive, const char* path, const Geometry& geometry, bool readOnly)
+	{
+		if (drive >= MaxDrives || path == nullptr || geometry.sectorSize == 0)
+		{
+			return make_error_code(errc::invalid_argument);
+		}
+
+		// The track and sector registers are 8 bits, reject geometries they can not address
+		if (geometry.tracks == 0 || geometry.tracks > 256 || geometry.sectors == 0 || geometry.firstSector + geometry.sectors > 256)
+		{
+			return make_error_code(errc::invalid_argument);
+		}
+
+		auto fd = open(path, (readOnly == true ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+
+		if (fd < 0)
+		{
+			return make_error_code(errc::io_controller);
+		}
+
+		struct stat st{};
+		size_t size = static_cast<size_t>(geometry.tracks) * geometry.sectors * geometry.sectorSize;
+
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < size)
+		{
+			close(fd);
+			return make_error_code(errc::invalid_argument);
+		}
+
+		auto image = mmap(nullptr, size, readOnly == true ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		// the mapping keeps the file open
+		close(fd);
+
+		if (image == MAP_FAILED)
+		{
+			return make_error_code(errc::io_controller);
+		}
+
+		Unmount(drive);
+		drives_[drive] = Drive{ static_cast<uint8_t*>(image), size, geometry, readOnly };
+		return std::error_code{};
+	}
+
+	std::error_code CpmDiskController::Unmount(uint8_t drive)
+	{
+		if (drive >= MaxDrives || drives_[drive].image == nullptr)
+		{
+			return make_error_code(errc::invalid_argument);
+		}
+
+		auto& d = drives_[drive];
+
+		if (d.readOnly == false)
+		{
+			msync(d.image, d.size, MS_SYNC);
+		}
+
+		munmap(d.image, d.size);
+		d = Drive{};
+		return std::error_code{};
+	}
+
+	std::error_code CpmDiskController::Flush()
+	{
+		std::error_code err;
+
+		for (const auto& d : drives_)
+		{
+			if (d.image != nullptr && d.readOnly == false && msync(d.image, d.size, MS_SYNC) != 0)
+			{
+				err = make_error_code(errc::io_controller);
+			}
+		}
+
+		return err;
+	}
+
+	std::array<uint8_t, 16> CpmDiskController::Uuid() const
+	{
+		return{ 0xCD, 0xEB, 0x61, 0xDB, 0x54, 0x89, 0x4F, 0xD7, 0x8F, 0x8A, 0x98, 0x2D, 0xAB, 0xCE, 0x59, 0x1D };
+	}
+
+	CpmDiskController::Status CpmDiskController::Transfer(Command command, IController* memoryController)
+	{
+		if (command == Command::Flush)
+		{
+			return Flush() ? Status::IoError : Status::Ok;
+		}
+
+		if (command != Command::Read && command != Command::Write)
+		{
+			return Status::BadCommand;
+		}
+
+		if (drive_ >= MaxDrives || drives_[drive_].image == nullptr)
+		{
+			return Status::NoDrive;
+		}
+
+		const auto& d = drives_[drive_];
+		const auto& g = d.geometry;
+
+		if (track_ >= g.tracks)
+		{
+			return Status::BadTrack;
+		}
+
+		if (sector_ < g.firstSector || sector_ - g.firstSector >= g.sectors)
+		{
+			return Status::BadSector;
+		}
+
+		// consecutive sectors are contiguous in the image, including across tracks
+		size_t offset = (static_cast<size_t>(track_) * g.sectors + sector_ - g.firstSector) * g.sectorSize;
+		size_t len = static_cast<size_t>(count_ == 0 ? 1 : count_) * g.sectorSize;
+
+		if (offset + len > d.size)
+		{
+			return Status::BadSector;
+		}
+
+		if (command == Command::Read)
+		{
+			MemoryRegions::Write(memoryController, dma_, d.image + offset, len, this);
+		}
+		else if (d.readOnly == true)
+		{
+			return Status::ReadOnly;
+		}
+		else
+		{
+			MemoryRegions::Read(memoryController, dma_, d.image + offset, len, this);
+		}
+
+		return Status::Ok;
+	}
+
+	uint8_t CpmDiskController::Read(uint16_t port, [[maybe_unused]] IController* controller)
+	{
+		return static_cast<Port>(port & 0x07) == Port::Status ? static_cast<uint8_t>(status_) : 0;
+	}
+
+	void CpmDiskController::Write(uint16_t port, uint8_t value, IController* controller)
+	{
+		switch (static_cast<Port>(port & 0x07))
+		{
+			case Port::Drive:
+			{
+				drive_ = value;
+				break;
+			}
+			case Port::Track:
+			{
+				track_ = value;
+				break;
+			}
+			case Port::Sector:
+			{
+				sector_ = value;
+				break;
+			}
+			case Port::Command:
+			{
+				status_ = Transfer(static_cast<Command>(value), controller);
+				break;
+			}
+			case Port::DmaLo:
+			{
+				dma_ = (dma_ & 0xFF00) | value;
+				break;
+			}
+			case Port::DmaHi:
+			{
+				dma_ = (dma_ & 0x00FF) | (value << 8);
+				break;
+			}
+			case Port::Count:
+			{
+				count_ = value;
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	ISR CpmDiskController::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
+	{
+		return ISR::NoInterrupt;
+	}
+
+	uint64_t CpmDiskController::NextPoll([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles)
+	{
+		return std::numeric_limits<uint64_t>::max();
+	}
+} // namespace meen
@@ -0,0 +1,189 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "meen/controllers/MemfdController.h"
+#include "meen/utils/ErrorCode.h"
+
+namespace meen
+{
+	MemfdController::MemfdController(int fd, uint8_t* memory, Mapping mapping)
+	{
+		fd_ = fd;
+		memory_ = memory;
+		mapping_ = mapping;
+	}
+
+	MemfdController::~MemfdController()
+	{
+		munmap(memory_, memorySize_);
+		close(fd_);
+	}
+
+	std::expected<MemfdControllerPtr, std::error_code> MemfdController::Make(const char* name)
+	{
+		auto fd = memfd_create(name != nullptr ? name : "meen", MFD_CLOEXEC);
+
+		if (fd < 0)
+		{
+			return std::unexpected(make_error_code(errc::memory_controller));
+		}
+
+		// a newly sized memfd is zero filled
+		if (ftruncate(fd, memorySize_) != 0)
+		{
+			close(fd);
+			return std::unexpected(make_error_code(errc::memory_controller));
+		}
+
+		auto memory = mmap(nullptr, memorySize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		if (memory == MAP_FAILED)
+		{
+			close(fd);
+			return std::unexpected(make_error_code(errc::memory_controller));
+		}
+
+		return MemfdControllerPtr(new MemfdController(fd, static_cast<uint8_t*>(memory), Mapping::Shared));
+	}
+
+	std::expected<MemfdControllerPtr, std::error_code> MemfdController::Map(int fd, Mapping mapping)
+	{
+		struct stat st{};
+
+		if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(memorySize_))
+		{
+			return std::unexpected(make_error_code(errc::invalid_argument));
+		}
+
+		// A private mapping would still see the later writes to the pages it has not written to, take a snapshot in a new memfd instead
+		if (mapping == Mapping::Private)
+		{
+			auto snapshot = Make("meen");
+
+			if (!snapshot)
+			{
+				return snapshot;
+			}
+
+			for (size_t copied = 0; copied < memorySize_;)
+			{
+				auto count = pread(fd, snapshot.value()->memory_ + copied, memorySize_ - copied, copied);
+
+				if (count <= 0)
+				{
+					return std::unexpected(make_error_code(errc::memory_controller));
+				}
+
+				copied += count;
+			}
+
+			snapshot.value()->mapping_ = Mapping::Private;
+			return snapshot;
+		}
+
+		auto dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+		if (dupFd < 0)
+		{
+			return std::unexpected(make_error_code(errc::invalid_argument));
+		}
+
+		int prot = PROT_READ;
+
+		switch (mapping)
+		{
+			case Mapping::Shared:
+				prot |= PROT_WRITE;
+				break;
+			case Mapping::ReadOnly:
+				break;
+			default:
+				close(dupFd);
+				return std::unexpected(make_error_code(errc::invalid_argument));
+		}
+
+		auto memory = mmap(nullptr, memorySize_, prot, MAP_SHARED, dupFd, 0);
+
+		if (memory == MAP_FAILED)
+		{
+			close(dupFd);
+			return std::unexpected(make_error_code(errc::memory_controller));
+		}
+
+		return MemfdControllerPtr(new MemfdController(dupFd, static_cast<uint8_t*>(memory), mapping));
+	}
+
+	int MemfdController::Fd() const
+	{
+		return fd_;
+	}
+
+	std::array<uint8_t, 16> MemfdController::Uuid() const
+	{
+		return{ 0xC9, 0x8E, 0xB6, 0xB1, 0x50, 0x4A, 0x46, 0x39, 0xA0, 0x8F, 0x3D, 0x1C, 0x32, 0xE2, 0x69, 0xE4 };
+	}
+
+	uint8_t MemfdController::Read(uint16_t address, [[maybe_unused]] IController* controller)
+	{
+		return memory_[address];
+	}
+
+	void MemfdController::Write(uint16_t address, uint8_t value, [[maybe_unused]] IController* controller)
+	{
+		if (mapping_ != Mapping::ReadOnly)
+		{
+			memory_[address] = value;
+			dirtyPages_[address >> 8] = true;
+		}
+	}
+
+	ISR MemfdController::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
+	{
+		// this controller never issues any interrupts
+		return ISR::NoInterrupt;
+	}
+
+	DirtyPageMap* MemfdController::DirtyPages()
+	{
+		return &dirtyPages_;
+	}
+
+	std::span<uint8_t> MemfdController::Memory()
+	{
+		if (mapping_ == Mapping::ReadOnly)
+		{
+			return {};
+		}
+
+		return { memory_, memorySize_ };
+	}
+
+	std::span<const uint8_t> MemfdController::MemoryView()
+	{
+		return { memory_, memorySize_ };
+	}
+} // namespace meen
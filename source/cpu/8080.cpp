@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <assert.h>
 #include <format>
 #ifdef ENABLE_NLOHMANN_JSON
@@ -301,21 +302,23 @@ Intel8080::Intel8080()
 #endif // ENABLE_OPCODE_TABLE
 }
 
-std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
+std::expected<CpuState, std::error_code> Intel8080::Parse(const std::string&& str, bool checkUuid) const
 {
+	CpuState state;
+
 #ifdef ENABLE_NLOHMANN_JSON
 	auto json = nlohmann::json::parse(str, nullptr, false);
 
 	if(json.is_discarded() == true)
 	{
-		return make_error_code(errc::json_parse);
+		return std::unexpected(make_error_code(errc::json_parse));
 	}
 
 	if (checkUuid == true)
 	{
 		if(!json.contains("uuid"))
 		{
-			return make_error_code(errc::json_config);
+			return std::unexpected(make_error_code(errc::json_config));
 		}
 
 		auto sv = json["uuid"].get<std::string_view>();
@@ -328,17 +331,17 @@ std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
 
 			if (!jsonUuid)
 			{
-				return jsonUuid.error();
+				return std::unexpected(jsonUuid.error());
 			}
 
 			if (jsonUuid.value().size() != uuid_.size() || std::equal(jsonUuid.value().begin(), jsonUuid.value().end(), uuid_.begin()) == false)
 			{
-				return make_error_code(errc::incompatible_uuid);
+				return std::unexpected(make_error_code(errc::incompatible_uuid));
 			}
 		}
 		else
 		{
-			return make_error_code(errc::json_config);
+			return std::unexpected(make_error_code(errc::json_config));
 		}
 	}
 
@@ -346,39 +349,50 @@ std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
 	{
 		auto registers = json["registers"];
 
-		// Restore the state of the cpu
-		a_ = registers.value<uint8_t>("a", Value(a_));
-		b_ = registers.value<uint8_t>("b", Value(b_));
-		c_ = registers.value<uint8_t>("c", Value(c_));
-		d_ = registers.value<uint8_t>("d", Value(d_));
-		e_ = registers.value<uint8_t>("e", Value(e_));
-		h_ = registers.value<uint8_t>("h", Value(h_));
-		l_ = registers.value<uint8_t>("l", Value(l_));
-		status_ = registers.value<uint8_t>("s", Value(status_)) | 0x02;
+		// The state of the cpu to restore
+		auto value = [&registers](const char* name)
+		{
+			return registers.contains(name) == true ? std::optional<uint8_t>(registers[name].get<uint8_t>()) : std::nullopt;
+		};
+
+		state.a = value("a");
+		state.b = value("b");
+		state.c = value("c");
+		state.d = value("d");
+		state.e = value("e");
+		state.h = value("h");
+		state.l = value("l");
+		state.s = value("s");
 	}
 	// The registers object has not been specified, reset all registers to zero.
 	else
 	{
-		a_ = b_ = c_ = d_ = e_ = h_ = l_ = 0;
-		status_ = 0x02;
+		state.resetRegisters = true;
 	}
 
-	pc_ = json.value<uint16_t>("pc", pc_);
-	sp_ = json.value<uint16_t>("sp", sp_);
+	if (json.contains("pc") == true)
+	{
+		state.pc = json["pc"].get<uint16_t>();
+	}
+
+	if (json.contains("sp") == true)
+	{
+		state.sp = json["sp"].get<uint16_t>();
+	}
 #else
 	JsonDocument json;
 	auto e = deserializeJson(json, str);
 
 	if(e)
 	{
-		return make_error_code(errc::json_parse);
+		return std::unexpected(make_error_code(errc::json_parse));
 	}
 
 	if (checkUuid == true)
 	{
 		if(json["uuid"] == nullptr)
 		{
-			return make_error_code(errc::json_parse);
+			return std::unexpected(make_error_code(errc::json_parse));
 		}
 
 		auto sv = json["uuid"].as<std::string_view>();
@@ -392,17 +406,17 @@ std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
 
 			if (!jsonUuid)
 			{
-				return jsonUuid.error();
+				return std::unexpected(jsonUuid.error());
 			}
 
 			if (jsonUuid.value().size() != uuid_.size() || std::equal(jsonUuid.value().begin(), jsonUuid.value().end(), uuid_.begin()) == false)
 			{
-				return make_error_code(errc::incompatible_uuid);
+				return std::unexpected(make_error_code(errc::incompatible_uuid));
 			}
 		}
 		else
 		{
-			return make_error_code(errc::json_config);
+			return std::unexpected(make_error_code(errc::json_config));
 		}
 	}
 
@@ -410,20 +424,65 @@ std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
 	{
 		auto registers = json["registers"];
 
-		// Restore the state of the cpu
-		a_ = registers["a"] ? registers["a"].as<uint8_t>() : Value(a_);
-		b_ = registers["b"] ? registers["b"].as<uint8_t>() : Value(b_);
-		c_ = registers["c"] ? registers["c"].as<uint8_t>() : Value(c_);
-		d_ = registers["d"] ? registers["d"].as<uint8_t>() : Value(d_);
-		e_ = registers["e"] ? registers["e"].as<uint8_t>() : Value(e_);
-		h_ = registers["h"] ? registers["h"].as<uint8_t>() : Value(h_);
-		l_ = registers["l"] ? registers["l"].as<uint8_t>() : Value(l_);
-		status_ = (registers["s"] ? registers["s"].as<uint8_t>() : Value(status_)) | 0x02;
+		// The state of the cpu to restore
+		auto value = [&registers](const char* name)
+		{
+			return registers[name] ? std::optional<uint8_t>(registers[name].as<uint8_t>()) : std::nullopt;
+		};
+
+		state.a = value("a");
+		state.b = value("b");
+		state.c = value("c");
+		state.d = value("d");
+		state.e = value("e");
+		state.h = value("h");
+		state.l = value("l");
+		state.s = value("s");
+	}
+
+	if (json["pc"])
+	{
+		state.pc = json["pc"].as<uint16_t>();
 	}
 
-	pc_ = json["pc"] ? json["pc"].as<uint16_t>() : pc_;
-	sp_ = json["sp"] ? json["sp"].as<uint16_t>() : sp_;
+	if (json["sp"])
+	{
+		state.sp = json["sp"].as<uint16_t>();
+	}
 #endif
+	return state;
+}
+
+void Intel8080::Apply(const CpuState& state)
+{
+	if (state.resetRegisters == true)
+	{
+		a_ = b_ = c_ = d_ = e_ = h_ = l_ = 0;
+		status_ = 0x02;
+	}
+
+	a_ = state.a.value_or(Value(a_));
+	b_ = state.b.value_or(Value(b_));
+	c_ = state.c.value_or(Value(c_));
+	d_ = state.d.value_or(Value(d_));
+	e_ = state.e.value_or(Value(e_));
+	h_ = state.h.value_or(Value(h_));
+	l_ = state.l.value_or(Value(l_));
+	status_ = state.s.value_or(Value(status_)) | 0x02;
+	pc_ = state.pc.value_or(pc_);
+	sp_ = state.sp.value_or(sp_);
+}
+
+std::error_code Intel8080::Load(const std::string&& str, bool checkUuid)
+{
+	auto state = Parse(std::move(str), checkUuid);
+
+	if (!state)
+	{
+		return state.error();
+	}
+
+	Apply(state.value());
 	return make_error_code(errc::no_error);
 }
 
@@ -467,6 +526,12 @@ uint8_t Intel8080::Interrupt(ISR isr)
 	return timePeriods;
 }
 
+bool Intel8080::InterruptsEnabled() const
+{
+	// EI takes effect after the instruction that follows it
+	return iff_ == true && opcode_ != 0xFB;
+}
+
 uint8_t Intel8080::Execute()
 {
 	if (hlt_ == true)
@@ -474,7 +539,7 @@ uint8_t Intel8080::Execute()
 		return 0;//Nop(); // Do we return Nop() here??, 0 is a cpu stall, Nop() will tick the clock but won't execute instrutions
 	}
 
-	opcode_ = memoryController_->Read(pc_, ioController_);
+	opcode_ = fetchController_->Read(pc_, ioController_);
 
 #ifdef ENABLE_OPCODE_TABLE
 	return opcodeTable_[opcode_]();
@@ -749,6 +814,7 @@ uint8_t Intel8080::Execute()
 void Intel8080::SetMemoryController(IController* memoryController)
 {
 	memoryController_ = memoryController;
+	fetchController_ = memoryController;
 }
 
 void Intel8080::SetIoController(IController* ioController)
@@ -756,6 +822,47 @@ void Intel8080::SetIoController(IController* ioController)
 	ioController_ = ioController;
 }
 
+void Intel8080::SetFetchController(IController* fetchController)
+{
+	fetchController_ = fetchController;
+}
+
+void Intel8080::SetIoPorts(const IoPortTable* ioPorts)
+{
+	ioPorts_ = ioPorts;
+}
+
+void Intel8080::SetTrap(uint16_t address, std::function<int(Registers& registers)>&& trap)
+{
+	trapAddress_ = address;
+	trap_ = std::move(trap);
+}
+
+int Intel8080::Trap()
+{
+	Registers registers{ pc_, sp_, Value(a_), Value(b_), Value(c_), Value(d_), Value(e_), Value(h_), Value(l_), Value(status_) };
+	auto timePeriods = trap_(registers);
+
+	if (timePeriods >= 0)
+	{
+		pc_ = registers.pc;
+		sp_ = registers.sp;
+		a_ = registers.a;
+		b_ = registers.b;
+		c_ = registers.c;
+		d_ = registers.d;
+		e_ = registers.e;
+		h_ = registers.h;
+		l_ = registers.l;
+		// the unused flag bits are fixed, the same as POP PSW
+		status_ = (Register(registers.flags) & Register(0xD7)) | Register(0x02);
+		// the time periods of the call and the return it replaces
+		timePeriods = std::min(timePeriods + 27, 255);
+	}
+
+	return timePeriods;
+}
+
 //This essentially powers on the cpu
 void Intel8080::Reset()
 {
@@ -1648,6 +1755,16 @@ uint8_t Intel8080::CallOnFlag(bool status, std::string_view instructionName)
 
 	if (status == true)
 	{
+		if (addr == trapAddress_ && trap_)
+		{
+			auto timePeriods = Trap();
+
+			if (timePeriods >= 0)
+			{
+				return timePeriods;
+			}
+		}
+
 		sp_ += 0xFFFF;
 		memoryController_->Write(sp_, pc_ >> 8, ioController_);
 		sp_ += 0xFFFF;
@@ -1781,7 +1898,18 @@ uint8_t Intel8080::Out()
 	}
 
 	//write to IO port 'out' the accumulator
-	ioController_->Write(out, Value(a_), memoryController_);
+	if (ioPorts_ == nullptr)
+	{
+		ioController_->Write(out, Value(a_), memoryController_);
+	}
+	else if (const auto& port = (*ioPorts_)[out]; port.latch != nullptr)
+	{
+		*port.latch = Value(a_);
+	}
+	else
+	{
+		port.controller->Write(out, Value(a_), memoryController_);
+	}
 	++pc_;
 	return 10;
 }
@@ -1796,7 +1924,18 @@ uint8_t Intel8080::In()
 	}
 
 	//Read into the accumulator the value in IO port 'in'.
-	a_ = ioController_->Read(in, memoryController_);
+	if (ioPorts_ == nullptr)
+	{
+		a_ = ioController_->Read(in, memoryController_);
+	}
+	else if (const auto& port = (*ioPorts_)[in]; port.latch != nullptr)
+	{
+		a_ = *port.latch;
+	}
+	else
+	{
+		a_ = port.controller->Read(in, memoryController_);
+	}
 	++pc_;
 	return 10;
 }
@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <bit>
+
+#include "meen/machine/InterruptController.h"
+
+namespace meen
+{
+	ISR InterruptController::Acknowledge()
+	{
+		uint8_t requested = pending_ & ~mask_.load(std::memory_order_relaxed);
+
+		if (requested == 0)
+		{
+			return ISR::NoInterrupt;
+		}
+
+		auto highest = highest_.load(std::memory_order_relaxed);
+		// Rotate the highest priority line into bit 0 so the lowest set bit is the highest priority request
+		auto line = (std::countr_zero(std::rotr(requested, highest)) + highest) & 0x07;
+		pending_ &= ~(1 << line);
+		return static_cast<ISR>(line);
+	}
+
+	void InterruptController::Reset()
+	{
+		pending_ = 0;
+	}
+
+	void InterruptController::SetMask(uint8_t mask)
+	{
+		mask_.store(mask, std::memory_order_relaxed);
+	}
+
+	void InterruptController::SetPriority(ISR highest)
+	{
+		highest_.store(static_cast<uint8_t>(highest), std::memory_order_relaxed);
+	}
+} // namespace meen
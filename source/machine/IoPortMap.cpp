@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "meen/machine/IoPortMap.h"
+
+namespace meen
+{
+	std::array<uint8_t, 16> IoPortMap::Handler::Uuid() const
+	{
+		return {};
+	}
+
+	uint8_t IoPortMap::Handler::Read(uint16_t port, [[maybe_unused]] IController* controller)
+	{
+		return read ? read(static_cast<uint8_t>(port)) : 0x00;
+	}
+
+	void IoPortMap::Handler::Write(uint16_t port, uint8_t value, [[maybe_unused]] IController* controller)
+	{
+		if (write)
+		{
+			write(static_cast<uint8_t>(port), value);
+		}
+	}
+
+	ISR IoPortMap::Handler::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
+	{
+		return ISR::NoInterrupt;
+	}
+
+	void IoPortMap::Unmap(uint8_t port)
+	{
+		if (latches_[port] != nullptr || handlers_[port] != nullptr)
+		{
+			mapped_--;
+		}
+
+		latches_[port] = nullptr;
+		handlers_[port] = nullptr;
+	}
+
+	void IoPortMap::Map(uint8_t port, uint8_t* latch)
+	{
+		Unmap(port);
+
+		if (latch != nullptr)
+		{
+			latches_[port] = latch;
+			mapped_++;
+		}
+	}
+
+	void IoPortMap::Map(uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write)
+	{
+		Unmap(port);
+
+		handlers_[port] = std::make_unique<Handler>();
+		handlers_[port]->read = std::move(read);
+		handlers_[port]->write = std::move(write);
+		mapped_++;
+	}
+
+	bool IoPortMap::Overlaps(uint8_t firstPort, uint8_t lastPort) const
+	{
+		return std::any_of(devices_.begin(), devices_.end(), [firstPort, lastPort](const Device& device)
+		{
+			return firstPort <= device.lastPort && lastPort >= device.firstPort;
+		});
+	}
+
+	void IoPortMap::Attach(IControllerPtr&& controller, uint8_t firstPort, uint8_t lastPort, double isrFreq)
+	{
+		devices_.push_back(Device{ std::move(controller), firstPort, lastPort, isrFreq });
+	}
+
+	IControllerPtr IoPortMap::Detach(uint8_t port)
+	{
+		IControllerPtr controller;
+
+		auto it = std::find_if(devices_.begin(), devices_.end(), [port](const Device& device)
+		{
+			return port >= device.firstPort && port <= device.lastPort;
+		});
+
+		if (it != devices_.end())
+		{
+			controller = std::move(it->controller);
+			devices_.erase(it);
+		}
+
+		return controller;
+	}
+
+	const std::vector<IoPortMap::Device>& IoPortMap::Devices() const
+	{
+		return devices_;
+	}
+
+	const IoPortTable* IoPortMap::Resolve(IController* ioController)
+	{
+		if (mapped_ == 0 && devices_.empty() == true)
+		{
+			return nullptr;
+		}
+
+		for (int port = 0; port < 256; port++)
+		{
+			table_[port].latch = latches_[port];
+			table_[port].controller = handlers_[port] != nullptr ? handlers_[port].get() : ioController;
+		}
+
+		for (const auto& device : devices_)
+		{
+			for (int port = device.firstPort; port <= device.lastPort; port++)
+			{
+				if (handlers_[port] == nullptr)
+				{
+					table_[port].controller = device.controller.get();
+				}
+			}
+		}
+
+		return &table_;
+	}
+} // namespace meen
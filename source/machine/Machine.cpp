@@ -20,16 +20,24 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <assert.h>
 #include <bit>
 #include <charconv>
 #include <cinttypes>
+#include <cmath>
 #include <format>
-#include <numeric>
+#include <limits>
 #include <stdio.h>
+#include <utility>
 #ifdef PICO_BOARD
 #include <pico/multicore.h>
 #endif // PICO_BOARD
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif // __linux__
 #ifdef ENABLE_NLOHMANN_JSON
 #include <nlohmann/json.hpp>
 #else
@@ -67,9 +75,218 @@ namespace meen
 		}
 	}
 
+	Machine::~Machine()
+	{
+#ifndef PICO_BOARD
+		if (worker_.joinable() == true)
+		{
+			{
+				std::scoped_lock lock(workerMutex_);
+				workerExit_ = true;
+			}
+
+			workerCv_.notify_one();
+			worker_.join();
+		}
+#endif // PICO_BOARD
+
+		// A run suspended by RunFor (or abandoned by RunAwait) leaves the controllers bound to the scheduler,
+		// unbind them (stopping any controller worker threads) before the controllers and the scheduler are destroyed
+		EndRun();
+	}
+
+	// Drop a run that can not be resumed and unbind the controllers from its scheduler
+	void Machine::EndRun()
+	{
+		if (runState_ != nullptr)
+		{
+			if (ioController_ != nullptr)
+			{
+				ioController_->SetScheduler(nullptr);
+			}
+
+			if (memoryController_ != nullptr)
+			{
+				memoryController_->SetScheduler(nullptr);
+			}
+
+			for (const auto& device : ioPortMap_.Devices())
+			{
+				device.controller->SetScheduler(nullptr);
+			}
+
+			if (watchController_ != nullptr)
+			{
+				watchController_->OnHit(nullptr);
+			}
+
+			scheduler_.Start(nullptr);
+			runState_ = nullptr;
+		}
+	}
+
+#ifdef __linux__
+	namespace
+	{
+		// mlockall and munlockall apply to the whole process, count the machine threads that want the memory locked
+		// so that one machine does not unlock the memory of another
+		std::mutex memoryLockMutex;
+		int memoryLockCount = 0;
+
+		bool LockMemory()
+		{
+			std::scoped_lock lock(memoryLockMutex);
+
+			// Requires CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+			if (memoryLockCount == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+			{
+				return false;
+			}
+
+			memoryLockCount++;
+			return true;
+		}
+
+		void UnlockMemory()
+		{
+			std::scoped_lock lock(memoryLockMutex);
+
+			if (--memoryLockCount == 0)
+			{
+				munlockall();
+			}
+		}
+
+		// Apply the machine thread options to the calling thread, a setting the process lacks the permission for is left at its default
+		void ApplyThreadOptions(const Opt& opt, const cpu_set_t& defaultAffinity, bool& memoryLocked)
+		{
+			auto affinity = defaultAffinity;
+
+			if (opt.CpuAffinity().empty() == false)
+			{
+				CPU_ZERO(&affinity);
+
+				for (auto cpu : opt.CpuAffinity())
+				{
+					if (cpu < CPU_SETSIZE)
+					{
+						CPU_SET(cpu, &affinity);
+					}
+				}
+			}
+
+			if (pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity) != 0)
+			{
+				// None of the cpus are available to the process
+				pthread_setaffinity_np(pthread_self(), sizeof(defaultAffinity), &defaultAffinity);
+			}
+
+			sched_param param{};
+			auto policy = SCHED_OTHER;
+
+			if (opt.SchedPolicy() == "fifo")
+			{
+				policy = SCHED_FIFO;
+			}
+			else if (opt.SchedPolicy() == "rr")
+			{
+				policy = SCHED_RR;
+			}
+
+			if (policy != SCHED_OTHER)
+			{
+				param.sched_priority = opt.SchedPriority();
+			}
+
+			if (pthread_setschedparam(pthread_self(), policy, &param) != 0)
+			{
+				// Real time scheduling requires CAP_SYS_NICE (or an RLIMIT_RTPRIO) and a priority in range
+				param.sched_priority = 0;
+				pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+			}
+
+			if (opt.LockMemory() == true && memoryLocked == false)
+			{
+				memoryLocked = LockMemory();
+			}
+			else if (opt.LockMemory() == false && memoryLocked == true)
+			{
+				UnlockMemory();
+				memoryLocked = false;
+			}
+		}
+	} // namespace
+#endif // __linux__
+
+#ifndef PICO_BOARD
+	void Machine::Worker()
+	{
+#ifdef __linux__
+		// The affinity the worker started with, restored when the cpuAffinity option is cleared
+		cpu_set_t defaultAffinity;
+		CPU_ZERO(&defaultAffinity);
+		pthread_getaffinity_np(pthread_self(), sizeof(defaultAffinity), &defaultAffinity);
+		bool memoryLocked = false;
+#endif // __linux__
+		std::unique_lock lock(workerMutex_);
+
+		while (true)
+		{
+			workerCv_.wait(lock, [this] { return runRequested_ == true || workerExit_ == true; });
+
+			if (runRequested_ == false)
+			{
+				break;
+			}
+
+			runRequested_ = false;
+			auto runDone = std::move(runDone_);
+			lock.unlock();
+#ifdef __linux__
+			// The options can not change while the machine is running, apply them once per run
+			ApplyThreadOptions(opt_, defaultAffinity, memoryLocked);
+#endif // __linux__
+
+			try
+			{
+				RunMachine(this, std::numeric_limits<int64_t>::max());
+				// Wake the idle loop before Run can return and reset the idle event for the next run
+				NotifyIdle();
+				runDone.set_value();
+			}
+			catch (...)
+			{
+				NotifyIdle();
+				runDone.set_exception(std::current_exception());
+			}
+
+			lock.lock();
+		}
+#ifdef __linux__
+
+		if (memoryLocked == true)
+		{
+			UnlockMemory();
+		}
+#endif // __linux__
+	}
+#endif // PICO_BOARD
+
+	void Machine::NotifyIdle()
+	{
+#ifndef PICO_BOARD
+		{
+			std::scoped_lock lock(idleMutex_);
+			idleEvent_ = true;
+		}
+
+		idleCv_.notify_one();
+#endif // PICO_BOARD
+	}
+
 	std::error_code Machine::SetOptions(const char* options)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -80,6 +297,24 @@ namespace meen
 		{
 			HandleError(err, std::source_location::current());
 		}
+		else
+		{
+			auto memoryProfile = opt_.MemoryProfile();
+
+			// The profile counters are reset when the profile mode changes
+			if (memoryProfile == "none")
+			{
+				profileController_ = nullptr;
+			}
+			else if (profileController_ == nullptr || profileController_->PerAddress() != (memoryProfile == "address"))
+			{
+				profileController_ = std::make_unique<ProfileController>(memoryProfile == "address");
+			}
+#ifdef ENABLE_MEEN_SAVE
+			// the encoder or compressor of the saved ram may have changed
+			savedMemoryValid_ = false;
+#endif // ENABLE_MEEN_SAVE
+		}
 
 		return err;
 	}
@@ -120,1060 +355,1794 @@ namespace meen
 		return HandleError(make_error_code(ec), std::move(sl));
 	}
 
-	void RunMachine(meen::Machine* m)
+	// A machine state decoded from the json returned by the OnLoad handler. When loadAsync is true it is prepared on the
+	// loader thread so that the machine thread only has to copy it into the machine at an instruction boundary.
+	struct Machine::LoadImage
 	{
-		auto currTime = nanoseconds::zero();
-		int64_t totalTicks = 0;
-		int64_t lastTicks = 0;
-		auto ticksPerIsr = 0ull;
-#ifndef PICO_BOARD
-		auto loadLaunchPolicy = m->opt_.LoadAsync() ? std::launch::async : std::launch::deferred;
-		std::future<std::string> onLoad;
-#endif // PICO_BOARD
-		auto loadMachineState = [&](std::string&& str)
+		// A rom block to write or, when md5 is not empty, the rom to read back and check against the md5
+		struct RomBlock
 		{
-			if (str.empty() == false)
-			{
+			uint16_t offset;
+			std::vector<uint8_t> bytes;
+			std::vector<MemoryRegions::Extent> rom;
+			size_t romSize{};
+			std::vector<uint8_t> md5;
+		};
+
+		enum class Ram
+		{
+			Clear,		// the json has no ram, the ram is cleared
+			Write,		// the decoded ram is written to the ram blocks
+			Resident	// the ram already resides in the memory controller
+		};
+
+		// false when there is nothing to apply: the handler returned no state or it failed to decode
+		bool valid{};
+		// the memory controller uuid the ram was saved with
+		std::vector<uint8_t> memoryUuid;
+		// the rom blocks in the order they appear in the json
+		std::vector<RomBlock> romBlocks;
+		// the rom and ram layout after the load, a snapshot of the current layout taken on the machine thread that the load builds on
+		MemoryRegions regions;
+		Ram ram{ Ram::Clear };
+		std::vector<uint8_t> ramBytes;
+		// the cpu is reset when the json has no cpu state
+		std::optional<CpuState> cpu;
+
+		// the error the json failed to decode with, reported on the machine thread when the image is applied
+		std::error_code error;
+
+		// Decode the json, it only reads the cpu and the regions snapshot so it is safe to call while the machine is running.
+		// Errors are returned rather than reported, the onError handler must only be called from the machine thread.
+		std::error_code Prepare(Machine* m, std::string&& str);
+	};
+
+	std::error_code Machine::LoadImage::Prepare(Machine* m, std::string&& str)
+	{
+		if (str.empty() == true)
+		{
+			return std::error_code{};
+		}
+
 #ifdef ENABLE_NLOHMANN_JSON
-				nlohmann::json json;
+		nlohmann::json json;
 #else
-				JsonDocument json;
+		JsonDocument json;
 #endif // ENABLE_NLOHMANN_JSON
-				auto parseJsonStr = [&json, m](std::string&& str)
-				{
-					auto err = std::error_code{};
+		auto parseJsonStr = [&json](std::string&& str)
+		{
+			auto err = std::error_code{};
 #ifdef ENABLE_NLOHMANN_JSON
-					json = nlohmann::json::parse(str, nullptr, false);
+			json = nlohmann::json::parse(str, nullptr, false);
 
-					if(json.is_discarded() == true)
+			if(json.is_discarded() == true)
 #else
-					auto je = deserializeJson(json, str);
+			auto je = deserializeJson(json, str);
 
-					if(je)
+			if(je)
 #endif // ENABLE_NLOHMANN_JSON
-					{
-						err = m->HandleError(errc::json_parse, std::source_location::current());
-					}
+			{
+				err = make_error_code(errc::json_parse);
+			}
 
-					return err;
-				};
+			return err;
+		};
 
-				if (str.starts_with("file://") == true)
-				{
-					str.erase(0, strlen("file://"));
-					auto fin = fopen(str.c_str(), "r");
+		if (str.starts_with("file://") == true)
+		{
+			str.erase(0, strlen("file://"));
+			auto fin = fopen(str.c_str(), "r");
 
-					if (fin != nullptr)
-					{
+			if (fin != nullptr)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-						json = nlohmann::json::parse(fin, nullptr, false);
-						fclose(fin);
+				json = nlohmann::json::parse(fin, nullptr, false);
+				fclose(fin);
 
-						if(json.is_discarded() == true)
+				if(json.is_discarded() == true)
 #else
-						fseek(fin, 0, SEEK_END);
-						std::string jsonStr(ftell(fin), '\0');
-						fseek(fin, 0, SEEK_SET);
-						
-						if (fread(jsonStr.data(), jsonStr.size(), 1, fin) != 1)
-						{
-							fclose(fin);
-							return m->HandleError(errc::incompatible_rom, std::source_location::current());
-						}
+				fseek(fin, 0, SEEK_END);
+				std::string jsonStr(ftell(fin), '\0');
+				fseek(fin, 0, SEEK_SET);
+				
+				if (fread(jsonStr.data(), jsonStr.size(), 1, fin) != 1)
+				{
+					fclose(fin);
+					return make_error_code(errc::incompatible_rom);
+				}
 
-						fclose(fin);
-						auto je = deserializeJson(json, jsonStr);
+				fclose(fin);
+				auto je = deserializeJson(json, jsonStr);
 
-						if (je)
+				if (je)
 #endif // ENABLE_NLOHMANN_JSON
-						{
-							return m->HandleError(errc::json_parse, std::source_location::current());
-						}
-					}
-					else
-					{
-						return m->HandleError(errc::incompatible_rom, std::source_location::current());
-					}
-				}
-				else if (str.starts_with("json://") == true)
 				{
-					str.erase(0, strlen("json://"));
+					return make_error_code(errc::json_parse);
+				}
+			}
+			else
+			{
+				return make_error_code(errc::incompatible_rom);
+			}
+		}
+		else if (str.starts_with("json://") == true)
+		{
+			str.erase(0, strlen("json://"));
 
-					auto err = parseJsonStr(std::move(str));
+			auto err = parseJsonStr(std::move(str));
 
-					if (err)
-					{
-						return err;
-					}
-				}
-				else
-				{
-					auto err = parseJsonStr(std::move(str));
+			if (err)
+			{
+				return err;
+			}
+		}
+		else
+		{
+			auto err = parseJsonStr(std::move(str));
 
-					if (err)
-					{
-						return err;
-					}
-				}
+			if (err)
+			{
+				return err;
+			}
+		}
 #ifdef ENABLE_NLOHMANN_JSON
-				if(!json.contains("memory"))
+		if(!json.contains("memory"))
 #else
-				if(json["memory"] == nullptr)
+		if(json["memory"] == nullptr)
 #endif // ENABLE_NLOHMANN_JSON
-				{
-					return m->HandleError(errc::json_parse, std::source_location::current());
-				}
+		{
+			return make_error_code(errc::json_parse);
+		}
 
-				auto memory = json["memory"];
+		auto memory = json["memory"];
 #ifdef ENABLE_NLOHMANN_JSON
-				// We must contain at least rom, if we have ram we need a uuid to match against
-				if (!memory.contains("rom")
+		// We must contain at least rom, if we have ram we need a uuid to match against
+		if (!memory.contains("rom")
 #ifdef ENABLE_MEEN_SAVE
-				|| (memory.contains("ram") && !memory.contains("uuid"))
+		|| (memory.contains("ram") && !memory.contains("uuid"))
 #endif // ENABLE_MEEN_SAVE
-				)
+		)
 #else
-				if(memory["rom"] == nullptr
+		if(memory["rom"] == nullptr
 #ifdef ENABLE_MEEN_SAVE
-				|| (memory["ram"] != nullptr && memory["uuid"] == nullptr)
+		|| (memory["ram"] != nullptr && memory["uuid"] == nullptr)
 #endif // ENABLE_MEEN_SAVE
-				)
+		)
 #endif // ENABLE_NLOHMANN_JSON
-				{
-					return m->HandleError(errc::json_parse, std::source_location::current());
-				}
+		{
+			return make_error_code(errc::json_parse);
+		}
 
 #ifdef ENABLE_MEEN_SAVE
-				// The memory controllers must be the same
+		// The memory controllers must be the same
 #ifdef ENABLE_NLOHMANN_JSON
-				if (memory.contains("uuid"))
-				{
-					auto sv = memory["uuid"].get<std::string_view>();
+		if (memory.contains("uuid"))
+		{
+			auto sv = memory["uuid"].get<std::string_view>();
 #else
-				if (memory["uuid"])
-				{
-					auto sv = memory["uuid"].as<std::string_view>();
+		if (memory["uuid"])
+		{
+			auto sv = memory["uuid"].as<std::string_view>();
 #endif // ENABLE_NLOHMANN_JSON
-					auto memUuid = m->memoryController_->Uuid();
 
-					if (sv.starts_with("base64://") == false)
-					{
-						return m->HandleError(errc::uri_scheme, std::source_location::current());
-					}
+			if (sv.starts_with("base64://") == false)
+			{
+				return make_error_code(errc::uri_scheme);
+			}
 
-					sv.remove_prefix(strlen("base64://"));
-					auto jsonUuid = Utils::TxtToBin("base64", "none", 16, std::string(sv));
+			sv.remove_prefix(strlen("base64://"));
+			auto jsonUuid = Utils::TxtToBin("base64", "none", 16, std::string(sv));
 
-					if (!jsonUuid)
-					{
-						return m->HandleError(jsonUuid.error(), std::source_location::current());
-					}
+			if (!jsonUuid)
+			{
+				return jsonUuid.error();
+			}
 
-					if (jsonUuid.value().size() != memUuid.size() || std::equal(jsonUuid.value().begin(), jsonUuid.value().end(), memUuid.begin()) == false)
-					{
-						return m->HandleError(errc::incompatible_uuid, std::source_location::current());
-					}
-				}
+			// compared with the memory controller uuid when the image is applied
+			memoryUuid = std::move(jsonUuid.value());
+		}
 #endif // ENABLE_MEEN_SAVE
 
-				bool clear = true;
+		bool clear = true;
 
 #ifdef ENABLE_NLOHMANN_JSON
-				auto loadRom = [&clear, m](const nlohmann::json& block, std::string_view&& scheme, std::string_view&& directory)
-				{
-					if (!block.contains("bytes"))
+		auto loadRom = [&clear, this](const nlohmann::json& block, std::string_view&& scheme, std::string_view&& directory)
+		{
+			if (!block.contains("bytes"))
 #else
-				auto loadRom = [&clear, m](const JsonVariantConst& block, std::string_view&& scheme, std::string_view&& directory)
-				{
-					if(!block["bytes"])
+		auto loadRom = [&clear, this](const JsonVariantConst& block, std::string_view&& scheme, std::string_view&& directory)
+		{
+			if(!block["bytes"])
 #endif // ENABLE_NLOHMANN_JSON
-					{
-						return m->HandleError(errc::json_config, std::source_location::current());
-					}
+			{
+				return make_error_code(errc::json_config);
+			}
 
 #ifdef ENABLE_NLOHMANN_JSON
-					auto bytes = block["bytes"].get<std::string_view>();
+			auto bytes = block["bytes"].get<std::string_view>();
 #else
-					auto bytes = block["bytes"].as<std::string_view>();
+			auto bytes = block["bytes"].as<std::string_view>();
 #endif //ENABLE_NLOHMANN_JSON
-					int offset = 0;
-					int size = 0;
-					auto err = std::error_code{};
+			int offset = 0;
+			int size = 0;
+			auto err = std::error_code{};
 
 #ifdef ENABLE_NLOHMANN_JSON
-					if (block.contains("offset"))
-					{
-						offset = block["offset"].get<int>();
+			if (block.contains("offset"))
+			{
+				offset = block["offset"].get<int>();
 #else
-					if (block["offset"])
-					{
-						offset = block["offset"].as<int>();
+			if (block["offset"])
+			{
+				offset = block["offset"].as<int>();
 
 #endif // ENABLE_NLOHMANN_JSON
-						if (offset < 0)
-						{
-							return m->HandleError(errc::json_config, std::source_location::current());
-						}
-					}
+				if (offset < 0)
+				{
+					return make_error_code(errc::json_config);
+				}
+			}
 
 #ifdef ENABLE_NLOHMANN_JSON
-					if (block.contains("size"))
-					{
-						size = block["size"].get<int>();
+			if (block.contains("size"))
+			{
+				size = block["size"].get<int>();
 #else
-					if (block["size"])
-					{
-						size = block["size"].as<int>();
+			if (block["size"])
+			{
+				size = block["size"].as<int>();
 #endif // ENABLE_NLOHMANN_JSON
-						if (size < 0)
-						{
-							return m->HandleError(errc::json_config, std::source_location::current());
-						}
-					}
+				if (size < 0)
+				{
+					return make_error_code(errc::json_config);
+				}
+			}
 
-					auto loadFromFile = [m, &clear, offset, &size](std::string_view&& resource)
-					{
-						FILE* fin = fopen(std::string(resource).c_str(), "rb");
+			auto loadFromFile = [this, &clear, offset, &size](std::string_view&& resource)
+			{
+				FILE* fin = fopen(std::string(resource).c_str(), "rb");
 
-						if(fin == nullptr)
-						{
-							return m->HandleError(errc::incompatible_rom, std::source_location::current());
-						}
+				if(fin == nullptr)
+				{
+					return make_error_code(errc::incompatible_rom);
+				}
 
-						// read the entire file if the size is ommitted
-						if (size == 0)
-						{
-							fseek(fin, 0, SEEK_END);
-							size = ftell(fin);
-							fseek(fin, 0, SEEK_SET);
-						}
+				// read the entire file if the size is ommitted
+				if (size == 0)
+				{
+					fseek(fin, 0, SEEK_END);
+					size = ftell(fin);
+					fseek(fin, 0, SEEK_SET);
+				}
 
-						// only support a max of 16 bit addressing
-						if(offset + size > 0xFFFF)
-						{
-							fclose(fin);
-							return m->HandleError(errc::json_config, std::source_location::current());
-						}
+				// only support a max of 16 bit addressing
+				if(offset + size > 0xFFFF)
+				{
+					fclose(fin);
+					return make_error_code(errc::json_config);
+				}
 
-						for (int i = offset; ftell(fin) < size; i++)
-						{
-							uint8_t byte = 0;
-							auto read = fread(&byte, 1, 1, fin);
+				std::vector<uint8_t> romBytes(size);
+				auto read = fread(romBytes.data(), 1, romBytes.size(), fin);
+				romBytes.resize(read);
 
-							if(read == 0)
-							{
-								break;
-							}
+				auto err = ferror(fin);
+				fclose(fin);
 
-							m->memoryController_->Write(i, byte, m->ioController_.get());
-						}
+				if(err != 0)
+				{
+					return make_error_code(errc::incompatible_rom);
+				}
 
-						auto err = ferror(fin);
-						fclose(fin);
+				romBlocks.push_back(RomBlock{ static_cast<uint16_t>(offset), std::move(romBytes), {}, 0, {} });
 
-						if(err != 0)
-						{
-							return m->HandleError(errc::incompatible_rom, std::source_location::current());
-						}
+				if (clear == true)
+				{
+					regions.ClearRom();
+					clear = false;
+				}
 
-						if (clear == true)
-						{
-							m->romMetadata_.clear();
-							clear = false;
+				regions.AddRom(offset, size);
+
+				return std::error_code{};
+			};
+
+			auto loadFromBase64 = [this, &clear, offset](std::string_view&& resource, const char* compressor, int size)
+			{
+				// decompress bytes and write to memory
+				auto romBytesEx = Utils::TxtToBin("base64",
+					compressor,
+					size,
+					std::string(resource.begin(), resource.end()));
+
+				if (!romBytesEx)
+				{
+					return romBytesEx.error();
+				}
+
+				auto romBytes = std::move(romBytesEx.value());
+
+				// only support a max of 16 bit addressing
+				if (offset + romBytes.size() > 0xFFFF)
+				{
+					return make_error_code(errc::json_config);
+				}
+
+				auto romSize = static_cast<uint16_t>(romBytes.size());
+				romBlocks.push_back(RomBlock{ static_cast<uint16_t>(offset), std::move(romBytes), {}, 0, {} });
+
+				if (clear == true)
+				{
+					regions.ClearRom();
+					clear = false;
+				}
+
+				regions.AddRom(offset, romSize);
+
+				return std::error_code{};
+			};
+
+			auto loadFromMem = [this, &clear, offset, size](std::string_view&& resource)
+			{
+				if (size <= 0)
+				{
+					return make_error_code(errc::json_config);
+				}
+
+				uintptr_t value = 0;
+				auto [ptr, ec] = std::from_chars (resource.data(), resource.data() + resource.size(), value, 10);
+
+				if (ec != std::errc() || ptr != resource.data() + resource.size())
+				{
+					return make_error_code(errc::json_config);
+				}
+
+				auto romBytes = reinterpret_cast<const uint8_t*>(value);
+
+				// only support a max of 16 bit addressing
+				if (offset + size > 0xFFFF)
+				{
+					return make_error_code(errc::json_config);
+				}
+
+				romBlocks.push_back(RomBlock{ static_cast<uint16_t>(offset), std::vector<uint8_t>(romBytes, romBytes + size), {}, 0, {} });
+
+				if (clear == true)
+				{
+					regions.ClearRom();
+					clear = false;
+				}
+
+				regions.AddRom(offset, static_cast<uint16_t>(size));
+
+				return std::error_code{};
+			};
+
+			if (bytes.starts_with("file://") == true)
+			{
+				bytes.remove_prefix(strlen("file://"));
+
+				err = loadFromFile(std::move(bytes));
+			}
+			else if (bytes.starts_with("base64://") == true)
+			{
+				bytes.remove_prefix(strlen("base64://"));
+
+				if (bytes.starts_with("md5://") == true)
+				{
+					bytes.remove_prefix(strlen("md5://"));
+
+					if (size == 0)
+					{
+						size = bytes.length();
+					}
+
+					auto jsonMd5 = Utils::TxtToBin("base64",
+						"none",
+						size,
+						std::string(bytes.begin(), bytes.end()));
+
+					if (!jsonMd5)
+					{
+						return jsonMd5.error();
+					}
+
+					// the rom is read back and checked when the image is applied
+					romBlocks.push_back(RomBlock{ 0, {}, regions.Rom(), regions.RomSize(), std::move(jsonMd5.value()) });
+				}
+				else
+				{
+					const char* compressor;
+
+					if (bytes.starts_with("zlib://") == true)
+					{
+						compressor = "zlib";
+
+						if (size <= 0)
+						{
+							return make_error_code(errc::json_config);
 						}
 
-						m->romMetadata_.emplace(offset, size);
+						bytes.remove_prefix(strlen("zlib://"));
+					}
+					else
+					{
+						compressor = "none";
 
-						return std::error_code{};
-					};
+						if (size <= 0)
+						{
+							size = bytes.length();
+						}
+					}
+
+					err = loadFromBase64(std::move(bytes), compressor, size);
+				}
+			}
+			else if (bytes.starts_with("mem://") == true)
+			{
+				bytes.remove_prefix(strlen("mem://"));
+
+				err = loadFromMem(std::move(bytes));
+			}
+			else if (bytes == "memfd://")
+			{
+				// The rom already resides in the memory controller (a memfd shared with another machine), only record its location
+				if (size <= 0 || offset + size > 0xFFFF)
+				{
+					return make_error_code(errc::json_config);
+				}
+
+				if (clear == true)
+				{
+					regions.ClearRom();
+					clear = false;
+				}
+
+				regions.AddRom(offset, static_cast<uint16_t>(size));
+			}
+			else
+			{
+				if (scheme == "file://")
+				{
+					if(directory.empty() == false)
+					{
+						err = loadFromFile(std::string(directory) + "/" + std::string(bytes));
+					}
+					else
+					{
+						err = loadFromFile(std::move(bytes));
+					}
+				}
+				else if (scheme == "base64://")
+				{
+					if (size <= 0)
+					{
+						size = bytes.length();
+					}
+
+					err = loadFromBase64(std::move(bytes), "none", size);
+				}
+				else if (scheme == "mem://")
+				{
+					err = loadFromMem(std::move(bytes));
+				}
+				else
+				{
+					return make_error_code(errc::uri_scheme);
+				}
+			}
+
+			return err;
+		};
+
+#ifdef ENABLE_NLOHMANN_JSON
+		if (memory["rom"].contains("block"))
+		{
+			for (const auto& block : memory["rom"]["block"])
+			{
+				std::string_view scheme = "";
+				std::string_view directory = "";
+
+				if (memory["rom"].contains("scheme"))
+				{
+					scheme = memory["rom"]["scheme"].get<std::string_view>();
+				}
+
+				if (memory["rom"].contains("directory"))
+				{
+					directory = memory["rom"]["directory"].get<std::string_view>();
+				}
+#else
+		if (memory["rom"]["block"])
+		{
+			for (const auto& block : memory["rom"]["block"].as<JsonArrayConst>())
+			{
+				std::string_view scheme = "";
+				std::string_view directory = "";
+
+				if (memory["rom"]["scheme"])
+				{
+					scheme = memory["rom"]["scheme"].as<std::string_view>();
+				}
+
+				if (memory["rom"]["directory"])
+				{
+					directory = memory["rom"]["directory"].as<std::string_view>();
+				}
+#endif // ENABLE_NLOHMANN_JSON
+				auto err = loadRom(block, std::move(scheme), std::move(directory));
+
+				if (err)
+				{
+					return err;
+				}
+			}
+		}
+		else
+		{
+			auto err = loadRom(memory["rom"], "", "");
+
+			if (err)
+			{
+				return err;
+			}
+		}
+
+		// derive the ram blocks from the rom
+		regions.Build();
+
+#ifdef ENABLE_MEEN_SAVE
+#ifdef ENABLE_NLOHMANN_JSON
+		if (memory.contains("ram"))
+#else
+		if (memory["ram"])
+#endif // ENABLE_NLOHMANN_JSON
+		{
+			// flat ram, decompress the entire ram
+#ifdef ENABLE_NLOHMANN_JSON
+			if (!memory["ram"].contains("bytes"))
+#else
+			if (!memory["ram"]["bytes"])
+#endif // ENABLE_NLOHMANN_JSON
+			{
+				return make_error_code(errc::json_config);
+			}
+
+#ifdef ENABLE_NLOHMANN_JSON
+			auto bytes = memory["ram"]["bytes"].get<std::string_view>();
+#else
+			auto bytes = memory["ram"]["bytes"].as<std::string_view>();
+#endif // ENABLE_NLOHMANN_JSON
+			auto size = regions.RamSize();
+
+			// When the ram already resides in the memory controller (a memfd shared with another machine) it is left untouched
+			ram = bytes == "memfd://" ? Ram::Resident : Ram::Write;
+
+			if (bytes.starts_with("base64://") == true)
+			{
+				std::string compressor = "none";
+				bytes.remove_prefix(strlen("base64://"));
+
+				if (bytes.starts_with("zlib://") == true)
+				{
+					compressor = "zlib";
+					bytes.remove_prefix(strlen("zlib://"));
+				}
+
+				auto ramEx = Utils::TxtToBin("base64",
+					compressor,
+					size,
+					std::string(bytes));
+
+				if (!ramEx)
+				{
+					return ramEx.error();
+				}
+
+				ramBytes = std::move(ramEx.value());
 
-					auto loadFromBase64 = [m, &clear, offset](std::string_view&& resource, const char* compressor, int size)
+				if (ramBytes.size() != size)
+				{
+					return make_error_code(errc::incompatible_ram);
+				}
+			}
+			else if (ram == Ram::Write)
+			{
+				return make_error_code(errc::uri_scheme);
+			}
+		}
+#endif // ENABLE_MEEN_SAVE
+
+#ifdef ENABLE_NLOHMANN_JSON
+		if (json.contains("cpu"))
+		{
+			// if ram exists we need to check for cpu uuid compatibility
+			auto cpuState = m->cpu_->Parse(json["cpu"].dump(),
+#ifdef ENABLE_MEEN_SAVE
+			memory.contains("ram")
+#else
+			false
+#endif // ENABLE_MEEN_SAVE
+			);
+#else
+		if (json["cpu"])
+		{
+			std::string cpuStr;
+			serializeJson(json["cpu"], cpuStr);
+
+			if(cpuStr.empty() == true)
+			{
+				return make_error_code(errc::json_parse);
+			}
+
+			auto cpuState = m->cpu_->Parse(std::move(cpuStr),
+#ifdef ENABLE_MEEN_SAVE
+			memory["ram"]
+#else
+			false
+#endif // ENABLE_MEEN_SAVE
+			);
+#endif // ENABLE_NLOHMANN_JSON
+			if (!cpuState)
+			{
+				return cpuState.error();
+			}
+
+			cpu = std::move(cpuState.value());
+		}
+
+		valid = true;
+		return std::error_code{};
+	}
+
+	// The state of the run loop, kept between RunFor calls so the next call resumes where the last one stopped
+	struct Machine::RunState
+	{
+		nanoseconds currTime{};
+		int64_t totalTicks{};
+		int64_t ticksPerIsr{};
+#ifndef PICO_BOARD
+		std::future<Machine::LoadImage> onLoad;
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+		std::future<std::string> onSave;
+#endif // ENABLE_MEEN_SAVE
+		int ticks{};
+		// The cycle count at which the default io controller will next be polled for interrupts
+		int64_t ioPoll{};
+		// The cycle count at which the default io controller would next be polled at the isrFreq rate
+		int64_t ioRate{};
+		// The machine time at which the default io controller asked to be polled next when the clock is throttled
+		int64_t ioPollTime{ std::numeric_limits<int64_t>::max() };
+		// The earliest poll time of all the io controllers
+		int64_t pollTime{ std::numeric_limits<int64_t>::max() };
+
+		// The io controllers attached to port ranges, each is polled at its own rate
+		struct IoDevice
+		{
+			IController* controller;
+			int64_t ticksPerIsr;
+			int64_t poll;
+			int64_t rate;
+			int64_t pollTime;
+		};
+
+		std::vector<IoDevice> ioDevices;
+		WatchController* watchController{};
+		// The cycle count the last bounded run was due to stop at
+		int64_t end{};
+	};
+
+	void RunMachine(meen::Machine* m, int64_t cycles)
+	{
+		// Resume the suspended run or start a new one
+		auto resume = m->runState_ != nullptr;
+
+		if (resume == false)
+		{
+			m->runState_ = std::make_unique<Machine::RunState>();
+		}
+
+		auto& state = *m->runState_;
+		auto& currTime = state.currTime;
+		auto& totalTicks = state.totalTicks;
+		auto& ticksPerIsr = state.ticksPerIsr;
+#ifndef PICO_BOARD
+		auto loadLaunchPolicy = m->opt_.LoadAsync() ? std::launch::async : std::launch::deferred;
+		auto& onLoad = state.onLoad;
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+		auto& savedRam = m->savedRam_;
+		auto& savedRamTxt = m->savedRamTxt_;
+		auto& savedRomMd5 = m->savedRomMd5_;
+		auto& savedMemoryValid = m->savedMemoryValid_;
+#endif // ENABLE_MEEN_SAVE
+		// Copy a prepared machine state into the machine, called on the machine thread at an instruction boundary
+		auto applyLoad = [&](Machine::LoadImage&& image)
+		{
+			if (image.error)
+			{
+				return m->HandleError(image.error, std::source_location::current());
+			}
+
+			if (image.valid == false)
+			{
+				return std::error_code{};
+			}
+
+#ifdef ENABLE_MEEN_SAVE
+			// the memory layout and contents are about to change
+			savedMemoryValid = false;
+
+			// The memory controllers must be the same
+			if (image.memoryUuid.empty() == false)
+			{
+				auto memUuid = m->memoryController_->Uuid();
+
+				if (image.memoryUuid.size() != memUuid.size() || std::equal(image.memoryUuid.begin(), image.memoryUuid.end(), memUuid.begin()) == false)
+				{
+					return m->HandleError(errc::incompatible_uuid, std::source_location::current());
+				}
+			}
+#endif // ENABLE_MEEN_SAVE
+
+			const auto& romBlocks = image.romBlocks;
+
+			// Check every md5 before anything is written so that a rejected state leaves the memory untouched. An md5 covers the
+			// rom as it would be after the blocks that precede it are written, so their bytes are overlaid on the rom read back.
+			for (auto md5Block = romBlocks.begin(); md5Block != romBlocks.end(); md5Block++)
+			{
+				if (md5Block->md5.empty() == false)
+				{
+					std::vector<uint8_t> rom(md5Block->romSize);
+					MemoryRegions::Gather(m->memoryController_.get(), md5Block->rom, rom.data(), m->ioController_.get());
+
+					for (auto block = romBlocks.begin(); block != md5Block; block++)
 					{
-						// decompress bytes and write to memory
-						auto romBytesEx = Utils::TxtToBin("base64",
-							compressor,
-							size,
-							std::string(resource.begin(), resource.end()));
+						auto romIt = rom.data();
 
-						if (!romBytesEx)
+						for (const auto& extent : md5Block->rom)
 						{
-							return m->HandleError(romBytesEx.error(), std::source_location::current());
+							auto begin = std::max<int>(extent.offset, block->offset);
+							auto end = std::min<int>(extent.offset + extent.size, block->offset + block->bytes.size());
+
+							if (begin < end)
+							{
+								std::copy(block->bytes.begin() + (begin - block->offset), block->bytes.begin() + (end - block->offset), romIt + (begin - extent.offset));
+							}
+
+							romIt += extent.size;
 						}
+					}
+
+					auto romMd5 = Utils::Md5(rom.data(), rom.size());
+
+					if (md5Block->md5.size() != romMd5.size() || std::equal(md5Block->md5.begin(), md5Block->md5.end(), romMd5.begin()) == false)
+					{
+						return m->HandleError(errc::incompatible_rom, std::source_location::current());
+					}
+				}
+			}
+
+			for (const auto& block : romBlocks)
+			{
+				if (block.md5.empty() == true)
+				{
+					MemoryRegions::Write(m->memoryController_.get(), block.offset, block.bytes.data(), block.bytes.size(), m->ioController_.get());
+				}
+			}
+
+			m->memoryRegions_ = std::move(image.regions);
+
+			if (image.ram == Machine::LoadImage::Ram::Write)
+			{
+				// write the decompressed ram to each ram block
+				MemoryRegions::Scatter(m->memoryController_.get(), m->memoryRegions_.Ram(), image.ramBytes.data(), m->ioController_.get());
+			}
+			else if (image.ram == Machine::LoadImage::Ram::Clear)
+			{
+				// make sure the ram is clear
+				for (const auto& rm : m->memoryRegions_.Ram())
+				{
+					MemoryRegions::Fill(m->memoryController_.get(), rm.offset, 0x00, rm.size, m->ioController_.get());
+				}
+			}
+
+			if (image.cpu.has_value() == true)
+			{
+				m->cpu_->Apply(image.cpu.value());
+			}
+			else
+			{
+				m->cpu_->Reset();
+			}
+
+			auto err = std::error_code{};
+
+			if (m->onLoadComplete_ != nullptr)
+			{
+				err = make_error_code(m->onLoadComplete_(m->ioController_.get()));
+			}
+
+			m->NotifyIdle();
+			return err;
+		};
+
+#ifndef PICO_BOARD
+		auto checkHandler = []<typename T>(std::future<T>& fut)
+		{
+			T value{};
+
+			if (fut.valid() == true)
+			{
+				auto status = fut.wait_for(nanoseconds::zero());
+
+				if (status == std::future_status::deferred || status == std::future_status::ready)
+				{
+					value = fut.get();
+				}
+			}
+
+			return value;
+		};
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+		auto saveLaunchPolicy = m->opt_.SaveAsync() ? std::launch::async : std::launch::deferred;
+		auto& onSave = state.onSave;
+#endif // ENABLE_MEEN_SAVE
+		auto& ticks = state.ticks;
+		auto scheduler = &m->scheduler_;
+		auto& ioPoll = state.ioPoll;
+		auto& ioRate = state.ioRate;
+		auto& ioPollTime = state.ioPollTime;
+		auto& pollTime = state.pollTime;
+		auto& ioDevices = state.ioDevices;
+		auto& watchController = state.watchController;
+
+		// A resumed run keeps the memory routing, io ports and trap it started with
+		if (resume == false)
+		{
+			auto memoryController = m->memoryController_.get();
+			auto fetchController = m->memoryController_.get();
+
+			// Only route the cpu memory accesses through the profile and watch controllers when they are in use
+			if (m->profileController_ != nullptr)
+			{
+				m->profileController_->SetMemoryController(memoryController);
+				memoryController = m->profileController_.get();
+				fetchController = m->profileController_->Fetch();
+			}
+
+			if (m->watchController_ != nullptr)
+			{
+				auto read = m->watchController_->Armed(Watch::Read);
+				auto write = m->watchController_->Armed(Watch::Write);
+				auto exec = m->watchController_->Armed(Watch::Exec);
+
+				if (read == true || write == true || exec == true)
+				{
+					watchController = m->watchController_.get();
+					watchController->SetMemoryController(memoryController, fetchController);
+					watchController->ClearHits();
+					// Poll at the next instruction boundary so the hit is delivered promptly
+					watchController->OnHit([scheduler, &ioPoll]
+					{
+						ioPoll = 0;
+						scheduler->SetPoll(0);
+					});
+
+					if (read == true || write == true)
+					{
+						memoryController = watchController;
+					}
+
+					if (exec == true)
+					{
+						fetchController = watchController->Fetch();
+					}
+				}
+			}
+
+			m->cpu_->SetMemoryController(memoryController);
+			m->cpu_->SetIoPorts(m->ioPortMap_.Resolve(m->ioController_.get()));
+
+			if (m->onTrap_)
+			{
+				m->cpu_->SetTrap(m->trapAddress_, [m](Registers& registers)
+				{
+					return m->onTrap_(registers, m->memoryController_.get());
+				});
+			}
+			else
+			{
+				m->cpu_->SetTrap(0, nullptr);
+			}
+
+			m->cpu_->SetFetchController(fetchController);
+		}
+
+		// Request the machine state from the onLoad handler and load it, done outside the run loop so it is not instantiated for each run loop configuration
+		auto serviceLoad = [&]
+		{
+			// If a user defined callback is set and we are not processing a load or save request
+			if (m->onLoad_ != nullptr
+#ifndef PICO_BOARD
+				&& onLoad.valid() == false
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+				&& onSave.valid() == false
+#endif // ENABLE_MEEN_SAVE
+			)
+			{
+				Machine::LoadImage image;
+				// the load builds on the current memory layout, snapshot it before going off the machine thread
+				image.regions = m->memoryRegions_;
+#ifndef PICO_BOARD
+				onLoad = std::async(loadLaunchPolicy, [m, image = std::move(image)]() mutable
+				{
+#endif // PICO_BOARD
+					int len = m->opt_.MaxLoadStateLength();
+					std::string str(len, '\0');
+
+					auto e = m->onLoad_(str.data(), &len, m->ioController_.get());
 
-						auto romBytes = std::move(romBytesEx.value());
+					if(e)
+					{
+						str.clear();
+						m->HandleError(e, std::source_location::current());
+					}
 
-						// only support a max of 16 bit addressing
-						if (offset + romBytes.size() > 0xFFFF)
-						{
-							return m->HandleError(errc::json_config, std::source_location::current());
-						}
+					str.resize(len);
 
-						for (int i = 0; i < romBytes.size(); i++)
-						{
-							m->memoryController_->Write(offset + i, romBytes[i], m->ioController_.get());
-						}
+					// decode the state here so the machine thread only has to copy it into the machine
+					image.error = image.Prepare(m, std::move(str));
+#ifndef PICO_BOARD
+					return std::move(image);
+				});
 
-						if (clear == true)
-						{
-							m->romMetadata_.clear();
-							clear = false;
-						}
+				applyLoad(checkHandler(onLoad));
+#else
+				applyLoad(std::move(image));
+#endif // PICO_BOARD
+			}
+		};
+
+#ifdef ENABLE_MEEN_SAVE
+		// Save the machine state via the onSave handlers
+		auto serviceSave = [&]
+		{
+			// If a user defined callback is set and we are not processing a save or load request
+			if (m->onSaveBegin_ != nullptr && onSave.valid() == false && onLoad.valid() == false)
+			{
+				auto memUuid = m->memoryController_->Uuid();
+				auto memUuidTxt = Utils::BinToTxt(m->opt_.Encoder(), "none", memUuid.data(), memUuid.size());
 
-						m->romMetadata_.emplace(offset, static_cast<uint16_t>(romBytes.size()));
+				if (memUuidTxt)
+				{
+					const auto& regions = m->memoryRegions_;
+					auto memoryController = m->memoryController_.get();
 
-						return std::error_code{};
+					auto romMd5 = [&regions, memoryController]()
+					{
+						std::vector<uint8_t> rom(regions.RomSize());
+						MemoryRegions::Gather(memoryController, regions.Rom(), rom.data(), nullptr);
+						return Utils::Md5(rom.data(), rom.size());
 					};
 
-					auto loadFromMem = [m, &clear, offset, size](std::string_view&& resource)
+					auto dirtyPages = memoryController->DirtyPages();
+					// the encoded ram is only rebuilt when the ram has changed since the last save
+					auto ramChanged = dirtyPages == nullptr || savedMemoryValid == false;
+
+					if (ramChanged == true)
 					{
-						if (size <= 0)
+						savedRomMd5 = romMd5();
+						savedRam.resize(regions.RamSize());
+						MemoryRegions::Gather(memoryController, regions.Ram(), savedRam.data(), nullptr);
+
+						if (dirtyPages != nullptr)
 						{
-							return m->HandleError(errc::json_config, std::source_location::current());
+							dirtyPages->reset();
+							savedMemoryValid = true;
 						}
-
-						uintptr_t value = 0;
-						auto [ptr, ec] = std::from_chars (resource.data(), resource.data() + resource.size(), value, 10);
-
-						if (ec != std::errc() || ptr != resource.data() + resource.size())
+					}
+					else if (dirtyPages->any() == true)
+					{
+						if ((*dirtyPages & regions.RomPages()).any() == true)
 						{
-							return m->HandleError(errc::json_config, std::source_location::current());
+							savedRomMd5 = romMd5();
 						}
 
-						auto romBytes = reinterpret_cast<const uint8_t*>(value);
+						auto ramDirty = *dirtyPages & regions.RamPages();
+						auto ramIt = savedRam.data();
+						ramChanged = ramDirty.any();
 
-						// only support a max of 16 bit addressing
-						if (offset + size > 0xFFFF)
+						// only read back the parts of each ram block that reside in a dirty page
+						for (const auto& block : regions.Ram())
 						{
-							return m->HandleError(errc::json_config, std::source_location::current());
-						}
+							int end = block.offset + block.size;
 
-						for (int i = 0; i < size; i++)
-						{
-							m->memoryController_->Write(offset + i, romBytes[i], m->ioController_.get());
-						}
+							for (int page = block.offset >> 8; ramDirty.any() == true && page <= (end - 1) >> 8; page++)
+							{
+								if (ramDirty.test(page) == true)
+								{
+									auto begin = std::max<int>(block.offset, page << 8);
+									MemoryRegions::Read(memoryController, begin, ramIt + (begin - block.offset), std::min(end, (page + 1) << 8) - begin, nullptr);
+								}
+							}
 
-						if (clear == true)
-						{
-							m->romMetadata_.clear();
-							clear = false;
+							ramIt += block.size;
 						}
 
-						m->romMetadata_.emplace(offset, static_cast<uint16_t>(size));
-
-						return std::error_code{};
-					};
+						dirtyPages->reset();
+					}
 
-					if (bytes.starts_with("file://") == true)
-					{
-						bytes.remove_prefix(strlen("file://"));
+					auto romMd5Txt = Utils::BinToTxt(m->opt_.Encoder(), "none", savedRomMd5.data(), savedRomMd5.size());
 
-						err = loadFromFile(std::move(bytes));
-					}
-					else if (bytes.starts_with("base64://") == true)
+					if (romMd5Txt)
 					{
-						bytes.remove_prefix(strlen("base64://"));
+						std::error_code ramErr;
 
-						if (bytes.starts_with("md5://") == true)
+						if (ramChanged == true)
 						{
-							bytes.remove_prefix(strlen("md5://"));
+							auto ramTxt = Utils::BinToTxt(m->opt_.Encoder(), m->opt_.Compressor(), savedRam.data(), savedRam.size());
 
-							if (size == 0)
+							if (ramTxt)
 							{
-								size = bytes.length();
+								savedRamTxt = std::move(ramTxt.value());
 							}
-
-							auto jsonMd5 = Utils::TxtToBin("base64",
-								"none",
-								size,
-								std::string(bytes.begin(), bytes.end()));
-
-							if (!jsonMd5)
+							else
 							{
-								return m->HandleError(jsonMd5.error(), std::source_location::current());
+								ramErr = ramTxt.error();
+								savedMemoryValid = false;
 							}
+						}
 
-							std::vector<uint8_t> rom;
+						if (!ramErr)
+						{
+							auto cpuStateTxt = m->cpu_->Save();
 
-							for (const auto& rm : m->romMetadata_)
+							if (cpuStateTxt)
 							{
-								for (int addr = rm.first; addr < rm.first + rm.second; addr++)
+								auto ramSize = savedRam.size();
+								auto str = std::vformat(R"({{"cpu":{},"memory":{{"uuid":"{}://{}","rom":{{"bytes":"{}://md5://{}"}},"ram":{{"size":{},"bytes":"{}://{}://{}"}}}}}})",
+														std::make_format_args(cpuStateTxt.value(), m->opt_.Encoder(), memUuidTxt.value(), m->opt_.Encoder(), romMd5Txt.value(),
+														ramSize, m->opt_.Encoder(), m->opt_.Compressor(), savedRamTxt));
+
+								onSave = std::async(saveLaunchPolicy, [m, state = std::move(str)]
 								{
-									rom.push_back(m->memoryController_->Read(addr, m->ioController_.get()));
-								}
-							}
+									int len = 255;
+									std::string uri(len + 1, '\0');
 
-							auto romMd5 = Utils::Md5(rom.data(), rom.size());
+									auto e = m->onSaveBegin_(uri.data(), &len, m->ioController_.get());
 
-							if (jsonMd5.value().size() != romMd5.size() || std::equal(jsonMd5.value().begin(), jsonMd5.value().end(), romMd5.begin()) == false)
-							{
-								return m->HandleError(errc::incompatible_rom, std::source_location::current());
-							}
-						}
-						else
-						{
-							const char* compressor;
+									if (!e)
+									{
+										uri.resize(len);
 
-							if (bytes.starts_with("zlib://") == true)
-							{
-								compressor = "zlib";
+										if (uri.starts_with("file://"))
+										{
+											uri.erase(uri.begin(), uri.begin() + strlen("file://"));
+											std::filesystem::path path(std::move(uri));
+											auto fileName = path.filename();
+											path.remove_filename();
 
-								if (size <= 0)
-								{
-									return m->HandleError(errc::json_config, std::source_location::current());
-								}
+											std::error_code ec;
+											std::filesystem::create_directories(path, ec);
 
-								bytes.remove_prefix(strlen("zlib://"));
-							}
-							else
-							{
-								compressor = "none";
+											if (!ec)
+											{
+												std::ofstream fout(path / fileName, std::ios::trunc);
 
-								if (size <= 0)
-								{
-									size = bytes.length();
-								}
-							}
+												if (!fout.good())
+												{
+													e = meen::errc::invalid_argument;
+												}
+												else
+												{
+													fout.write(state.data(), state.size());
 
-							err = loadFromBase64(std::move(bytes), compressor, size);
-						}
-					}
-					else if (bytes.starts_with("mem://") == true)
-					{
-						bytes.remove_prefix(strlen("mem://"));
+													if (fout.good())
+													{
+														if (m->onSave_)
+														{
+															// We wrote successfully, set nullptr location and json to indicate there is nothing to write.
+															m->onSave_(nullptr, nullptr, m->ioController_.get());
+														}
+													}
+													else
+													{
+														e = meen::errc::incompatible_ram;
+													}
+												}
+											}
+											else
+											{
+												e = meen::errc::invalid_argument;
+											}
 
-						err = loadFromMem(std::move(bytes));
-					}
-					else
-					{
-						if (scheme == "file://")
-						{
-							if(directory.empty() == false)
-							{
-								err = loadFromFile(std::string(directory) + "/" + std::string(bytes));
+											if (e)
+											{
+												// We failed to write, give the completion handler a chance to write it correctly.
+												if (m->onSave_)
+												{
+													e = m->onSave_((std::string("file://") + "/" + path.string() + "/" + fileName.string()).c_str(), state.c_str(), m->ioController_.get());
+												}
+
+												if (e)
+												{
+													m->HandleError(e, std::source_location::current());
+												}
+											}
+										}
+										else
+										{
+											e = meen::errc::uri_scheme;
+
+											// We don't understand the protocol, pass it along to the completion handler to handle.
+											if (m->onSave_)
+											{
+												e = m->onSave_(uri.c_str(), state.c_str(), m->ioController_.get());
+											}
+
+											if (e)
+											{
+												m->HandleError(e, std::source_location::current());
+											}
+										}
+									}
+									else
+									{
+										m->HandleError(e, std::source_location::current());
+									}
+
+									m->NotifyIdle();
+									return std::string("");
+								});
+
+								checkHandler(onSave);
 							}
 							else
 							{
-								err = loadFromFile(std::move(bytes));
-							}
-						}
-						else if (scheme == "base64://")
-						{
-							if (size <= 0)
-							{
-								size = bytes.length();
+								m->HandleError(cpuStateTxt.error(), std::source_location::current());
 							}
-
-							err = loadFromBase64(std::move(bytes), "none", size);
-						}
-						else if (scheme == "mem://")
-						{
-							err = loadFromMem(std::move(bytes));
 						}
 						else
 						{
-							return m->HandleError(errc::uri_scheme, std::source_location::current());
+							m->HandleError(ramErr, std::source_location::current());
 						}
 					}
-
-					return err;
-				};
-
-#ifdef ENABLE_NLOHMANN_JSON
-				if (memory["rom"].contains("block"))
-				{
-					for (const auto& block : memory["rom"]["block"])
-					{
-						std::string_view scheme = "";
-						std::string_view directory = "";
-
-						if (memory["rom"].contains("scheme"))
-						{
-							scheme = memory["rom"]["scheme"].get<std::string_view>();
-						}
-
-						if (memory["rom"].contains("directory"))
-						{
-							directory = memory["rom"]["directory"].get<std::string_view>();
-						}
-#else
-				if (memory["rom"]["block"])
-				{
-					for (const auto& block : memory["rom"]["block"].as<JsonArrayConst>())
+					else
 					{
-						std::string_view scheme = "";
-						std::string_view directory = "";
-
-						if (memory["rom"]["scheme"])
-						{
-							scheme = memory["rom"]["scheme"].as<std::string_view>();
-						}
-
-						if (memory["rom"]["directory"])
-						{
-							directory = memory["rom"]["directory"].as<std::string_view>();
-						}
-#endif // ENABLE_NLOHMANN_JSON
-						auto err = loadRom(block, std::move(scheme), std::move(directory));
-
-						if (err)
-						{
-							return err;
-						}
+						m->HandleError(romMd5Txt.error(), std::source_location::current());
 					}
 				}
 				else
 				{
-					auto err = loadRom(memory["rom"], "", "");
-
-					if (err)
-					{
-						return err;
-					}
+					m->HandleError(memUuidTxt.error(), std::source_location::current());
 				}
+			}
+		};
+#endif // ENABLE_MEEN_SAVE
 
-				int offset = 0;
-				m->ramMetadata_.clear();
+		// The run loop, specialised at compile time on the configuration of the run so the common cases do not pay for the features they do not use
+		auto runLoop = [&]<bool Async, bool Throttled, bool Handlers, bool Polled>()
+		{
+			auto serviceWatchpoints = [&]
+			{
+				bool quit = false;
 
-				// store an ascending sorted ram map with offset as the key (derived from the rom)
-				for (const auto& r : m->romMetadata_)
+				if (watchController != nullptr && watchController->Hits().empty() == false)
 				{
-					if (offset < r.first)
+					if (m->onWatch_)
 					{
-						m->ramMetadata_.emplace(offset, r.first - offset);
+						for (const auto& [address, watch] : watchController->Hits())
+						{
+							quit |= m->onWatch_(address, watch, m->ioController_.get());
+						}
 					}
 
-					offset = r.first + r.second;
+					watchController->ClearHits();
 				}
 
-				// add the last ram block
-				if (offset < 0xFFFF)
-				{
-					m->ramMetadata_.emplace(offset, 0xFFFF - offset);
-				}
+				return quit;
+			};
 
-#ifdef ENABLE_MEEN_SAVE
-#ifdef ENABLE_NLOHMANN_JSON
-				if (memory.contains("ram"))
-#else
-				if (memory["ram"])
-#endif // ENABLE_NLOHMANN_JSON
+			auto serviceIsr = [&](ISR isr)
+			{
+				bool quit = false;
+
+				switch (isr)
 				{
-					// flat ram, decompress the entire ram
-#ifdef ENABLE_NLOHMANN_JSON
-					if (!memory["ram"].contains("bytes"))
-#else
-					if (!memory["ram"]["bytes"])
-#endif // ENABLE_NLOHMANN_JSON
+					case ISR::Zero:
+					case ISR::One:
+					case ISR::Two:
+					case ISR::Three:
+					case ISR::Four:
+					case ISR::Five:
+					case ISR::Six:
+					case ISR::Seven:
 					{
-						return m->HandleError(errc::json_config, std::source_location::current());
+						// delivered by the run loop once the cpu has interrupts enabled
+						m->interruptController_.Raise(isr);
+						break;
 					}
-
-#ifdef ENABLE_NLOHMANN_JSON
-					auto bytes = memory["ram"]["bytes"].get<std::string_view>();
-#else
-					auto bytes = memory["ram"]["bytes"].as<std::string_view>();
-#endif // ENABLE_NLOHMANN_JSON
-					std::vector<uint8_t> ram;
-					auto size = std::accumulate (m->ramMetadata_.begin(), m->ramMetadata_.end(), 0, [](int accumulator, const std::pair<uint16_t, uint16_t>& metadata)
+					case ISR::Load:
 					{
-						return accumulator + metadata.second;
-					});
+						if constexpr (Handlers == true)
+						{
+							serviceLoad();
+						}
 
-					if (bytes.starts_with("base64://") == true)
+						break;
+					}
+					case ISR::Save:
 					{
-						std::string compressor = "none";
-						bytes.remove_prefix(strlen("base64://"));
-
-						if (bytes.starts_with("zlib://") == true)
+#ifdef ENABLE_MEEN_SAVE
+						if constexpr (Handlers == true)
 						{
-							compressor = "zlib";
-							bytes.remove_prefix(strlen("zlib://"));
+							serviceSave();
 						}
-
-						auto ramEx = Utils::TxtToBin("base64",
-							compressor,
-							size,
-							std::string(bytes));
-
-						if (!ramEx)
+#endif // ENABLE_MEEN_SAVE
+						break;
+					}
+					case ISR::Quit:
+					{
+						// Wait for any outstanding load/save requests to complete
+						if constexpr (Handlers == true)
 						{
-							return m->HandleError(ramEx.error(), std::source_location::current());
+#ifndef PICO_BOARD
+							if (onLoad.valid() == true)
+							{
+								// we are quitting, wait for the onLoad handler to complete
+								applyLoad(onLoad.get());
+							}
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+							if (onSave.valid() == true)
+							{
+								// we are quitting, wait for the onSave handler to complete
+								onSave.get();
+							}
+#endif // ENABLE_MEEN_SAVE
 						}
 
-						ram = std::move(ramEx.value());
+						quit = true;
 
-						if (ram.size() != size)
+						if constexpr (Async == true)
 						{
-							return m->HandleError(errc::incompatible_ram, std::source_location::current());
+							m->quit_ = true;
+							m->NotifyIdle();
 						}
+						break;
 					}
-					else
+					case ISR::NoInterrupt:
 					{
-						return m->HandleError(errc::uri_scheme, std::source_location::current());
-					}
+						// no interrupts pending, do any work that is outstanding
 
-					auto ramIt = ram.begin();
-
-					// loop ramMetadata writing the size bytes from decompressed ram to memory at offset
-					for (const auto& rm : m->ramMetadata_)
-					{
-						// only support a max of 16 bit addressing
-						if (rm.first + rm.second > 0xFFFF)
+						if constexpr (Async == true)
 						{
-							return m->HandleError(errc::json_config, std::source_location::current());
+							if (m->quit_ == true)
+							{
+								quit = true;
+							}
+						}
+						else
+						{
+							if (m->onIdle_)
+							{
+								quit = m->onIdle_(m->ioController_.get());
+							}
 						}
 
-						for (int addr = rm.first; addr < rm.first + rm.second; addr++)
+						if constexpr (Handlers == true)
 						{
-							m->memoryController_->Write(addr, *ramIt++, m->ioController_.get());
+#ifndef PICO_BOARD
+							applyLoad(checkHandler(onLoad));
+#endif // PICO_BOARD
+#ifdef ENABLE_MEEN_SAVE
+							checkHandler(onSave);
+#endif // ENABLE_MEEN_SAVE
 						}
+						break;
 					}
-				}
-				else
-#endif // ENABLE_MEEN_SAVE
-				{
-					// make sure the ram is clear
-					for (const auto& rm : m->ramMetadata_)
+					default:
 					{
-						for (int addr = rm.first; addr < rm.first + rm.second; addr++)
-						{
-							m->memoryController_->Write(addr, 0x00, m->ioController_.get());
-						}
+						//assert(0);
+						break;
 					}
 				}
 
-#ifdef ENABLE_NLOHMANN_JSON
-				if (json.contains("cpu"))
-				{
-					// if ram exists we need to check for cpu uuid compatibility
-					auto err = m->cpu_->Load(json["cpu"].dump(),
-#ifdef ENABLE_MEEN_SAVE
-					memory.contains("ram")
-#else
-					false
-#endif // ENABLE_MEEN_SAVE
-					);
-#else
-				if (json["cpu"])
-				{
-					std::string cpuStr;
-					serializeJson(json["cpu"], cpuStr);
+				return quit;
+			};
 
-					if(cpuStr.empty() == true)
+			auto serviceInterrupts = [&]
+			{
+				if constexpr (Polled == true)
+				{
+					if (serviceWatchpoints() == true)
 					{
-						return m->HandleError(errc::json_parse, std::source_location::current());
+						return serviceIsr(ISR::Quit);
 					}
+				}
 
-					auto err = m->cpu_->Load(std::move(cpuStr),
-#ifdef ENABLE_MEEN_SAVE
-					memory["ram"]
-#else
-					false
-#endif // ENABLE_MEEN_SAVE
-					);
-#endif // ENABLE_NLOHMANN_JSON
-					if (err)
-					{
-						return err;
-					}
+				return serviceIsr(m->ioController_->GenerateInterrupt(currTime.count(), totalTicks, m->memoryController_.get()));
+			};
+
+			constexpr auto never = std::numeric_limits<int64_t>::max();
+			// The idle processing is only needed to call the OnIdle handler of a machine that is not running async or to check for completed load and save requests
+			auto idle = Handlers == true || (Async == false && m->onIdle_ != nullptr);
+			// The number of cycles the unthrottled clock has not been ticked for
+			uint64_t pendingTicks = 0;
+
+			// Advance the machine time, an unthrottled clock only reads the host time so it is ticked when the time is needed instead of after every instruction.
+			// A run that starts unthrottled and is throttled by a ClockSamplingFreq command is synchronised at each event service instead.
+			auto tick = [&](int count)
+			{
+				if constexpr (Throttled == true)
+				{
+					currTime = m->clock_->Tick(count);
 				}
 				else
 				{
-					m->cpu_->Reset();
+					pendingTicks += count;
 				}
+			};
 
-				if (m->onLoadComplete_ != nullptr)
+			auto syncTime = [&]
+			{
+				if constexpr (Throttled == false)
 				{
-					return make_error_code(m->onLoadComplete_(m->ioController_.get()));
+					currTime = m->clock_->Tick(pendingTicks);
+					pendingTicks = 0;
 				}
-			}
-
-			return std::error_code{};
-		};
-
-#ifndef PICO_BOARD
-		auto checkHandler = [](std::future<std::string>& fut)
-		{
-			std::string str;
+			};
 
-			if (fut.valid() == true)
+			// The cycle count at which a controller next needs to be polled, either the time it asked for or after ticksPerIsr cycles
+			auto nextPoll = [&](IController* controller, int64_t ticksPerIsr, int64_t& rate, int64_t& at)
 			{
-				auto status = fut.wait_for(nanoseconds::zero());
+				auto time = controller->NextPoll(currTime.count(), totalTicks);
+				rate = totalTicks + ticksPerIsr;
+				at = never;
 
-				if (status == std::future_status::deferred || status == std::future_status::ready)
+				if (time == 0)
 				{
-					str = fut.get();
+					return rate;
 				}
-			}
 
-			return str;
-		};
-#endif // PICO_BOARD
-#ifdef ENABLE_MEEN_SAVE
-		auto saveLaunchPolicy = m->opt_.SaveAsync() ? std::launch::async : std::launch::deferred;
-		std::future<std::string> onSave;
-#endif // ENABLE_MEEN_SAVE
-		int ticks = 0;
-		auto serviceInterrupts = [&]
-		{
-			bool quit = false;
-			auto isr = m->ioController_->GenerateInterrupt(currTime.count(), totalTicks, m->memoryController_.get());
+				if constexpr (Throttled == true)
+				{
+					// The throttled clock only advances the machine time when it syncs with the host, poll at the first
+					// instruction boundary that sees the time the controller asked for so delivery does not depend on the host
+					if (time > static_cast<uint64_t>(currTime.count()))
+					{
+						at = static_cast<int64_t>(std::min<uint64_t>(time, never));
+						return never;
+					}
+				}
+
+				auto ns = static_cast<double>(time) - static_cast<double>(currTime.count());
+				// A controller that only needs polling when it wakes the machine can return the maximum time, keep the cycle count in range
+				auto cycles = std::min(ns * m->clock_->GetSpeed() / 1000000000.0, static_cast<double>(std::numeric_limits<int64_t>::max() / 2));
+				return ns > 0 ? totalTicks + static_cast<int64_t>(cycles) : totalTicks;
+			};
 
-			switch (isr)
+			// Deliver the posted and scheduled interrupts that are due then poll the io controller if it is time to do so
+			auto serviceEvents = [&]
 			{
-				case ISR::Zero:
-				case ISR::One:
-				case ISR::Two:
-				case ISR::Three:
-				case ISR::Four:
-				case ISR::Five:
-				case ISR::Six:
-				case ISR::Seven:
+				bool quit = false;
+				auto mail = m->mailbox_.exchange(0, std::memory_order_acquire);
+				syncTime();
+
+				// Hold the run loop at this instruction boundary until the machine is resumed
+				if ((mail & m->pause_) != 0)
 				{
-					ticks = m->cpu_->Interrupt(isr);
-					currTime = m->clock_->Tick(ticks);
-					totalTicks += ticks;
-					break;
+					mail &= ~m->pause_;
+					quit = m->WaitWhilePaused();
+					// service what was posted while paused, a posted quit is handled before anything else executes
+					mail |= m->mailbox_.exchange(0, std::memory_order_acquire) & ~m->pause_;
 				}
-				case ISR::Load:
+
+				// A controller has work to report, drop the poll times they asked for and go back to polling them at their isrFreq rate
+				if ((mail & m->wake_) != 0)
 				{
-					// If a user defined callback is set and we are not processing a load or save request
-					if (m->onLoad_ != nullptr
-#ifndef PICO_BOARD
-						&& onLoad.valid() == false
-#endif // PICO_BOARD
-#ifdef ENABLE_MEEN_SAVE
-						&& onSave.valid() == false
-#endif // ENABLE_MEEN_SAVE
-					)
+					mail &= ~m->wake_;
+					ioPoll = std::min(ioPoll, ioRate);
+					ioPollTime = never;
+					pollTime = never;
+
+					if constexpr (Polled == true)
 					{
-#ifndef PICO_BOARD
-						onLoad = std::async(loadLaunchPolicy, [m]
+						for (auto& device : ioDevices)
 						{
-#endif // PICO_BOARD
-							int len = m->opt_.MaxLoadStateLength();
-							std::string str(len, '\0');
+							device.poll = std::min(device.poll, device.rate);
+							device.pollTime = never;
+						}
+					}
 
-							auto e = m->onLoad_(str.data(), &len, m->ioController_.get());
+					scheduler->SetPoll(0);
+				}
+
+				// Drain the posted commands in the order they were posted
+				if ((mail & m->command_) != 0)
+				{
+					mail &= ~m->command_;
+					Command command{};
 
-							if(e)
+					while (quit == false && m->commands_.Pop(command) == true)
+					{
+						switch (command.type)
+						{
+							case Command::Type::Interrupt:
+							{
+								quit = serviceIsr(command.isr);
+								break;
+							}
+							case Command::Type::Save:
 							{
-								str.clear();
-								m->HandleError(e, std::source_location::current());
+								quit = serviceIsr(ISR::Save);
+								break;
+							}
+							case Command::Type::Load:
+							{
+								quit = serviceIsr(ISR::Load);
+								break;
 							}
+							case Command::Type::ClockSamplingFreq:
+							{
+								// the cycles run so far are timed at the old sampling frequency
+								syncTime();
+								auto err = m->clock_->SetSamplingFrequency(command.clockSamplingFreq);
 
-							str.resize(len);
+								if (err)
+								{
+									m->HandleError(err, std::source_location::current());
+								}
+								break;
+							}
+							case Command::Type::Pause:
+							{
 #ifndef PICO_BOARD
-							return str;
-						});
+								{
+									std::scoped_lock lock(m->pauseMutex_);
+									m->paused_ = true;
+								}
 
-						loadMachineState(checkHandler(onLoad));
-#else
-						loadMachineState(std::move(str));
+								quit = m->WaitWhilePaused();
 #endif // PICO_BOARD
+								break;
+							}
+							case Command::Type::Quit:
+							{
+								quit = serviceIsr(ISR::Quit);
+								break;
+							}
+						}
+					}
+
+					// We are quitting, leave the remaining commands for the next run
+					if (quit == true)
+					{
+						m->mailbox_.fetch_or(m->command_, std::memory_order_release);
 					}
-					break;
 				}
-				case ISR::Save:
+
+				while (mail != 0 && quit == false)
 				{
-#ifdef ENABLE_MEEN_SAVE
-					// If a user defined callback is set and we are not processing a save or load request
-					if (m->onSaveBegin_ != nullptr && onSave.valid() == false && onLoad.valid() == false)
-					{
-						auto memUuid = m->memoryController_->Uuid();
-						auto memUuidTxt = Utils::BinToTxt(m->opt_.Encoder(), "none", memUuid.data(), memUuid.size());
+					auto bit = std::countr_zero(mail);
+					mail &= mail - 1;
+					quit = serviceIsr(bit < 8 ? static_cast<ISR>(bit) : static_cast<ISR>(static_cast<int>(ISR::Save) + bit - 8));
+				}
 
-						if (memUuidTxt)
-						{
-							auto rm = [memoryController = m->memoryController_.get()](const std::map<uint16_t, uint16_t>& metadata)
-							{
-								std::vector<uint8_t> mem;
+				// We are quitting, leave the remaining interrupts for the next run
+				if (mail != 0)
+				{
+					m->mailbox_.fetch_or(mail, std::memory_order_release);
+				}
 
-								for (const auto& m : metadata)
-								{
-									for (auto addr = m.first; addr < m.first + m.second; addr++)
-									{
-										mem.push_back(memoryController->Read(addr, nullptr));
-									}
-								}
+				for (auto isr = scheduler->Pop(); isr != ISR::NoInterrupt && quit == false; isr = scheduler->Pop())
+				{
+					quit = serviceIsr(isr);
+				}
 
-								return mem;
-							};
+				if (quit == false && (totalTicks >= scheduler->Poll() || currTime.count() >= pollTime || ticks == 0))
+				{
+					if (totalTicks >= ioPoll || currTime.count() >= ioPollTime || ticks == 0)
+					{
+						quit = serviceInterrupts();
+						ioPoll = nextPoll(m->ioController_.get(), ticksPerIsr, ioRate, ioPollTime);
+					}
+					else if (idle == true && totalTicks >= ioRate)
+					{
+						// The io controller does not need polling yet, keep calling the idle processing at the isrFreq rate
+						quit = serviceIsr(ISR::NoInterrupt);
+						ioRate = totalTicks + ticksPerIsr;
+					}
 
-							auto rom = rm(m->romMetadata_);
-							auto romMd5 = Utils::Md5(rom.data(), rom.size());
-							auto romMd5Txt = Utils::BinToTxt(m->opt_.Encoder(), "none", romMd5.data(), romMd5.size());
+					auto poll = idle == true ? std::min(ioPoll, ioRate) : ioPoll;
+					pollTime = ioPollTime;
 
-							if (romMd5Txt)
+					if constexpr (Polled == true)
+					{
+						for (auto& device : ioDevices)
+						{
+							if (quit == false && (totalTicks >= device.poll || currTime.count() >= device.pollTime || ticks == 0))
 							{
-								auto ram = rm(m->ramMetadata_);
-								auto ramTxt = Utils::BinToTxt(m->opt_.Encoder(), m->opt_.Compressor(), ram.data(), ram.size());
+								auto isr = device.controller->GenerateInterrupt(currTime.count(), totalTicks, m->memoryController_.get());
 
-								if (ramTxt)
+								// A device has no pending work to do when it has no interrupt, only the default io controller triggers the idle processing
+								if (isr != ISR::NoInterrupt)
 								{
-									auto cpuStateTxt = m->cpu_->Save();
+									quit = serviceIsr(isr);
+								}
 
-									if (cpuStateTxt)
-									{
-										auto ramSize = ram.size();
-										auto str = std::vformat(R"({{"cpu":{},"memory":{{"uuid":"{}://{}","rom":{{"bytes":"{}://md5://{}"}},"ram":{{"size":{},"bytes":"{}://{}://{}"}}}}}})",
-																std::make_format_args(cpuStateTxt.value(), m->opt_.Encoder(), memUuidTxt.value(), m->opt_.Encoder(), romMd5Txt.value(),
-																ramSize, m->opt_.Encoder(), m->opt_.Compressor(), ramTxt.value()));
+								device.poll = nextPoll(device.controller, device.ticksPerIsr, device.rate, device.pollTime);
+							}
 
-										onSave = std::async(saveLaunchPolicy, [m, state = std::move(str)]
-										{
-											int len = 255;
-											std::string uri(len + 1, '\0');
+							poll = std::min(poll, device.poll);
+							pollTime = std::min(pollTime, device.pollTime);
+						}
+					}
 
-											auto e = m->onSaveBegin_(uri.data(), &len, m->ioController_.get());
+					scheduler->SetPoll(poll);
+				}
 
-											if (!e)
-											{
-												uri.resize(len);
+				return quit;
+			};
 
-												if (uri.starts_with("file://"))
-												{
-													uri.erase(uri.begin(), uri.begin() + strlen("file://"));
-													std::filesystem::path path(std::move(uri));
-													auto fileName = path.filename();
-													path.remove_filename();
+			// Deliver the highest priority pending interrupt when the cpu will accept it
+			auto deliverInterrupt = [&]
+			{
+				if (m->interruptController_.Requested() == true && m->cpu_->InterruptsEnabled() == true)
+				{
+					// The mask may be changed by another thread since the request was checked
+					auto isr = m->interruptController_.Acknowledge();
 
-													std::error_code ec;
-													std::filesystem::create_directories(path, ec);
+					if (isr != ISR::NoInterrupt)
+					{
+						ticks = m->cpu_->Interrupt(isr);
+						tick(ticks);
+						totalTicks += ticks;
+					}
+				}
+			};
 
-													if (!ec)
-													{
-														std::ofstream fout(path / fileName, std::ios::trunc);
+			auto err = errc::no_error;
+			auto quit = false;
 
-														if (!fout.good())
-														{
-															e = meen::errc::invalid_argument;
-														}
-														else
-														{
-															fout.write(state.data(), state.size());
-
-															if (fout.good())
-															{
-																if (m->onSave_)
-																{
-																	// We wrote successfully, set nullptr location and json to indicate there is nothing to write.
-																	m->onSave_(nullptr, nullptr, m->ioController_.get());
-																}
-															}
-															else
-															{
-																e = meen::errc::incompatible_ram;
-															}
-														}
-													}
-													else
-													{
-														e = meen::errc::invalid_argument;
-													}
+			if (resume == false)
+			{
+				if (m->onInit_ != nullptr)
+				{
+					std::call_once(m->initOnceFlag_, [&err, m]
+					{
+						err = m->onInit_(m->ioController_.get());
+					});
+				}
 
-													if (e)
-													{
-														// We failed to write, give the completion handler a chance to write it correctly.
-														if (m->onSave_)
-														{
-															e = m->onSave_((std::string("file://") + "/" + path.string() + "/" + fileName.string()).c_str(), state.c_str(), m->ioController_.get());
-														}
+				if (err == errc::no_error)
+				{
+					m->cpu_->Reset();
+					m->clock_->Reset();
+					m->interruptController_.Reset();
 
-														if (e)
-														{
-															m->HandleError(e, std::source_location::current());
-														}
-													}
-												}
-												else
-												{
-													e = meen::errc::uri_scheme;
+					if (m->opt_.ISRFreq() > 0)
+					{
+						ticksPerIsr = m->clock_->GetSpeed() / m->opt_.ISRFreq();
+					}
 
-													// We don't understand the protocol, pass it along to the completion handler to handle.
-													if (m->onSave_)
-													{
-														e = m->onSave_(uri.c_str(), state.c_str(), m->ioController_.get());
-													}
+					scheduler->Start(&totalTicks);
+					m->ioController_->SetScheduler(scheduler);
+					m->memoryController_->SetScheduler(scheduler);
 
-													if (e)
-													{
-														m->HandleError(e, std::source_location::current());
-													}
-												}
-											}
-											else
-											{
-												m->HandleError(e, std::source_location::current());
-											}
+					for (const auto& device : m->ioPortMap_.Devices())
+					{
+						ioDevices.push_back(Machine::RunState::IoDevice{ device.controller.get(), device.isrFreq > 0 ? static_cast<int64_t>(m->clock_->GetSpeed() / device.isrFreq) : 0, 0, 0, never });
+						device.controller->SetScheduler(scheduler);
+					}
 
-											return std::string("");
-										});
+					quit = serviceInterrupts();
+					deliverInterrupt();
+				}
+			}
 
-										checkHandler(onSave);
-									}
-									else
-									{
-										m->HandleError(cpuStateTxt.error(), std::source_location::current());
-									}
-								}
-								else
-								{
-									m->HandleError(ramTxt.error(), std::source_location::current());
-								}
-							}
-							else
-							{
-								m->HandleError(romMd5Txt.error(), std::source_location::current());
-							}
-						}
-						else
-						{
-							m->HandleError(memUuidTxt.error(), std::source_location::current());
-						}
-					}
-#endif // ENABLE_MEEN_SAVE
-					break;
+			if (err == errc::no_error)
+			{
+				// A bounded run stops at the cycle count the last one was due to stop at plus its budget, the cycles an instruction overran by are taken from the next run
+				auto end = cycles < never - state.end ? state.end + cycles : never;
+
+				if (end < never)
+				{
+					state.end = end;
 				}
-				case ISR::Quit:
+
+				while (quit == false && totalTicks < end)
 				{
-					// Wait for any outstanding load/save requests to complete
-#ifndef PICO_BOARD
-					if (onLoad.valid() == true)
-					{
-						// we are quitting, wait for the onLoad handler to complete
-						loadMachineState(onLoad.get());
-					}
-#endif // PICO_BOARD
-#ifdef ENABLE_MEEN_SAVE
-					if (onSave.valid() == true)
+					//Execute the next instruction
+					ticks = m->cpu_->Execute();
+
+					// The cpu is halted, when an interrupt is scheduled or the run is bounded let the clock run up to it (or the next poll if that comes first)
+					if (ticks == 0 && (scheduler->Next() < never || end < never))
 					{
-						// we are quitting, wait for the onSave handler to complete
-						onSave.get();
+						ticks = static_cast<int>(std::clamp<int64_t>(std::min(scheduler->Poll() > totalTicks ? scheduler->Deadline() : scheduler->Next(), end) - totalTicks, 0, std::numeric_limits<int>::max()));
 					}
-#endif // ENABLE_MEEN_SAVE
-					quit = true;
 
-					if (m->opt_.RunAsync() == true)
+					tick(ticks);
+					totalTicks += ticks;
+
+					// Check if it is time to deliver scheduled interrupts or poll for them
+					if (totalTicks >= scheduler->Deadline() || ticks == 0 || m->mailbox_.load(std::memory_order_relaxed) != 0 || (Throttled == true && currTime.count() >= pollTime)) // when ticks is 0 the cpu is not executing (it has been halted), poll (should be less aggressive) for interrupts to unhalt the cpu
 					{
-						m->quit_ = true;
+						quit = serviceEvents();
 					}
-					break;
+
+					deliverInterrupt();
 				}
-				case ISR::NoInterrupt:
-				{
-					// no interrupts pending, do any work that is outstanding
 
-					if (m->opt_.RunAsync() == true)
-					{
-						if (m->quit_ == true)
-						{
-							quit = true;
-						}
-					}
-					else
-					{
-						if (m->onIdle_)
-						{
-							quit = m->onIdle_(m->ioController_.get());
-						}
-					}
-#ifndef PICO_BOARD
-					loadMachineState(checkHandler(onLoad));
-#endif // PICO_BOARD
-#ifdef ENABLE_MEEN_SAVE
-					checkHandler(onSave);
-#endif // ENABLE_MEEN_SAVE
-					break;
+				syncTime();
+				m->runTime_ = currTime.count();
+
+				// The budget ran out, leave the controllers bound to the scheduler for the next run to resume with
+				if (quit == false)
+				{
+					return;
 				}
-				default:
+
+				m->ioController_->SetScheduler(nullptr);
+				m->memoryController_->SetScheduler(nullptr);
+
+				for (const auto& device : ioDevices)
 				{
-					//assert(0);
-					break;
+					device.controller->SetScheduler(nullptr);
 				}
+
+				scheduler->Start(nullptr);
 			}
 
-			return quit;
-		};
+			if (watchController != nullptr)
+			{
+				watchController->OnHit(nullptr);
+			}
 
-		auto err = errc::no_error;
+			m->runState_ = nullptr;
+		};
 
-		if (m->onInit_ != nullptr)
-		{
-			std::call_once(m->initOnceFlag_, [&err, m]
-			{
-				err = m->onInit_(m->ioController_.get());
-			});
-		}
+		// Select the run loop once for the whole run, the configuration can not change while the machine is busy
+		auto async = m->async_ == true;
+		auto throttled = m->opt_.ClockSamplingFreq() >= 0;
+		auto handlers = m->onLoad_ != nullptr
+#ifdef ENABLE_MEEN_SAVE
+			|| m->onSaveBegin_ != nullptr
+#endif // ENABLE_MEEN_SAVE
+			;
+		// Io controllers attached to port ranges and armed watchpoints are the only sources polled besides the default io controller
+		auto polled = watchController != nullptr || m->ioPortMap_.Devices().empty() == false;
+		auto config = (async ? 8 : 0) | (throttled ? 4 : 0) | (handlers ? 2 : 0) | (polled ? 1 : 0);
 
-		if (err == errc::no_error)
+		[&]<int... Config>(std::integer_sequence<int, Config...>)
 		{
-			m->cpu_->Reset();
-			m->clock_->Reset();
-
-			if (m->opt_.ISRFreq() > 0)
-			{
-				ticksPerIsr = m->clock_->GetSpeed() / m->opt_.ISRFreq();
-			}
+			((config == Config ? runLoop.template operator()<(Config & 8) != 0, (Config & 4) != 0, (Config & 2) != 0, (Config & 1) != 0>() : void()), ...);
+		}(std::make_integer_sequence<int, 16>{});
+	}
 
-			auto quit = serviceInterrupts();
+	struct Machine::RunGuard
+	{
+		Machine* m;
 
-			while (quit == false)
+		~RunGuard()
+		{
+			// The run threw part way through, its state can not be resumed
+			if (m->running_ == true)
 			{
-				//Execute the next instruction
-				ticks = m->cpu_->Execute();
-				currTime = m->clock_->Tick(ticks);
-				totalTicks += ticks;
-
-				// Check if it is time to service interrupts
-				if (totalTicks - lastTicks >= ticksPerIsr || ticks == 0) // when ticks is 0 the cpu is not executing (it has been halted), poll (should be less aggressive) for interrupts to unhalt the cpu
-				{
-					quit = serviceInterrupts();
-					lastTicks = totalTicks;
-				}
+				m->EndRun();
+				m->running_ = false;
 			}
 		}
+	};
 
-		m->runTime_ = currTime.count();
-	}
-
-	std::expected<uint64_t, std::error_code> Machine::Run()
+	std::error_code Machine::StartRun(bool async)
 	{
+		// A run suspended by RunFor is resumed, only a running machine is busy
 		if (running_ == true)
 		{
-			return std::unexpected(HandleError(errc::busy, std::source_location::current()));
+			return HandleError(errc::busy, std::source_location::current());
 		}
 
 		if (memoryController_ == nullptr)
 		{
-			return std::unexpected(HandleError(errc::memory_controller, std::source_location::current()));
+			return HandleError(errc::memory_controller, std::source_location::current());
 		}
 
 		if (ioController_ == nullptr)
 		{
-			return std::unexpected(HandleError(errc::io_controller, std::source_location::current()));
+			return HandleError(errc::io_controller, std::source_location::current());
 		}
 
 		if(clock_ == nullptr)
 		{
-			return std::unexpected(HandleError(errc::clock_sampling_freq, std::source_location::current()));
+			return HandleError(errc::clock_sampling_freq, std::source_location::current());
 		}
 
 		if(cpu_ == nullptr)
 		{
-			return std::unexpected(HandleError(errc::cpu, std::source_location::current()));
+			return HandleError(errc::cpu, std::source_location::current());
 		}
 
-		auto err = clock_->SetSamplingFrequency(opt_.ClockSamplingFreq());
+		if (runState_ == nullptr)
+		{
+			auto err = clock_->SetSamplingFrequency(opt_.ClockSamplingFreq());
 
-		if (err)
+			if (err)
+			{
+				return HandleError(err, std::source_location::current());
+			}
+
+			runTime_ = 0;
+			cycleFraction_ = 0;
+		}
+
+#ifndef PICO_BOARD
+		// A pause only applies to the run in progress, drop one that was requested while the machine was not running
 		{
-			return std::unexpected(HandleError(err, std::source_location::current()));
+			std::scoped_lock lock(pauseMutex_);
+			paused_ = false;
+			quitPosted_ = false;
 		}
 
-		runTime_ = 0;
+		mailbox_.fetch_and(~pause_, std::memory_order_acq_rel);
+#endif // PICO_BOARD
+		async_ = async;
 		running_ = true;
 		quit_ = false;
+		return std::error_code{};
+	}
+
+	std::expected<bool, std::error_code> Machine::RunFor(uint64_t cycles)
+	{
+		auto err = StartRun(false);
+
+		if (err)
+		{
+			return std::unexpected(err);
+		}
+
+		RunGuard guard{ this };
+		RunMachine(this, static_cast<int64_t>(std::min<uint64_t>(cycles, std::numeric_limits<int64_t>::max())));
+		running_ = false;
+		return runState_ != nullptr;
+	}
+
+	std::expected<bool, std::error_code> Machine::RunFor(std::chrono::nanoseconds duration)
+	{
+		if (duration.count() < 0)
+		{
+			return std::unexpected(HandleError(errc::invalid_argument, std::source_location::current()));
+		}
+
+		// Carry the fraction of a cycle over to the next call so a fixed duration per frame does not drift
+		auto cycles = duration.count() * (clock_ != nullptr ? clock_->GetSpeed() : 0) / 1000000000.0 + (runState_ != nullptr ? cycleFraction_ : 0);
+		auto ret = RunFor(static_cast<uint64_t>(cycles));
+
+		if (ret.has_value() == true)
+		{
+			cycleFraction_ = cycles - std::floor(cycles);
+		}
+
+		return ret;
+	}
+
+	RunAwaitable Machine::RunAwait(Executor&& executor, uint64_t slice)
+	{
+		return RunAwaitable(this, std::move(executor), slice);
+	}
+
+	std::expected<uint64_t, std::error_code> Machine::Run()
+	{
+		auto err = StartRun(opt_.RunAsync());
+
+		if (err)
+		{
+			return std::unexpected(err);
+		}
 
 		auto waitForCompletion = [this]
 		{
@@ -1202,17 +2171,47 @@ namespace meen
 			return std::error_code{};
 		};
 
+#ifndef PICO_BOARD
+		{
+			std::scoped_lock lock(idleMutex_);
+			idleEvent_ = false;
+		}
+#endif // PICO_BOARD
+
 		auto idleLoop = [this, ioc = ioController_.get()]
 		{
 			if (onIdle_)
 			{
+#ifndef PICO_BOARD
+				auto idlePeriod = std::chrono::milliseconds(opt_.IdlePeriod());
+#endif // PICO_BOARD
+
 				while (quit_ == false)
 				{
 					if (onIdle_(ioc) == true)
 					{
 						// atomic_bool shared with RunMachine thread
 						quit_ = true;
+#ifndef PICO_BOARD
+						// stop waiting if the machine is paused, take the lock so the wakeup can not be missed
+						{
+							std::scoped_lock lock(pauseMutex_);
+						}
+
+						pauseCv_.notify_all();
+#endif // PICO_BOARD
+						// don't let the io controller next poll time hold up the quit
+						mailbox_.fetch_or(wake_, std::memory_order_release);
+					}
+#ifndef PICO_BOARD
+					else if (idlePeriod.count() > 0)
+					{
+						// Sleep until the idle period elapses or the run loop has something to report
+						std::unique_lock lock(idleMutex_);
+						idleCv_.wait_for(lock, idlePeriod, [this] { return idleEvent_ == true || quit_ == true; });
+						idleEvent_ = false;
 					}
+#endif // PICO_BOARD
 				}
 			}
 		};
@@ -1223,7 +2222,7 @@ namespace meen
 			auto runMachineAsync = []
 			{
 				auto m = std::bit_cast<Machine*>(multicore_fifo_pop_blocking());
-				RunMachine(m);
+				RunMachine(m, std::numeric_limits<int64_t>::max());
 				multicore_fifo_push_blocking(0xFFFFFFFF);
 			};
 
@@ -1243,24 +2242,38 @@ namespace meen
 		}
 		else
 		{
-			RunMachine(this);
+			RunGuard guard{ this };
+			RunMachine(this, std::numeric_limits<int64_t>::max());
 			running_ = false;
 		}
 #else
-		auto launchPolicy = opt_.RunAsync() ? std::launch::async : std::launch::deferred;
-
-		fut_ = std::async(launchPolicy, [this]
-		{
-			RunMachine(this);
-		});
-
-		if (launchPolicy == std::launch::deferred)
+		if (opt_.RunAsync() == false)
 		{
-			fut_.get();
+			RunGuard guard{ this };
+			RunMachine(this, std::numeric_limits<int64_t>::max());
 			running_ = false;
 		}
 		else
 		{
+			std::promise<void> runDone;
+			fut_ = runDone.get_future();
+
+			{
+				std::scoped_lock lock(workerMutex_);
+				runDone_ = std::move(runDone);
+				runRequested_ = true;
+			}
+
+			// Hand the run to the worker, a wakeup instead of a thread creation per run
+			if (worker_.joinable() == false)
+			{
+				worker_ = std::thread(&Machine::Worker, this);
+			}
+			else
+			{
+				workerCv_.notify_one();
+			}
+
 			// Run an idle loop if an onIdle handler has been registered.
 			idleLoop();
 			// Wait for the machine to finish
@@ -1277,7 +2290,7 @@ namespace meen
 
 	std::error_code Machine::AttachMemoryController (IControllerPtr&& controller)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1289,13 +2302,16 @@ namespace meen
 
 		cpu_->SetMemoryController(controller.get());
 		memoryController_ = std::move(controller);
+#ifdef ENABLE_MEEN_SAVE
+		savedMemoryValid_ = false;
+#endif // ENABLE_MEEN_SAVE
 		// controller = nullptr;
 		return std::error_code{};
 	}
 
 	std::expected<IControllerPtr, std::error_code> Machine::DetachMemoryController()
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return std::unexpected(HandleError(errc::busy, std::source_location::current()));
 		}
@@ -1308,12 +2324,15 @@ namespace meen
 		cpu_->SetMemoryController(nullptr);
 		auto controller = std::move(memoryController_);
 		memoryController_ = nullptr;
+#ifdef ENABLE_MEEN_SAVE
+		savedMemoryValid_ = false;
+#endif // ENABLE_MEEN_SAVE
 		return controller;
 	}
 
 	std::error_code Machine::AttachIoController (IControllerPtr&& controller)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1331,7 +2350,7 @@ namespace meen
 
 	std::expected<IControllerPtr, std::error_code> Machine::DetachIoController()
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return std::unexpected(HandleError(errc::busy, std::source_location::current()));
 		}
@@ -1347,10 +2366,43 @@ namespace meen
 		return controller;
 	}
 
+	std::error_code Machine::AttachIoController(IControllerPtr&& controller, uint8_t firstPort, uint8_t lastPort, double isrFreq)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		if (controller == nullptr || firstPort > lastPort || isrFreq < 0 || ioPortMap_.Overlaps(firstPort, lastPort) == true)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		ioPortMap_.Attach(std::move(controller), firstPort, lastPort, isrFreq);
+		return std::error_code{};
+	}
+
+	std::expected<IControllerPtr, std::error_code> Machine::DetachIoController(uint8_t port)
+	{
+		if (Busy() == true)
+		{
+			return std::unexpected(HandleError(errc::busy, std::source_location::current()));
+		}
+
+		auto controller = ioPortMap_.Detach(port);
+
+		if (controller == nullptr)
+		{
+			return std::unexpected(HandleError(errc::io_controller, std::source_location::current()));
+		}
+
+		return controller;
+	}
+
 	std::error_code Machine::OnSave(std::function<errc(char* uri, int* uriLen, IController* ioController)>&& onSaveBegin, std::function<errc(const char* location, const char* json, IController* ioController)>&& onSave)
 	{
 #ifdef ENABLE_MEEN_SAVE
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1365,7 +2417,7 @@ namespace meen
 
 	std::error_code Machine::OnLoad(std::function<errc(char* json, int* jsonLen, IController* ioController)>&& onLoad, std::function<errc(IController* ioController)>&& onLoadComplete)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1377,7 +2429,7 @@ namespace meen
 
 	std::error_code Machine::OnIdle(std::function<bool(IController* ioController)>&& onIdle)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1388,7 +2440,7 @@ namespace meen
 
 	std::error_code Machine::OnInit(std::function<errc(IController* ioController)>&& onInit)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1399,7 +2451,7 @@ namespace meen
 
 	std::error_code Machine::OnError(std::function<void(std::error_code ec, const char* fileName, const char* functionName, uint32_t line, uint32_t column, IController* ioController)>&& onError)
 	{
-		if (running_ == true)
+		if (Busy() == true)
 		{
 			return HandleError(errc::busy, std::source_location::current());
 		}
@@ -1408,6 +2460,298 @@ namespace meen
 		return std::error_code{};
 	}
 
+	std::error_code Machine::MemoryProfile(std::function<void(uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)>&& visitor)
+	{
+		if (visitor == nullptr)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		if (profileController_ != nullptr)
+		{
+			profileController_->Visit(visitor);
+		}
+
+		return std::error_code{};
+	}
+
+	std::error_code Machine::PostInterrupt(ISR isr)
+	{
+		uint32_t bit = 0;
+
+		if (isr >= ISR::Zero && isr <= ISR::Seven)
+		{
+			bit = static_cast<uint32_t>(isr);
+		}
+		else if (isr >= ISR::Save && isr <= ISR::Quit)
+		{
+			bit = 8 + static_cast<uint32_t>(isr) - static_cast<uint32_t>(ISR::Save);
+		}
+		else
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		mailbox_.fetch_or(1u << bit, std::memory_order_release);
+
+		if (isr == ISR::Quit)
+		{
+			StopPauseWait();
+		}
+
+		return std::error_code{};
+	}
+
+	std::error_code Machine::Pause()
+	{
+#ifdef PICO_BOARD
+		return HandleError(errc::not_implemented, std::source_location::current());
+#else
+		{
+			std::scoped_lock lock(pauseMutex_);
+			paused_ = true;
+		}
+
+		mailbox_.fetch_or(pause_, std::memory_order_release);
+		return std::error_code{};
+#endif // PICO_BOARD
+	}
+
+	std::error_code Machine::Resume()
+	{
+#ifdef PICO_BOARD
+		return HandleError(errc::not_implemented, std::source_location::current());
+#else
+		{
+			std::scoped_lock lock(pauseMutex_);
+			paused_ = false;
+		}
+
+		pauseCv_.notify_all();
+		return std::error_code{};
+#endif // PICO_BOARD
+	}
+
+	std::error_code Machine::PostCommand(const Command& command)
+	{
+		switch (command.type)
+		{
+			case Command::Type::Interrupt:
+			{
+				if ((command.isr >= ISR::Zero && command.isr <= ISR::Seven) == false && (command.isr >= ISR::Save && command.isr <= ISR::Quit) == false)
+				{
+					return HandleError(errc::invalid_argument, std::source_location::current());
+				}
+				break;
+			}
+			case Command::Type::Pause:
+			{
+#ifdef PICO_BOARD
+				return HandleError(errc::not_implemented, std::source_location::current());
+#endif // PICO_BOARD
+				break;
+			}
+			case Command::Type::Save:
+			case Command::Type::Load:
+			case Command::Type::ClockSamplingFreq:
+			case Command::Type::Quit:
+			{
+				break;
+			}
+			default:
+			{
+				return HandleError(errc::invalid_argument, std::source_location::current());
+			}
+		}
+
+		if (commands_.Push(command) == false)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		mailbox_.fetch_or(command_, std::memory_order_release);
+
+		if (command.type == Command::Type::Quit || (command.type == Command::Type::Interrupt && command.isr == ISR::Quit))
+		{
+			StopPauseWait();
+		}
+
+		return std::error_code{};
+	}
+
+	bool Machine::WaitWhilePaused()
+	{
+		bool quit = false;
+#ifndef PICO_BOARD
+		std::unique_lock lock(pauseMutex_);
+		auto stopWaiting = [this] { return paused_ == false || quit_ == true || quitPosted_ == true; };
+
+		if (stopWaiting() == false)
+		{
+			auto start = steady_clock::now();
+
+			// A synchronous run has no idle loop of its own, keep calling the idle handler so that it can resume or quit the machine
+			if (async_ == false && onIdle_ != nullptr)
+			{
+				auto idlePeriod = std::chrono::milliseconds(opt_.IdlePeriod());
+
+				while (quit == false && stopWaiting() == false)
+				{
+					lock.unlock();
+					quit = onIdle_(ioController_.get());
+					lock.lock();
+
+					if (quit == false)
+					{
+						pauseCv_.wait_for(lock, idlePeriod, stopWaiting);
+					}
+				}
+			}
+			else
+			{
+				pauseCv_.wait(lock, stopWaiting);
+			}
+
+			// the machine time carries on from where it paused
+			clock_->Skip(steady_clock::now() - start);
+		}
+
+		quit = quit || quit_ == true;
+#endif // PICO_BOARD
+		return quit;
+	}
+
+	void Machine::StopPauseWait()
+	{
+#ifndef PICO_BOARD
+		{
+			std::scoped_lock lock(pauseMutex_);
+			quitPosted_ = true;
+		}
+
+		pauseCv_.notify_all();
+#endif // PICO_BOARD
+	}
+
+	std::error_code Machine::SetInterruptMask(uint8_t mask)
+	{
+		interruptController_.SetMask(mask);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::SetInterruptPriority(ISR highest)
+	{
+		if (highest < ISR::Zero || highest > ISR::Seven)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		interruptController_.SetPriority(highest);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::MapIoPort(uint8_t port, uint8_t* latch)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		ioPortMap_.Map(port, latch);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::MapIoPort(uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		if (read == nullptr && write == nullptr)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		ioPortMap_.Map(port, std::move(read), std::move(write));
+		return std::error_code{};
+	}
+
+	std::error_code Machine::UnmapIoPort(uint8_t port)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		ioPortMap_.Unmap(port);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::ArmWatchpoint(uint16_t address, Watch watch)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		if (watch != Watch::Read && watch != Watch::Write && watch != Watch::Exec)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		if (watchController_ == nullptr)
+		{
+			watchController_ = std::make_unique<WatchController>();
+		}
+
+		watchController_->Arm(address, watch);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::DisarmWatchpoint(uint16_t address, Watch watch)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		if (watch != Watch::Read && watch != Watch::Write && watch != Watch::Exec)
+		{
+			return HandleError(errc::invalid_argument, std::source_location::current());
+		}
+
+		if (watchController_ != nullptr)
+		{
+			watchController_->Disarm(address, watch);
+		}
+
+		return std::error_code{};
+	}
+
+	std::error_code Machine::OnWatch(std::function<bool(uint16_t address, Watch watch, IController* ioController)>&& onWatch)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		onWatch_ = std::move(onWatch);
+		return std::error_code{};
+	}
+
+	std::error_code Machine::OnTrap(uint16_t address, std::function<int(Registers& registers, IController* memoryController)>&& onTrap)
+	{
+		if (Busy() == true)
+		{
+			return HandleError(errc::busy, std::source_location::current());
+		}
+
+		trapAddress_ = address;
+		onTrap_ = std::move(onTrap);
+		return std::error_code{};
+	}
+
 	ControllerDeleter::ControllerDeleter(bool del)
 	{
 		delete_ = del;
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "meen/machine/MemoryRegions.h"
+
+namespace meen
+{
+	namespace
+	{
+		void MarkDirty(IController* memoryController, uint16_t offset, size_t len)
+		{
+			auto dirtyPages = memoryController->DirtyPages();
+
+			if (dirtyPages != nullptr && len > 0)
+			{
+				for (size_t page = offset >> 8; page <= (offset + len - 1) >> 8; page++)
+				{
+					dirtyPages->set(page);
+				}
+			}
+		}
+	} // namespace
+
+	void MemoryRegions::ClearRom()
+	{
+		rom_.clear();
+		romSize_ = 0;
+	}
+
+	void MemoryRegions::AddRom(uint16_t offset, uint16_t size)
+	{
+		auto it = std::lower_bound(rom_.begin(), rom_.end(), offset, [](const Extent& extent, uint16_t offset)
+		{
+			return extent.offset < offset;
+		});
+
+		if (it == rom_.end() || it->offset != offset)
+		{
+			rom_.insert(it, Extent{ offset, size });
+			romSize_ += size;
+		}
+	}
+
+	void MemoryRegions::Build()
+	{
+		int offset = 0;
+		ram_.clear();
+		ramSize_ = 0;
+		romPages_.reset();
+		ramPages_.reset();
+
+		auto addPages = [](std::bitset<256>& pages, int offset, int size)
+		{
+			for (int page = offset >> 8; size > 0 && page <= (offset + size - 1) >> 8; page++)
+			{
+				pages.set(page);
+			}
+		};
+
+		// the ram is the memory between each rom block
+		for (const auto& r : rom_)
+		{
+			if (offset < r.offset)
+			{
+				ram_.push_back(Extent{ static_cast<uint16_t>(offset), static_cast<uint16_t>(r.offset - offset) });
+			}
+
+			addPages(romPages_, r.offset, r.size);
+			offset = r.offset + r.size;
+		}
+
+		// add the last ram block
+		if (offset < 0xFFFF)
+		{
+			ram_.push_back(Extent{ static_cast<uint16_t>(offset), static_cast<uint16_t>(0xFFFF - offset) });
+		}
+
+		for (const auto& r : ram_)
+		{
+			addPages(ramPages_, r.offset, r.size);
+			ramSize_ += r.size;
+		}
+	}
+
+	const std::vector<MemoryRegions::Extent>& MemoryRegions::Rom() const
+	{
+		return rom_;
+	}
+
+	const std::vector<MemoryRegions::Extent>& MemoryRegions::Ram() const
+	{
+		return ram_;
+	}
+
+	size_t MemoryRegions::RomSize() const
+	{
+		return romSize_;
+	}
+
+	size_t MemoryRegions::RamSize() const
+	{
+		return ramSize_;
+	}
+
+	const std::bitset<256>& MemoryRegions::RomPages() const
+	{
+		return romPages_;
+	}
+
+	const std::bitset<256>& MemoryRegions::RamPages() const
+	{
+		return ramPages_;
+	}
+
+	void MemoryRegions::Gather(IController* memoryController, const std::vector<Extent>& extents, uint8_t* dst, IController* ioController)
+	{
+		for (const auto& extent : extents)
+		{
+			Read(memoryController, extent.offset, dst, extent.size, ioController);
+			dst += extent.size;
+		}
+	}
+
+	void MemoryRegions::Scatter(IController* memoryController, const std::vector<Extent>& extents, const uint8_t* src, IController* ioController)
+	{
+		for (const auto& extent : extents)
+		{
+			Write(memoryController, extent.offset, src, extent.size, ioController);
+			src += extent.size;
+		}
+	}
+
+	void MemoryRegions::Read(IController* memoryController, uint16_t offset, uint8_t* dst, size_t len, IController* ioController)
+	{
+		auto memory = memoryController->MemoryView();
+
+		if (len == 0)
+		{
+			return;
+		}
+
+		if (memory.data() != nullptr && offset + len <= memory.size())
+		{
+			memcpy(dst, memory.data() + offset, len);
+		}
+		else
+		{
+			for (size_t i = 0; i < len; i++)
+			{
+				dst[i] = memoryController->Read(offset + i, ioController);
+			}
+		}
+	}
+
+	void MemoryRegions::Write(IController* memoryController, uint16_t offset, const uint8_t* src, size_t len, IController* ioController)
+	{
+		auto memory = memoryController->Memory();
+
+		if (len == 0)
+		{
+			return;
+		}
+
+		if (memory.data() != nullptr && offset + len <= memory.size())
+		{
+			memcpy(memory.data() + offset, src, len);
+			MarkDirty(memoryController, offset, len);
+		}
+		else
+		{
+			for (size_t i = 0; i < len; i++)
+			{
+				memoryController->Write(offset + i, src[i], ioController);
+			}
+		}
+	}
+
+	void MemoryRegions::Fill(IController* memoryController, uint16_t offset, uint8_t value, size_t len, IController* ioController)
+	{
+		auto memory = memoryController->Memory();
+
+		if (len == 0)
+		{
+			return;
+		}
+
+		if (memory.data() != nullptr && offset + len <= memory.size())
+		{
+			memset(memory.data() + offset, value, len);
+			MarkDirty(memoryController, offset, len);
+		}
+		else
+		{
+			for (size_t i = 0; i < len; i++)
+			{
+				memoryController->Write(offset + i, value, ioController);
+			}
+		}
+	}
+} // namespace meen
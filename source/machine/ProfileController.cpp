@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "meen/machine/ProfileController.h"
+
+namespace meen
+{
+	ProfileController::ProfileController(bool perAddress)
+	{
+		shift_ = perAddress == true ? 0 : 8;
+		counters_ = std::make_unique<std::atomic<uint64_t>[]>(((1 << 16) >> shift_) * Counter::Count);
+		fetchController_.profileController_ = this;
+	}
+
+	void ProfileController::SetMemoryController(IController* memoryController)
+	{
+		memoryController_ = memoryController;
+	}
+
+	IController* ProfileController::Fetch()
+	{
+		return &fetchController_;
+	}
+
+	bool ProfileController::PerAddress() const
+	{
+		return shift_ == 0;
+	}
+
+	void ProfileController::Visit(const std::function<void(uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)>& visitor) const
+	{
+		for (int i = 0; i < (1 << 16) >> shift_; i++)
+		{
+			auto reads = counters_[i * Counter::Count + Counter::Reads].load(std::memory_order_relaxed);
+			auto writes = counters_[i * Counter::Count + Counter::Writes].load(std::memory_order_relaxed);
+			auto fetches = counters_[i * Counter::Count + Counter::Fetches].load(std::memory_order_relaxed);
+
+			if (reads != 0 || writes != 0 || fetches != 0)
+			{
+				visitor(i << shift_, reads, writes, fetches);
+			}
+		}
+	}
+
+	std::array<uint8_t, 16> ProfileController::Uuid() const
+	{
+		return memoryController_->Uuid();
+	}
+
+	uint8_t ProfileController::Read(uint16_t address, IController* controller)
+	{
+		Increment(address, Counter::Reads);
+		return memoryController_->Read(address, controller);
+	}
+
+	void ProfileController::Write(uint16_t address, uint8_t value, IController* controller)
+	{
+		Increment(address, Counter::Writes);
+		memoryController_->Write(address, value, controller);
+	}
+
+	ISR ProfileController::GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller)
+	{
+		return memoryController_->GenerateInterrupt(currTime, cycles, controller);
+	}
+
+	DirtyPageMap* ProfileController::DirtyPages()
+	{
+		return memoryController_->DirtyPages();
+	}
+
+	std::span<uint8_t> ProfileController::Memory()
+	{
+		return memoryController_->Memory();
+	}
+
+	std::span<const uint8_t> ProfileController::MemoryView()
+	{
+		return memoryController_->MemoryView();
+	}
+
+	std::array<uint8_t, 16> ProfileController::FetchController::Uuid() const
+	{
+		return profileController_->Uuid();
+	}
+
+	uint8_t ProfileController::FetchController::Read(uint16_t address, IController* controller)
+	{
+		profileController_->Increment(address, Counter::Fetches);
+		return profileController_->memoryController_->Read(address, controller);
+	}
+
+	void ProfileController::FetchController::Write(uint16_t address, uint8_t value, IController* controller)
+	{
+		profileController_->Write(address, value, controller);
+	}
+
+	ISR ProfileController::FetchController::GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller)
+	{
+		return profileController_->GenerateInterrupt(currTime, cycles, controller);
+	}
+
+	DirtyPageMap* ProfileController::FetchController::DirtyPages()
+	{
+		return profileController_->DirtyPages();
+	}
+
+	std::span<uint8_t> ProfileController::FetchController::Memory()
+	{
+		return profileController_->Memory();
+	}
+
+	std::span<const uint8_t> ProfileController::FetchController::MemoryView()
+	{
+		return profileController_->MemoryView();
+	}
+} // namespace meen
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <limits>
+
+#include "meen/IMachine.h"
+#include "meen/RunAwaitable.h"
+#include "meen/utils/ErrorCode.h"
+
+namespace meen
+{
+	RunAwaitable::RunAwaitable(IMachine* machine, Executor&& executor, uint64_t slice)
+		: machine_(machine), executor_(std::move(executor)), slice_(slice)
+	{
+	}
+
+	void RunAwaitable::Slice(std::coroutine_handle<> handle)
+	{
+		auto running = machine_->RunFor(slice_ > 0 ? slice_ : std::numeric_limits<uint64_t>::max());
+
+		if (running.has_value() == true && running.value() == true)
+		{
+			// Hand the executor back to its other tasks before running the next slice
+			executor_([this, handle]
+			{
+				Slice(handle);
+			});
+		}
+		else
+		{
+			err_ = running.has_value() == true ? std::error_code{} : running.error();
+			handle.resume();
+		}
+	}
+
+	bool RunAwaitable::await_suspend(std::coroutine_handle<> handle)
+	{
+		if (machine_ == nullptr || executor_ == nullptr)
+		{
+			err_ = make_error_code(errc::invalid_argument);
+			// resume the awaiting coroutine straight away
+			return false;
+		}
+
+		executor_([this, handle]
+		{
+			Slice(handle);
+		});
+
+		return true;
+	}
+} // namespace meen
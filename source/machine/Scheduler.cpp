@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "meen/machine/Scheduler.h"
+#include "meen/utils/ErrorCode.h"
+
+namespace meen
+{
+	Scheduler::Scheduler(std::atomic<uint32_t>* mailbox, uint32_t wake, std::function<void()>&& onWake)
+		: mailbox_(mailbox), wake_(wake), onWake_(std::move(onWake))
+	{
+	}
+
+	bool Scheduler::Later(const Event& lhs, const Event& rhs)
+	{
+		return lhs.cycle > rhs.cycle || (lhs.cycle == rhs.cycle && lhs.sequence > rhs.sequence);
+	}
+
+	void Scheduler::Update()
+	{
+		deadline_ = std::min(poll_, Next());
+	}
+
+	uint64_t Scheduler::Now() const
+	{
+		return cycles_ != nullptr ? *cycles_ : 0;
+	}
+
+	std::error_code Scheduler::Schedule(uint64_t cycle, ISR isr)
+	{
+		if (isr == ISR::NoInterrupt)
+		{
+			return make_error_code(errc::invalid_argument);
+		}
+
+		events_.push_back(Event{ static_cast<int64_t>(std::min<uint64_t>(cycle, never_ - 1)), sequence_++, isr });
+		std::push_heap(events_.begin(), events_.end(), Later);
+		Update();
+		return std::error_code{};
+	}
+
+	void Scheduler::Cancel(ISR isr)
+	{
+		std::erase_if(events_, [isr](const Event& event) { return event.isr == isr; });
+		std::make_heap(events_.begin(), events_.end(), Later);
+		Update();
+	}
+
+	void Scheduler::Wake()
+	{
+		mailbox_->fetch_or(wake_, std::memory_order_release);
+
+		if (onWake_)
+		{
+			onWake_();
+		}
+	}
+
+	void Scheduler::Start(const int64_t* cycles)
+	{
+		cycles_ = cycles;
+		events_.clear();
+		sequence_ = 0;
+		poll_ = 0;
+		Update();
+	}
+
+	void Scheduler::SetPoll(int64_t cycle)
+	{
+		poll_ = cycle;
+		Update();
+	}
+
+	int64_t Scheduler::Next() const
+	{
+		return events_.empty() == true ? never_ : events_.front().cycle;
+	}
+
+	ISR Scheduler::Pop()
+	{
+		auto isr = ISR::NoInterrupt;
+
+		if (events_.empty() == false && cycles_ != nullptr && events_.front().cycle <= *cycles_)
+		{
+			std::pop_heap(events_.begin(), events_.end(), Later);
+			isr = events_.back().isr;
+			events_.pop_back();
+			Update();
+		}
+
+		return isr;
+	}
+} // namespace meen
@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "meen/machine/WatchController.h"
+
+namespace meen
+{
+	WatchController::WatchController()
+	{
+		fetchController_.watchController_ = this;
+	}
+
+	void WatchController::SetMemoryController(IController* memoryController, IController* fetchMemoryController)
+	{
+		memoryController_ = memoryController;
+		fetchMemoryController_ = fetchMemoryController;
+	}
+
+	IController* WatchController::Fetch()
+	{
+		return &fetchController_;
+	}
+
+	void WatchController::Arm(uint16_t address, Watch watch)
+	{
+		auto type = static_cast<int>(watch);
+		addresses_[type][address] = true;
+		pages_[address >> 8] |= 1 << type;
+	}
+
+	void WatchController::Disarm(uint16_t address, Watch watch)
+	{
+		auto type = static_cast<int>(watch);
+		addresses_[type][address] = false;
+
+		auto page = address & 0xFF00;
+
+		// only clear the page flag when no other addresses in this page are armed
+		for (int addr = page; addr < page + 0x100; addr++)
+		{
+			if (addresses_[type][addr] == true)
+			{
+				return;
+			}
+		}
+
+		pages_[address >> 8] &= ~(1 << type);
+	}
+
+	bool WatchController::Armed(Watch watch) const
+	{
+		return addresses_[static_cast<int>(watch)].any();
+	}
+
+	void WatchController::OnHit(std::function<void()>&& onHit)
+	{
+		onHit_ = std::move(onHit);
+	}
+
+	const std::vector<std::pair<uint16_t, Watch>>& WatchController::Hits() const
+	{
+		return hits_;
+	}
+
+	void WatchController::ClearHits()
+	{
+		hits_.clear();
+	}
+
+	void WatchController::Hit(uint16_t address, Watch watch)
+	{
+		hits_.emplace_back(address, watch);
+
+		if (onHit_)
+		{
+			onHit_();
+		}
+	}
+
+	std::array<uint8_t, 16> WatchController::Uuid() const
+	{
+		return memoryController_->Uuid();
+	}
+
+	uint8_t WatchController::Read(uint16_t address, IController* controller)
+	{
+		if (pages_[address >> 8] & (1 << static_cast<int>(Watch::Read)) && addresses_[static_cast<int>(Watch::Read)][address] == true)
+		{
+			Hit(address, Watch::Read);
+		}
+
+		return memoryController_->Read(address, controller);
+	}
+
+	void WatchController::Write(uint16_t address, uint8_t value, IController* controller)
+	{
+		if (pages_[address >> 8] & (1 << static_cast<int>(Watch::Write)) && addresses_[static_cast<int>(Watch::Write)][address] == true)
+		{
+			Hit(address, Watch::Write);
+		}
+
+		memoryController_->Write(address, value, controller);
+	}
+
+	ISR WatchController::GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller)
+	{
+		return memoryController_->GenerateInterrupt(currTime, cycles, controller);
+	}
+
+	DirtyPageMap* WatchController::DirtyPages()
+	{
+		return memoryController_->DirtyPages();
+	}
+
+	std::span<uint8_t> WatchController::Memory()
+	{
+		return memoryController_->Memory();
+	}
+
+	std::span<const uint8_t> WatchController::MemoryView()
+	{
+		return memoryController_->MemoryView();
+	}
+
+	std::array<uint8_t, 16> WatchController::FetchController::Uuid() const
+	{
+		return watchController_->Uuid();
+	}
+
+	uint8_t WatchController::FetchController::Read(uint16_t address, IController* controller)
+	{
+		if (watchController_->pages_[address >> 8] & (1 << static_cast<int>(Watch::Exec)) && watchController_->addresses_[static_cast<int>(Watch::Exec)][address] == true)
+		{
+			watchController_->Hit(address, Watch::Exec);
+		}
+
+		return watchController_->fetchMemoryController_->Read(address, controller);
+	}
+
+	void WatchController::FetchController::Write(uint16_t address, uint8_t value, IController* controller)
+	{
+		watchController_->memoryController_->Write(address, value, controller);
+	}
+
+	ISR WatchController::FetchController::GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller)
+	{
+		return watchController_->memoryController_->GenerateInterrupt(currTime, cycles, controller);
+	}
+
+	DirtyPageMap* WatchController::FetchController::DirtyPages()
+	{
+		return watchController_->memoryController_->DirtyPages();
+	}
+
+	std::span<uint8_t> WatchController::FetchController::Memory()
+	{
+		return watchController_->memoryController_->Memory();
+	}
+
+	std::span<const uint8_t> WatchController::FetchController::MemoryView()
+	{
+		return watchController_->memoryController_->MemoryView();
+	}
+} // namespace meen
@@ -50,4 +50,14 @@ namespace meen
             Uuid                /* Name of function in C++ (must match Python name) */
         );
     }
+
+    void ControllerPy::SetScheduler(IScheduler* scheduler)
+    {
+        PYBIND11_OVERRIDE(
+            void,               /* Return type */
+            IController,        /* Parent class */
+            SetScheduler,       /* Name of function in C++ (must match Python name) */
+            scheduler           /* Argument(s) */
+        );
+    }
 }
\ No newline at end of file
@@ -21,6 +21,7 @@ SOFTWARE.
 */
 
 #include <format>
+#include <pybind11/chrono.h>
 #include <pybind11/functional.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -70,6 +71,39 @@ PYBIND11_MODULE(meen_py, meen)
         .value("Quit", meen::ISR::Quit)
         .value("NoInterrupt", meen::ISR::NoInterrupt);
 
+    py::enum_<meen::Watch>(meen, "Watch")
+        .value("Read", meen::Watch::Read)
+        .value("Write", meen::Watch::Write)
+        .value("Exec", meen::Watch::Exec);
+
+    py::class_<meen::Registers>(meen, "Registers")
+        .def_readwrite("pc", &meen::Registers::pc)
+        .def_readwrite("sp", &meen::Registers::sp)
+        .def_readwrite("a", &meen::Registers::a)
+        .def_readwrite("b", &meen::Registers::b)
+        .def_readwrite("c", &meen::Registers::c)
+        .def_readwrite("d", &meen::Registers::d)
+        .def_readwrite("e", &meen::Registers::e)
+        .def_readwrite("h", &meen::Registers::h)
+        .def_readwrite("l", &meen::Registers::l)
+        .def_readwrite("flags", &meen::Registers::flags);
+
+    py::class_<meen::Command> command(meen, "Command");
+
+    py::enum_<meen::Command::Type>(command, "Type")
+        .value("Interrupt", meen::Command::Type::Interrupt)
+        .value("Save", meen::Command::Type::Save)
+        .value("Load", meen::Command::Type::Load)
+        .value("ClockSamplingFreq", meen::Command::Type::ClockSamplingFreq)
+        .value("Pause", meen::Command::Type::Pause)
+        .value("Quit", meen::Command::Type::Quit);
+
+    command
+        .def(py::init<>())
+        .def_readwrite("type", &meen::Command::type)
+        .def_readwrite("isr", &meen::Command::isr)
+        .def_readwrite("clockSamplingFreq", &meen::Command::clockSamplingFreq);
+
     meen.def("Make8080Machine", &meen::Make8080Machine);
     
     py::class_<meen::IMachine>(meen, "IMachine")
@@ -170,15 +204,132 @@ PYBIND11_MODULE(meen_py, meen)
                 return static_cast<meen::errc>(machine.OnError(nullptr).value());
             }
         })
+        .def("OnWatch", [](meen::IMachine& machine, std::function<bool(uint16_t address, meen::Watch watch, meen::IController* ioController)>&& onWatch)
+        {
+            if (onWatch)
+            {
+                return static_cast<meen::errc>(machine.OnWatch([ow = std::move(onWatch)](uint16_t address, meen::Watch watch, meen::IController* ioController)
+                {
+                    pybind11::gil_scoped_acquire gil{};
+                    return ow(address, watch, ioController);
+                }).value());
+            }
+            else
+            {
+                return static_cast<meen::errc>(machine.OnWatch(nullptr).value());
+            }
+        })
+        // The registers are passed by pointer so that the changes made by the handler are written back to the cpu
+        .def("OnTrap", [](meen::IMachine& machine, uint16_t address, std::function<int(meen::Registers* registers, meen::IController* memoryController)>&& onTrap)
+        {
+            if (onTrap)
+            {
+                return static_cast<meen::errc>(machine.OnTrap(address, [ot = std::move(onTrap)](meen::Registers& registers, meen::IController* memoryController)
+                {
+                    pybind11::gil_scoped_acquire gil{};
+                    return ot(&registers, memoryController);
+                }).value());
+            }
+            else
+            {
+                return static_cast<meen::errc>(machine.OnTrap(address, nullptr).value());
+            }
+        })
+        .def("MemoryProfile", [](meen::IMachine& machine)
+        {
+            std::vector<std::tuple<uint16_t, uint64_t, uint64_t, uint64_t>> profile;
+
+            machine.MemoryProfile([&profile](uint16_t address, uint64_t reads, uint64_t writes, uint64_t fetches)
+            {
+                profile.emplace_back(address, reads, writes, fetches);
+            });
+
+            return profile;
+        })
+        .def("ArmWatchpoint", [](meen::IMachine& machine, uint16_t address, meen::Watch watch)
+        {
+            return static_cast<meen::errc>(machine.ArmWatchpoint(address, watch).value());
+        })
+        .def("DisarmWatchpoint", [](meen::IMachine& machine, uint16_t address, meen::Watch watch)
+        {
+            return static_cast<meen::errc>(machine.DisarmWatchpoint(address, watch).value());
+        })
+        .def("PostInterrupt", [](meen::IMachine& machine, meen::ISR isr)
+        {
+            return static_cast<meen::errc>(machine.PostInterrupt(isr).value());
+        })
+        .def("PostCommand", [](meen::IMachine& machine, const meen::Command& command)
+        {
+            return static_cast<meen::errc>(machine.PostCommand(command).value());
+        })
+        .def("Pause", [](meen::IMachine& machine)
+        {
+            return static_cast<meen::errc>(machine.Pause().value());
+        })
+        .def("Resume", [](meen::IMachine& machine)
+        {
+            return static_cast<meen::errc>(machine.Resume().value());
+        })
+        .def("SetInterruptMask", [](meen::IMachine& machine, uint8_t mask)
+        {
+            return static_cast<meen::errc>(machine.SetInterruptMask(mask).value());
+        })
+        .def("SetInterruptPriority", [](meen::IMachine& machine, meen::ISR highest)
+        {
+            return static_cast<meen::errc>(machine.SetInterruptPriority(highest).value());
+        })
+        .def("MapIoPort", [](meen::IMachine& machine, uint8_t port, std::function<uint8_t(uint8_t port)>&& read, std::function<void(uint8_t port, uint8_t value)>&& write)
+        {
+            std::function<uint8_t(uint8_t port)> r;
+            std::function<void(uint8_t port, uint8_t value)> w;
+
+            if (read)
+            {
+                r = [rd = std::move(read)](uint8_t port)
+                {
+                    pybind11::gil_scoped_acquire gil{};
+                    return rd(port);
+                };
+            }
+
+            if (write)
+            {
+                w = [wr = std::move(write)](uint8_t port, uint8_t value)
+                {
+                    pybind11::gil_scoped_acquire gil{};
+                    wr(port, value);
+                };
+            }
+
+            return static_cast<meen::errc>(machine.MapIoPort(port, std::move(r), std::move(w)).value());
+        })
+        .def("UnmapIoPort", [](meen::IMachine& machine, uint8_t port)
+        {
+            return static_cast<meen::errc>(machine.UnmapIoPort(port).value());
+        })
         .def("Run", [](meen::IMachine& machine)
         {
             pybind11::gil_scoped_release nogil{};
             return machine.Run().value_or(0);
         })
+        .def("RunFor", [](meen::IMachine& machine, uint64_t cycles)
+        {
+            pybind11::gil_scoped_release nogil{};
+            return machine.RunFor(cycles).value_or(false);
+        })
+        .def("RunFor", [](meen::IMachine& machine, std::chrono::nanoseconds duration)
+        {
+            pybind11::gil_scoped_release nogil{};
+            return machine.RunFor(duration).value_or(false);
+        })
         .def("AttachIoController", [](meen::IMachine& machine, meen::IController* controller)
         {
             return static_cast<meen::errc>(machine.AttachIoController(meen::IControllerPtr(controller, meen::ControllerDeleter(false))).value());            
         })
+        .def("AttachIoController", [](meen::IMachine& machine, meen::IController* controller, uint8_t firstPort, uint8_t lastPort, double isrFreq)
+        {
+            return static_cast<meen::errc>(machine.AttachIoController(meen::IControllerPtr(controller, meen::ControllerDeleter(false)), firstPort, lastPort, isrFreq).value());
+        })
         .def("AttachMemoryController", [](meen::IMachine& machine, meen::IController* controller)
         {
             return static_cast<meen::errc>(machine.AttachMemoryController(meen::IControllerPtr(controller, meen::ControllerDeleter(false))).value());
@@ -188,10 +339,20 @@ PYBIND11_MODULE(meen_py, meen)
             return static_cast<meen::errc>(machine.SetOptions(options).value());
         });
 
+    py::class_<meen::IScheduler>(meen, "Scheduler")
+        .def("Now", &meen::IScheduler::Now)
+        .def("Schedule", [](meen::IScheduler& scheduler, uint64_t cycle, meen::ISR isr)
+        {
+            return static_cast<meen::errc>(scheduler.Schedule(cycle, isr).value());
+        })
+        .def("Cancel", &meen::IScheduler::Cancel)
+        .def("Wake", &meen::IScheduler::Wake);
+
     py::class_<meen::IController, meen::ControllerPy>(meen, "Controller")
         .def(py::init<>())
         .def("Read", &meen::IController::Read)
         .def("Write", &meen::IController::Write)
         .def("GenerateInterrupt", &meen::IController::GenerateInterrupt)
-        .def("Uuid", &meen::IController::Uuid);
+        .def("Uuid", &meen::IController::Uuid)
+        .def("SetScheduler", &meen::IController::SetScheduler);
 }
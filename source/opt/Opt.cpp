@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <assert.h>
 #include <fstream>
 
@@ -56,6 +57,7 @@ namespace meen
 	{
 		auto err = ParseJsonSv(Opt::DefaultOpts(), json_);
 		assert(!err);
+		Compile();
 	}
 
 	constexpr std::string_view Opt::DefaultOpts()
@@ -80,7 +82,8 @@ namespace meen
 #else
 								R"(")"
 #endif // ENABLE_MEEN_SAVE
-								R"(,"isrFreq":0,"maxLoadStateLen":512,"runAsync":false})"sv;
+								R"(,"cpuAffinity":[],"idlePeriod":1,"isrFreq":0,"lockMemory":false,"maxLoadStateLen":512,"memoryProfile":"none","runAsync":false)"
+								R"(,"schedPolicy":"other","schedPriority":0})"sv;
 	}
 
 #ifdef ENABLE_NLOHMANN_JSON
@@ -172,110 +175,159 @@ namespace meen
 				}
 			}
 
-#ifndef ENABLE_ZLIB
 			if (!err)
 			{
 #ifdef ENABLE_NLOHMANN_JSON
-				if (json.contains("compressor") == true && json["compressor"].get<std::string_view>() == "zlib")
+				if (json.contains("idlePeriod") == true && json["idlePeriod"].get<int>() < 0)
 #else
-				if (json["compressor"] != nullptr && json["compressor"].as<std::string_view>() == "zlib")
+				if (json["idlePeriod"] != nullptr && json["idlePeriod"].as<int>() < 0)
 #endif // ENABLE_NLOHMANN_JSON
 				{
-					err = make_error_code(errc::compressor);
+					err = make_error_code(errc::json_config);
 				}
 			}
-#endif // ENABLE_ZLIB
-		}
 
-		if (!err)
-		{
+			if (!err)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-			json_.update(json);
+				if (json.contains("memoryProfile") == true)
+				{
+					auto memoryProfile = json["memoryProfile"].get<std::string_view>();
 #else
-			Opt::Merge(json_, json);
+				if (json["memoryProfile"] != nullptr)
+				{
+					auto memoryProfile = json["memoryProfile"].as<std::string_view>();
 #endif // ENABLE_NLOHMANN_JSON
-		}
 
-		return err;
-	}
+					if (memoryProfile != "none" && memoryProfile != "page" && memoryProfile != "address")
+					{
+						err = make_error_code(errc::json_config);
+					}
+				}
+			}
 
-	double Opt::ClockSamplingFreq() const
-	{
+			if (!err)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["clockSamplingFreq"].get<double>();
-#else
-		return json_["clockSamplingFreq"].as<double>();
-#endif // ENABLE_NLOHMANN_JSON
-	}
+				if (json.contains("cpuAffinity") == true)
+				{
+					const auto& cpuAffinity = json["cpuAffinity"];
 
-	double Opt::ISRFreq() const
-	{
-#ifdef ENABLE_NLOHMANN_JSON
-		return json_["isrFreq"].get<double>();
+					if (cpuAffinity.is_array() == false || std::any_of(cpuAffinity.begin(), cpuAffinity.end(), [](const nlohmann::json& cpu) { return cpu.is_number_integer() == false || cpu.get<int>() < 0; }) == true)
 #else
-		return json_["isrFreq"].as<double>();
+				if (json["cpuAffinity"] != nullptr)
+				{
+					auto cpuAffinity = json["cpuAffinity"];
+
+					if (cpuAffinity.is<JsonArrayConst>() == false || std::any_of(cpuAffinity.as<JsonArrayConst>().begin(), cpuAffinity.as<JsonArrayConst>().end(), [](JsonVariantConst cpu) { return cpu.is<int>() == false || cpu.as<int>() < 0; }) == true)
 #endif // ENABLE_NLOHMANN_JSON
-	}
+					{
+						err = make_error_code(errc::json_config);
+					}
+				}
+			}
 
-	bool Opt::RunAsync() const
-	{
+			if (!err)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["runAsync"].get<bool>();
+				if (json.contains("schedPolicy") == true)
+				{
+					auto schedPolicy = json["schedPolicy"].get<std::string_view>();
 #else
-		return json_["runAsync"].as<bool>();
+				if (json["schedPolicy"] != nullptr)
+				{
+					auto schedPolicy = json["schedPolicy"].as<std::string_view>();
 #endif // ENABLE_NLOHMANN_JSON
-	}
 
-	const std::string& Opt::Compressor() const
-	{
+					if (schedPolicy != "other" && schedPolicy != "fifo" && schedPolicy != "rr")
+					{
+						err = make_error_code(errc::json_config);
+					}
+				}
+			}
+
+			if (!err)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["compressor"].get_ref<const std::string&>();
+				if (json.contains("schedPriority") == true && json["schedPriority"].get<int>() < 0)
 #else
-		compressor_ = json_["compressor"].as<std::string>();
-		return compressor_;
+				if (json["schedPriority"] != nullptr && json["schedPriority"].as<int>() < 0)
 #endif // ENABLE_NLOHMANN_JSON
-	}
+				{
+					err = make_error_code(errc::json_config);
+				}
+			}
 
-	const std::string& Opt::Encoder() const
-	{
+#ifndef ENABLE_ZLIB
+			if (!err)
+			{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["encoder"].get_ref<const std::string&>();
+				if (json.contains("compressor") == true && json["compressor"].get<std::string_view>() == "zlib")
 #else
-		encoder_ = json_["encoder"].as<std::string>();
-		return encoder_;
+				if (json["compressor"] != nullptr && json["compressor"].as<std::string_view>() == "zlib")
 #endif // ENABLE_NLOHMANN_JSON
-	}
+				{
+					err = make_error_code(errc::compressor);
+				}
+			}
+#endif // ENABLE_ZLIB
+		}
 
-	bool Opt::LoadAsync() const
-	{
-#ifdef ENABLE_MEEN_SAVE
+		if (!err)
+		{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["loadAsync"].get<bool>();
+			json_.update(json);
 #else
-		return json_["loadAsync"].as<bool>();
+			Opt::Merge(json_, json);
 #endif // ENABLE_NLOHMANN_JSON
-#else
-		return false;
-#endif // ENABLE_MEEN_SAVE
+			Compile();
+		}
+
+		return err;
 	}
 
-#ifdef ENABLE_MEEN_SAVE
-	bool Opt::SaveAsync() const
+	void Opt::Compile()
 	{
 #ifdef ENABLE_NLOHMANN_JSON
-		return json_["saveAsync"].get<bool>();
+		values_.clockSamplingFreq = json_["clockSamplingFreq"].get<double>();
+		values_.isrFreq = json_["isrFreq"].get<double>();
+		values_.runAsync = json_["runAsync"].get<bool>();
+		values_.idlePeriod = json_["idlePeriod"].get<int>();
+		values_.compressor = json_["compressor"].get<std::string>();
+		values_.encoder = json_["encoder"].get<std::string>();
+#ifdef ENABLE_MEEN_SAVE
+		values_.loadAsync = json_["loadAsync"].get<bool>();
+		values_.saveAsync = json_["saveAsync"].get<bool>();
+#endif // ENABLE_MEEN_SAVE
+		values_.maxLoadStateLen = json_["maxLoadStateLen"].get<int>();
+		values_.memoryProfile = json_["memoryProfile"].get<std::string>();
+		values_.cpuAffinity = json_["cpuAffinity"].get<std::vector<int>>();
+		values_.schedPolicy = json_["schedPolicy"].get<std::string>();
+		values_.schedPriority = json_["schedPriority"].get<int>();
+		values_.lockMemory = json_["lockMemory"].get<bool>();
 #else
-		return json_["saveAsync"].as<bool>();
-#endif // ENABLE_NLOHMANN_JSON
-	}
+		values_.clockSamplingFreq = json_["clockSamplingFreq"].as<double>();
+		values_.isrFreq = json_["isrFreq"].as<double>();
+		values_.runAsync = json_["runAsync"].as<bool>();
+		values_.idlePeriod = json_["idlePeriod"].as<int>();
+		values_.compressor = json_["compressor"].as<std::string>();
+		values_.encoder = json_["encoder"].as<std::string>();
+#ifdef ENABLE_MEEN_SAVE
+		values_.loadAsync = json_["loadAsync"].as<bool>();
+		values_.saveAsync = json_["saveAsync"].as<bool>();
 #endif // ENABLE_MEEN_SAVE
+		values_.maxLoadStateLen = json_["maxLoadStateLen"].as<int>();
+		values_.memoryProfile = json_["memoryProfile"].as<std::string>();
+		values_.cpuAffinity.clear();
 
-	int Opt::MaxLoadStateLength() const
-	{
-#ifdef ENABLE_NLOHMANN_JSON
-	return json_["maxLoadStateLen"].get<int>();
-#else
-	return json_["maxLoadStateLen"].as<int>();
+		for (auto cpu : json_["cpuAffinity"].as<JsonArrayConst>())
+		{
+			values_.cpuAffinity.push_back(cpu.as<int>());
+		}
+
+		values_.schedPolicy = json_["schedPolicy"].as<std::string>();
+		values_.schedPriority = json_["schedPriority"].as<int>();
+		values_.lockMemory = json_["lockMemory"].as<bool>();
 #endif // ENABLE_NLOHMANN_JSON
 	}
-} // namespace meen
\ No newline at end of file
+} // namespace meen
@@ -24,9 +24,9 @@ SOFTWARE.
 #define CPMIOCONTROLLER_H
 
 #include <array>
-#include <list>
 #include <memory>
 
+#include "meen/controllers/CpmConsoleController.h"
 #include "test_controllers/BaseIoController.h"
 
 namespace meen
@@ -34,51 +34,17 @@ namespace meen
 	/** Basic CP/M IO Controller
 
 		A minimal IO controller which emulates 8 bit CP/M BDOS
-		console output and output string system calls.
+		console output and output string system calls via a
+		CpmConsoleController.
 	*/
 	class CpmIoController final : public BaseIoController
 	{
 	private:
-		/** CP/M IO Port
+		/** CP/M console
 
-			Ports for printing characters.
+			Ports 0 to 2 are forwarded to the console, see CpmConsoleController::Port.
 		*/
-		enum class Port
-		{
-			PrintMode,	//!< 2 - Output a single character into the output buffer. 9 - Output characters into the output buffer from memory until a '$' character is read.
-			AddrHi,		//!< The high 8 bit memory address to use when 9 is written to Port::PrintMode.
-			Process		//!< Process output message according to the value that was written to Port::PrintMode.
-		};
-		
-		/** Output message buffer
-
-			A list of bytes where program output messages are printed to.
-		*/
-		//cppcheck-suppress unusedStructMember
-		std::list<uint8_t> output_;
-
-		/** Printing mode
-
-			The BDOS output mode.
-
-			@remark		A value of 9 will output characters from memory
-						into the message buffer until a '$' character is read.
-						A value of 2 will output a single character into
-						the output message buffer.
-		*/
-		//cppcheck-suppress unusedStructMember
-		uint8_t printMode_{};
-
-		/** High memory address
-
-			The high 8 bits of the starting 16 bit memory address
-			from which characters will be read from the memory controller
-			into the output buffer.
-			
-			@remark		This value is only used when the print mode is 9.
-		*/
-		//cppcheck-suppress unusedStructMember
-		uint8_t addrHi_{};
+		CpmConsoleController console_;
 	public:
 		/**	Uuid
 
@@ -93,9 +59,8 @@ namespace meen
 			@param	port		The port number to read from.
 			@param	controller	Unused in this implementation.	
 
-			@return				A uint16_t value specific to the port number.
-	
-			@remark				Not used by this controller, always returns 0.
+			@return				The next byte of console output, 0x04 (end of transmission) when
+								all of the output has been read.
 		*/
 		uint8_t Read(uint16_t port, IController* controller) final;
 
@@ -110,7 +75,7 @@ namespace meen
 			@remark				When the Port is Port::Process the value is either the low 8 bit address when the Port::PrintMode is 9 or the actual
 								value to print when Port::PrintMode is 2.
 
-			@see				CpmIoController::Port
+			@see				CpmConsoleController::Port
 		*/
 		void Write(uint16_t port, uint8_t value, IController* controller) final;
 
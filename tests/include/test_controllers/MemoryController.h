@@ -54,6 +54,11 @@ namespace meen
 			All the memory that the machine will have access to.
 		*/
 		std::vector<uint8_t> memory_;
+
+		/**
+			Pages written to since the machine last cleared them
+		*/
+		DirtyPageMap dirtyPages_;
 	public:
 		/**
 			Memory controller constructor
@@ -114,6 +119,20 @@ namespace meen
 			@remark				This controller never generates any interrupts.
 		*/
 		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+
+		/** Dirty pages
+
+			Each write marks the 256 byte page it lands in as dirty.
+
+			@return				The dirty page map of this controller.
+		*/
+		DirtyPageMap* DirtyPages() final;
+
+		/** Memory
+
+			@return				A span over the entire memory of this controller.
+		*/
+		std::span<uint8_t> Memory() final;
 	};
 } // namespace meen
 
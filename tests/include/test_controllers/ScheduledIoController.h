@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SCHEDULEDIOCONTROLLER_H
+#define SCHEDULEDIOCONTROLLER_H
+
+#include <array>
+#include "test_controllers/BaseIoController.h"
+
+namespace meen
+{
+	/** Scheduled IO controller
+
+		An io controller that relies on the machine scheduler instead of being
+		polled after every instruction. It asks to be polled once a second via
+		NextPoll, wakes the machine when one of the signal ports is written
+		and delivers its save interrupt via IScheduler::Schedule.
+
+		@remark		This IO controller is purely academic, it's main use is for
+					the unit tests of the scheduler.
+	*/
+	class ScheduledIoController final : public BaseIoController
+	{
+	private:
+		/** scheduler_
+
+			The machine scheduler, nullptr when the machine is not running.
+		*/
+		IScheduler* scheduler_{};
+
+		/** saveCycle_
+
+			The cycle count at which an ISR::Save interrupt is scheduled, -1 to disable it.
+		*/
+		//cppcheck-suppress unusedStructMember
+		int64_t saveCycle_{ -1 };
+
+		/** nextPoll_
+
+			The machine time at which this controller next wants to be polled.
+		*/
+		uint64_t nextPoll_{};
+	public:
+		/**	Uuid
+
+			Unique universal identifier for this controller.
+
+			@return					The uuid as a 16 byte array.
+		*/
+		std::array<uint8_t, 16> Uuid() const final;
+
+		/** Read from a device
+
+			This controller has no devices to read from.
+
+			@return					0.
+		*/
+		uint8_t Read(uint16_t ioDeviceNumber, IController* controller) final;
+
+		/** Write to a device
+
+			Raise the signal of the specified port, see BaseIoController::Write.
+
+			@remark					The machine is woken when a signal is raised so that it is
+									handled at the next instruction boundary instead of at the
+									time this controller asked to be polled.
+		*/
+		void Write(uint16_t ioDeviceNumber, uint8_t value, IController* controller) final;
+
+		/** Interrupt handler
+
+			Reports the raised signals, see BaseIoController::GenerateInterrupt.
+
+			@param	currTime	The time in nanoseconds of the machine clock.
+			@param	cycles		The total number of cycles that have elapsed.
+			@param	controller	Unused by this implementation.
+
+			@return				The interrupt that requires servicing by the cpu.
+		*/
+		ISR GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller) final;
+
+		/** Set scheduler
+
+			Keeps the scheduler and schedules the ISR::Save interrupt requested via ScheduleSaveOn.
+
+			@param	scheduler	The machine scheduler or nullptr when the machine stops running.
+		*/
+		void SetScheduler(IScheduler* scheduler) final;
+
+		/** Next poll
+
+			Ask not to be polled until a second after the last poll.
+
+			@param	currTime	Unused by this implementation.
+			@param	cycles		Unused by this implementation.
+
+			@return				The time in nanoseconds of the last poll plus one second.
+
+			@see IController::NextPoll
+		*/
+		uint64_t NextPoll(uint64_t currTime, uint64_t cycles) final;
+
+		/** Schedule a save
+
+			Schedule an ISR::Save interrupt for when the Nth cycle has elapsed.
+
+			@param	cycleCount	The number of the cpu cycles to execute before the save interrupt is triggered,
+								a negative value disables the save.
+
+			@remark				The interrupt is scheduled when the machine starts running, it is delivered at
+								the first instruction boundary on or after the cycle count.
+		*/
+		void ScheduleSaveOn(int64_t cycleCount);
+	};
+} // namespace meen
+
+#endif // SCHEDULEDIOCONTROLLER_H
@@ -20,7 +20,11 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <coroutine>
+#include <deque>
+#include <filesystem>
 #include <format>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <memory>
 #ifdef ENABLE_NLOHMANN_JSON
@@ -29,12 +33,25 @@ SOFTWARE.
 #include <ArduinoJson.h>
 #endif
 #include <stdarg.h>
-
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "meen/controllers/CpmDiskController.h"
+#include "meen/controllers/MemfdController.h"
+#endif // __linux__
+#include "meen/controllers/AsyncController.h"
+#include "meen/controllers/CpmBdos.h"
+#include "meen/controllers/CpmConsoleController.h"
 #include "meen/Error.h"
 #include "meen/IController.h"
 #include "meen/IMachine.h"
 #include "meen/MachineFactory.h"
 #include "test_controllers/MemoryController.h"
+#include "test_controllers/ScheduledIoController.h"
 #include "test_controllers/TestIoController.h"
 #include "test_controllers/CpmIoController.h"
 
@@ -122,6 +139,12 @@ namespace meen::Tests
 		err = machine_->OnLoad(nullptr, nullptr);
 		EXPECT_FALSE(err);
 
+		err = machine_->OnWatch(nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->OnTrap(0, nullptr);
+		EXPECT_FALSE(err);
+
 		// Set default options
 		err = machine_->SetOptions(nullptr);
 		EXPECT_FALSE(err);
@@ -569,31 +592,1775 @@ namespace meen::Tests
 		}
 	}
 
-	TEST_F(MachineTest, OnInit)
+	TEST_F(MachineTest, ScheduledInterrupt)
 	{
-		int initCount = 0;
-		
-		auto err = machine_->OnInit([&initCount]([[maybe_unused]] IController* ioController)
+		std::vector<std::string> saveStates;
+
+		auto err = machine_->OnSave([](char* uri, int* uriLen, [[maybe_unused]] IController* ioController)
 		{
-			initCount++;
+			*uriLen = std::format_to_n(uri, *uriLen, "json://gtest").size;
 			return meen::errc::no_error;
+		}, [&saveStates]([[maybe_unused]] const char* location, const char* json, [[maybe_unused]] IController* ioController)
+		{
+			saveStates.emplace_back(json);
+			return errc::no_error;
 		});
+
+		if (err.value() == errc::not_implemented)
+		{
+			GTEST_SKIP() << "IMachine::OnSave not supported";
+		}
+
+		err = machine_->OnLoad([progDir = programsDir_.c_str()](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":256}},"memory":{{"rom":{{"block":[{{"bytes":"{}","offset":0}},{{"bytes":"{}","offset":5}},{{"bytes":"file://{}/TST8080.COM","offset":256,"size":1471}}]}}}}}})"sv, saveAndExit, bdosMsg, progDir);
+		}, nullptr);
 		EXPECT_FALSE(err);
 
-		// Run the test more than once (in this case 5 times)
-		for(int i = 0; i < 5; i++)
+		// Only poll the io controllers once per second of cpu time, the scheduled save must still be delivered on cycle 3000
+		err = machine_->SetOptions(R"(json://{"isrFreq":1})");
+		EXPECT_FALSE(err);
+
+		// The save is scheduled by a controller on an otherwise unused port
+		auto scheduledIoController = new ScheduledIoController();
+		scheduledIoController->ScheduleSaveOn(3000);
+		err = machine_->AttachIoController(IControllerPtr(scheduledIoController), 0xE0, 0xE0, 1);
+		EXPECT_FALSE(err);
+
+		cpmIoController_->Write(0xFD, 0, nullptr);
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		machine_->AttachIoController(std::move(cpmIoController_));
+		machine_->Run();
+		cpmIoController_ = std::move(machine_->DetachIoController().value());
+		ASSERT_TRUE(cpmIoController_);
+		EXPECT_TRUE(machine_->DetachIoController(0xE0));
+		EXPECT_EQ(74, ReadCpmIoControllerBuffer().find("CPU IS OPERATIONAL"));
+
+		ASSERT_EQ(2, saveStates.size());
+		EXPECT_STREQ(R"({"cpu":{"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":19,"b":19,"c":0,"d":19,"e":0,"h":19,"l":0,"s":86},"pc":1236,"sp":1981},"memory":{"uuid":"base64://zRjYZ92/TaqtWroc666wMQ==","rom":{"bytes":"base64://md5://BVt1f9Z97W/m34J/iH68cQ=="},"ram":{"size":64042,"bytes":"base64://zlib://eJztzlENgDAQBbDlnQAETBeSpwABCEDAfnHBktEqaGt/ca4OfKrXUVUzT+5cGVn9AQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAGBXL4n+BO8="}}})", saveStates[0].c_str());
+
+		machine_->AttachIoController(std::move(controller.value()));
+	}
+
+	TEST_F(MachineTest, PostInterrupt)
+	{
+		auto err = machine_->PostInterrupt(ISR::NoInterrupt);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+
+		// A program that never exits on its own: JMP 0x0000
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
 		{
-			RunTestSuite("8080PRE.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":0,"b":0,"c":9,"d":3,"e":50,"h":1,"l":0,"s":86},"pc":5,"sp":1280})", "8080 Preliminary tests complete", 0);
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://wwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// Posted before the machine is running, it remains pending until the machine runs
+		err = machine_->PostInterrupt(ISR::Quit);
+		EXPECT_FALSE(err);
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+
+		// Posted from another thread while the machine is running
+		std::thread poster([]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			EXPECT_FALSE(machine_->PostInterrupt(ISR::Quit));
+		});
+
+		ex = machine_->Run();
+		poster.join();
+		EXPECT_TRUE(ex);
+		EXPECT_LE(50000000, ex.value_or(0));
+	}
+
+	TEST_F(MachineTest, PostCommand)
+	{
+		auto err = machine_->PostCommand({ .type = Command::Type::Interrupt, .isr = ISR::NoInterrupt });
+		EXPECT_EQ(errc::invalid_argument, err.value());
+
+		// A program that never exits on its own: JMP 0x0000
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://wwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// The second quit remains queued for the next run
+		EXPECT_FALSE(machine_->PostCommand({ .type = Command::Type::Quit }));
+		EXPECT_FALSE(machine_->PostCommand({ .type = Command::Type::Interrupt, .isr = ISR::Quit }));
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_TRUE(machine_->Run());
+
+		// Fill the queue from several threads
+		std::vector<std::thread> posters;
+
+		for (int i = 0; i < 4; i++)
+		{
+			posters.emplace_back([]
+			{
+				for (int j = 0; j < 16; j++)
+				{
+					EXPECT_FALSE(machine_->PostCommand({ .type = Command::Type::ClockSamplingFreq, .clockSamplingFreq = -1 }));
+				}
+			});
 		}
-		EXPECT_EQ(1, initCount);
 
-		err = machine_->OnInit(nullptr);
+		for (auto& poster : posters)
+		{
+			poster.join();
+		}
+
+		err = machine_->PostCommand({ .type = Command::Type::Quit });
+		EXPECT_EQ(errc::busy, err.value());
+
+		// The running machine drains the queue, making room for the quit
+		std::thread poster([]
+		{
+			while (machine_->PostCommand({ .type = Command::Type::Quit }).value() == static_cast<int>(errc::busy))
+			{
+				std::this_thread::yield();
+			}
+		});
+
+		auto ex = machine_->Run();
+		poster.join();
+		EXPECT_TRUE(ex);
+	}
+
+	TEST_F(MachineTest, MapIoPort)
+	{
+		uint8_t latch = 0;
+		uint8_t written = 0;
+		int reads = 0;
+
+		auto err = machine_->MapIoPort(0x10, &latch);
+		EXPECT_FALSE(err);
+		err = machine_->MapIoPort(0x11, [&reads](uint8_t port)
+		{
+			EXPECT_EQ(0x11, port);
+			reads++;
+			return static_cast<uint8_t>(0x33);
+		}, nullptr);
+		EXPECT_FALSE(err);
+		err = machine_->MapIoPort(0x12, nullptr, [&written](uint8_t port, uint8_t value)
+		{
+			EXPECT_EQ(0x12, port);
+			written = value;
+		});
+		EXPECT_FALSE(err);
+		err = machine_->MapIoPort(0x13, nullptr, nullptr);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+
+		// MVI A,5Ah; OUT 10h; IN 11h; OUT 12h; OUT FFh (unmapped, routed to the io controller); HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PlrTENsR0xLT/3Y=","offset":0}}}}}})"sv);
+		}, nullptr);
 		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_EQ(0x5A, latch);
+		EXPECT_EQ(1, reads);
+		EXPECT_EQ(0x33, written);
+
+		for (uint8_t port = 0x10; port <= 0x12; port++)
+		{
+			err = machine_->UnmapIoPort(port);
+			EXPECT_FALSE(err);
+		}
 	}
 
-	TEST_F(MachineTest, Tst8080)
+	TEST_F(MachineTest, IoControllerPortRange)
+	{
+		auto err = machine_->AttachIoController(IControllerPtr(new TestIoController()), 0x00, 0x0F, 0);
+		EXPECT_FALSE(err);
+		// Polled 1000 times per second of cpu time
+		err = machine_->AttachIoController(IControllerPtr(new TestIoController()), 0xFF, 0xFF, 1000);
+		EXPECT_FALSE(err);
+
+		IControllerPtr controller(new TestIoController());
+		err = machine_->AttachIoController(std::move(controller), 0x0F, 0x10, 0);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+		EXPECT_TRUE(controller);
+		err = machine_->AttachIoController(std::move(controller), 0x20, 0x10, 0);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+		err = machine_->AttachIoController(std::move(controller), 0x10, 0x20, -1);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+		EXPECT_FALSE(machine_->DetachIoController(0x10));
+
+		auto defaultController = machine_->DetachIoController();
+		ASSERT_TRUE(defaultController);
+		auto deviceData = defaultController.value()->Read(0x00, nullptr);
+		err = machine_->AttachIoController(std::move(defaultController.value()));
+		EXPECT_FALSE(err);
+
+		// MVI A,5Ah; OUT 00h; OUT FFh; JMP 0006h - the machine only quits when the controller attached to port FFh is polled
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PlrTANP/wwYA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+
+		auto device = machine_->DetachIoController(0x05);
+		ASSERT_TRUE(device);
+		EXPECT_EQ(0x5A, device.value()->Read(0x00, nullptr));
+		device = machine_->DetachIoController(0xFF);
+		ASSERT_TRUE(device);
+
+		// The default io controller did not see the port 0 write
+		defaultController = machine_->DetachIoController();
+		ASSERT_TRUE(defaultController);
+		EXPECT_EQ(deviceData, defaultController.value()->Read(0x00, nullptr));
+		err = machine_->AttachIoController(std::move(defaultController.value()));
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, NextPoll)
+	{
+		// The scheduled io controller asks not to be polled for a second after it is first polled
+		auto err = machine_->AttachIoController(IControllerPtr(new ScheduledIoController()), 0xFF, 0xFF, 0);
+		EXPECT_FALSE(err);
+		err = machine_->SetOptions(R"(json://{"clockSamplingFreq":40})");
+		EXPECT_FALSE(err);
+
+		// NOP; OUT FFh; JMP 0003h - the port write wakes the machine so the quit is not held up until the next poll time
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://ANP/wwMA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		ASSERT_TRUE(ex);
+		EXPECT_LT(ex.value(), 500000000);
+		EXPECT_TRUE(machine_->DetachIoController(0xFF));
+	}
+
+	TEST_F(MachineTest, NextPollIdle)
+	{
+		int idleCount = 0;
+
+		// The scheduled io controller asks not to be polled for a second
+		auto defaultController = machine_->DetachIoController();
+		ASSERT_TRUE(defaultController);
+		auto scheduledIoController = IControllerPtr(new ScheduledIoController());
+		// Write to the 'load device', the value doesn't matter (use 0)
+		scheduledIoController->Write(0xFD, 0, nullptr);
+		auto err = machine_->AttachIoController(std::move(scheduledIoController));
+		EXPECT_FALSE(err);
+
+		// 2000 cycles at 2MHz
+		err = machine_->SetOptions(R"(json://{"isrFreq":1000})");
+		EXPECT_FALSE(err);
+
+		err = machine_->OnIdle([&idleCount]([[maybe_unused]] IController* ioController)
+		{
+			idleCount++;
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		// JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://wwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// The on idle handler is called at the isrFreq rate regardless of the io controller poll time
+		auto running = machine_->RunFor(200000);
+		EXPECT_TRUE(running.value_or(false));
+		EXPECT_GE(idleCount, 99);
+		EXPECT_LE(idleCount, 101);
+
+		machine_->PostInterrupt(ISR::Quit);
+		running = machine_->RunFor(2000);
+		EXPECT_FALSE(running.value_or(true));
+
+		EXPECT_TRUE(machine_->DetachIoController());
+		err = machine_->AttachIoController(std::move(defaultController.value()));
+		EXPECT_FALSE(err);
+	}
+
+	// Counts the times it is polled for interrupts
+	class PollCountingController final : public IController
+	{
+	public:
+		int polls{};
+
+		std::array<uint8_t, 16> Uuid() const final
+		{
+			return {};
+		}
+
+		uint8_t Read([[maybe_unused]] uint16_t port, [[maybe_unused]] IController* controller) final
+		{
+			return 0;
+		}
+
+		void Write([[maybe_unused]] uint16_t port, [[maybe_unused]] uint8_t value, [[maybe_unused]] IController* controller) final
+		{
+		}
+
+		ISR GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller) final
+		{
+			polls++;
+			return ISR::NoInterrupt;
+		}
+	};
+
+	TEST_F(MachineTest, DefaultPollPeriod)
+	{
+		PollCountingController device;
+
+		auto err = machine_->AttachIoController(IControllerPtr(&device, ControllerDeleter(false)), 0x20, 0x20, 0);
+		EXPECT_FALSE(err);
+
+		// JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://wwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// Without an isrFreq a controller that does not ask for a later poll time is polled at the completion of each instruction, 20000 jumps of 10 cycles
+		auto running = machine_->RunFor(200000);
+		EXPECT_TRUE(running.value_or(false));
+		EXPECT_GE(device.polls, 19999);
+		EXPECT_LE(device.polls, 20001);
+
+		machine_->PostInterrupt(ISR::Quit);
+		running = machine_->RunFor(2000);
+		EXPECT_FALSE(running.value_or(true));
+		EXPECT_TRUE(machine_->DetachIoController(0x20));
+	}
+
+	// Echoes each byte written to port 0 back incremented by one from the worker thread, port 1 reads the ready status
+	class EchoController final : public AsyncController
+	{
+	public:
+		EchoController() : AsyncController(ISR::Two) {}
+
+		std::array<uint8_t, 16> Uuid() const final
+		{
+			return {};
+		}
+
+		uint8_t Read(uint16_t port, [[maybe_unused]] IController* controller) final
+		{
+			uint8_t value = 0;
+
+			if (port == 0x00)
+			{
+				GuestRead(value);
+			}
+			else
+			{
+				value = GuestReady() ? 1 : 0;
+			}
+
+			return value;
+		}
+
+		void Write([[maybe_unused]] uint16_t port, uint8_t value, [[maybe_unused]] IController* controller) final
+		{
+			GuestWrite(value);
+		}
+
+		void Service() final
+		{
+			uint8_t value = 0;
+
+			while (HostRead(value) == true)
+			{
+				HostWrite(value + 1);
+			}
+		}
+	};
+
+	TEST_F(MachineTest, AsyncController)
+	{
+		uint8_t echo = 0;
+
+		auto err = machine_->AttachIoController(IControllerPtr(new EchoController()), 0x00, 0x01, 0);
+		EXPECT_FALSE(err);
+		err = machine_->MapIoPort(0x02, nullptr, [&echo]([[maybe_unused]] uint8_t port, uint8_t value)
+		{
+			echo = value;
+		});
+		EXPECT_FALSE(err);
+
+		// 00h: LXI SP,0100h; EI; MVI A,41h; OUT 00h
+		// 08h: EI; JMP 0008h
+		// 10h: IN 00h; OUT 02h; OUT FFh; HLT - the ISR::Two handler runs once the echo is ready
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://MQAB+z5B0wD7wwgAAAAAANsA0wLT/3Y=","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_EQ(0x42, echo);
+
+		EXPECT_TRUE(machine_->DetachIoController(0x00));
+		err = machine_->UnmapIoPort(0x02);
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, AsyncControllerSuspendedRun)
+	{
+		auto machine = Make8080Machine();
+		auto err = machine->AttachMemoryController(IControllerPtr(new MemoryController()));
+		EXPECT_FALSE(err);
+		auto ioController = IControllerPtr(new TestIoController());
+		// Write to the 'load device', the value doesn't matter (use 0)
+		ioController->Write(0xFD, 0, nullptr);
+		err = machine->AttachIoController(std::move(ioController));
+		EXPECT_FALSE(err);
+		err = machine->AttachIoController(IControllerPtr(new EchoController()), 0x00, 0x01, 0);
+		EXPECT_FALSE(err);
+
+		// MVI A,41h; OUT 00h; JMP 0000h - keeps the echo worker busy
+		err = machine->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PkHTAMMAAA==","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// The machine has to stop the echo worker before it destroys the controller that the suspended run is still bound to
+		auto running = machine->RunFor(100000);
+		EXPECT_TRUE(running.value_or(false));
+		machine.reset();
+	}
+
+	TEST_F(MachineTest, CpmConsoleController)
+	{
+		CpmConsoleController console;
+		MemoryController memoryController;
+		std::string_view hello = "Hello$";
+
+		for (size_t i = 0; i < hello.size(); i++)
+		{
+			memoryController.Write(0x1000 + i, hello[i], nullptr);
+		}
+
+		// BDOS function 9 - output the string at 1000h, function 2 - output a character
+		console.Write(0, 9, nullptr);
+		console.Write(1, 0x10, nullptr);
+		console.Write(2, 0x00, &memoryController);
+		console.Write(0, 2, nullptr);
+		console.Write(2, '!', nullptr);
+
+		auto output = console.Output();
+		EXPECT_EQ("Hello!", std::string(output.begin(), output.end()));
+		console.Consume(output.size());
+		EXPECT_TRUE(console.Output().empty());
+
+		// Overfill the ring, the output wraps around the end of the ring and the excess is dropped
+		for (size_t i = 0; i < CpmConsoleController::outputSize_ + 10; i++)
+		{
+			console.Write(2, 'a', nullptr);
+		}
+
+		EXPECT_EQ(10, console.Dropped());
+
+		size_t size = 0;
+		int views = 0;
+
+		for (output = console.Output(); output.empty() == false; output = console.Output())
+		{
+			size += output.size();
+			views++;
+			console.Consume(output.size());
+		}
+
+		EXPECT_EQ(CpmConsoleController::outputSize_, size);
+		EXPECT_EQ(2, views);
+	}
+
+	TEST_F(MachineTest, CpmBdos)
+	{
+		CpmConsoleController console;
+		CpmBdos bdos(&console, programsDir_.c_str());
+
+		// Service the BDOS calls natively, the bdosMsg subroutine loaded at 5 is never executed
+		auto err = machine_->OnTrap(0x0005, [&bdos](Registers& registers, IController* memoryController)
+		{
+			return bdos.Call(registers, memoryController);
+		});
+		EXPECT_FALSE(err);
+
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", std::string::npos);
+
+		std::string message;
+
+		for (auto output = console.Output(); output.empty() == false; output = console.Output())
+		{
+			message.append(output.begin(), output.end());
+			console.Consume(output.size());
+		}
+
+		EXPECT_EQ(74, message.find("CPU IS OPERATIONAL"));
+	}
+
+	TEST_F(MachineTest, OnTrap)
 	{
+		std::vector<uint8_t> flags;
+
+		// The flags are read and written back, a negative return value lets the call through
+		auto err = machine_->OnTrap(0x0020, [&flags](Registers& registers, [[maybe_unused]] IController* memoryController)
+		{
+			flags.push_back(registers.flags);
+			// carry
+			registers.flags = 0x01;
+			return flags.size() == 1 ? 0 : -1;
+		});
+		EXPECT_FALSE(err);
+
+		// XRA A; CALL 0020h; CALL 0020h - 0020h: OUT FFh; HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"block":[{{"bytes":"base64://r80gAM0gAA==","offset":0}},{{"bytes":"base64://0/92","offset":32}}]}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		EXPECT_TRUE(machine_->Run());
+		ASSERT_EQ(2, flags.size());
+		// zero and parity
+		EXPECT_EQ(0x46, flags[0]);
+		EXPECT_EQ(0x03, flags[1]);
+	}
+
+	TEST_F(MachineTest, CpmBdosFile)
+	{
+		auto directory = std::filesystem::temp_directory_path() / "meen_bdos";
+		std::filesystem::remove_all(directory);
+		std::filesystem::create_directory(directory);
+
+		CpmConsoleController console;
+		CpmBdos bdos(&console, directory.string().c_str());
+		MemoryController memoryController;
+		Registers registers{};
+		std::string_view name = "\0TEST    TXT"sv;
+
+		auto call = [&](CpmBdos::Function function, uint16_t de)
+		{
+			registers.c = static_cast<uint8_t>(function);
+			registers.d = de >> 8;
+			registers.e = de & 0xFF;
+			EXPECT_EQ(0, bdos.Call(registers, &memoryController));
+			return registers.a;
+		};
+
+		auto fill = [&memoryController](uint16_t address, uint8_t value, size_t len)
+		{
+			for (size_t i = 0; i < len; i++)
+			{
+				memoryController.Write(address + i, value, nullptr);
+			}
+		};
+
+		// FCB at 5Ch, DMA buffer at 80h
+		fill(0x5C, 0, 36);
+
+		for (size_t i = 0; i < name.size(); i++)
+		{
+			memoryController.Write(0x5C + i, name[i], nullptr);
+		}
+
+		EXPECT_EQ(0x22, call(CpmBdos::Function::Version, 0));
+		EXPECT_EQ(0xFF, call(CpmBdos::Function::OpenFile, 0x5C));
+		EXPECT_EQ(0, call(CpmBdos::Function::MakeFile, 0x5C));
+		fill(0x80, 'A', CpmBdos::recordSize_);
+		EXPECT_EQ(0, call(CpmBdos::Function::WriteSequential, 0x5C));
+		fill(0x80, 'B', CpmBdos::recordSize_);
+		EXPECT_EQ(0, call(CpmBdos::Function::WriteSequential, 0x5C));
+		EXPECT_EQ(0, call(CpmBdos::Function::CloseFile, 0x5C));
+		EXPECT_EQ(2 * CpmBdos::recordSize_, std::filesystem::file_size(directory / "TEST.TXT"));
+
+		// Read the records back sequentially
+		memoryController.Write(0x5C + 32, 0, nullptr);
+		EXPECT_EQ(0, call(CpmBdos::Function::OpenFile, 0x5C));
+		EXPECT_EQ(2, memoryController.Read(0x5C + 15, nullptr));
+		EXPECT_EQ(0, call(CpmBdos::Function::ReadSequential, 0x5C));
+		EXPECT_EQ('A', memoryController.Read(0xFF, nullptr));
+		EXPECT_EQ(0, call(CpmBdos::Function::ReadSequential, 0x5C));
+		EXPECT_EQ('B', memoryController.Read(0x80, nullptr));
+		EXPECT_EQ(1, call(CpmBdos::Function::ReadSequential, 0x5C));
+
+		// Random access
+		memoryController.Write(0x5C + 33, 0, nullptr);
+		EXPECT_EQ(0, call(CpmBdos::Function::ReadRandom, 0x5C));
+		EXPECT_EQ('A', memoryController.Read(0x80, nullptr));
+		EXPECT_EQ(0, call(CpmBdos::Function::FileSize, 0x5C));
+		EXPECT_EQ(2, memoryController.Read(0x5C + 33, nullptr));
+
+		// Directory search with a wildcard file name, the entry is returned at the DMA address
+		std::string_view pattern = "\0????????TXT"sv;
+
+		for (size_t i = 0; i < pattern.size(); i++)
+		{
+			memoryController.Write(0x6C + i, pattern[i], nullptr);
+		}
+
+		EXPECT_EQ(0, call(CpmBdos::Function::SearchFirst, 0x6C));
+		EXPECT_EQ('T', memoryController.Read(0x81, nullptr));
+		EXPECT_EQ(2, memoryController.Read(0x80 + 15, nullptr));
+		EXPECT_EQ(0xFF, call(CpmBdos::Function::SearchNext, 0x6C));
+
+		EXPECT_EQ(0, call(CpmBdos::Function::CloseFile, 0x5C));
+		EXPECT_EQ(0, call(CpmBdos::Function::DeleteFile, 0x5C));
+		EXPECT_FALSE(std::filesystem::exists(directory / "TEST.TXT"));
+
+		// Unsupported functions fall through to the guest BDOS
+		registers.c = 40;
+		EXPECT_EQ(-1, bdos.Call(registers, &memoryController));
+
+		std::filesystem::remove_all(directory);
+	}
+
+	TEST_F(MachineTest, InterruptController)
+	{
+		std::vector<uint8_t> delivered;
+
+		// Each interrupt handler writes its number to port 10h
+		auto err = machine_->MapIoPort(0x10, nullptr, [&delivered]([[maybe_unused]] uint8_t port, uint8_t value)
+		{
+			delivered.push_back(value);
+		});
+		EXPECT_FALSE(err);
+
+		// 00h: DI; NOP; EI; HLT; HLT
+		// 08h: MVI A,1; OUT 10h; OUT FFh; HLT
+		// 10h: MVI A,2; OUT 10h; EI; RET
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://8wD7dnYAAAA+AdMQ0/92AD4C0xD7yQA=","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->SetInterruptPriority(ISR::Quit);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+
+		// Both interrupts are raised while the cpu has interrupts disabled, they must be held pending and delivered highest priority first
+		err = machine_->SetInterruptPriority(ISR::Two);
+		EXPECT_FALSE(err);
+		machine_->PostInterrupt(ISR::One);
+		machine_->PostInterrupt(ISR::Two);
+		machine_->Run();
+		EXPECT_EQ((std::vector<uint8_t>{ 2, 1 }), delivered);
+
+		// A masked interrupt is never delivered
+		delivered.clear();
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		machine_->AttachIoController(std::move(controller.value()));
+		err = machine_->SetInterruptMask(1 << static_cast<int>(ISR::Two));
+		EXPECT_FALSE(err);
+		machine_->PostInterrupt(ISR::One);
+		machine_->PostInterrupt(ISR::Two);
+		machine_->Run();
+		EXPECT_EQ((std::vector<uint8_t>{ 1 }), delivered);
+
+		machine_->SetInterruptMask(0);
+		machine_->SetInterruptPriority(ISR::Zero);
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, RunAsyncWorker)
+	{
+		std::vector<std::thread::id> threads;
+
+		auto err = machine_->MapIoPort(0x10, nullptr, [&threads]([[maybe_unused]] uint8_t port, [[maybe_unused]] uint8_t value)
+		{
+			threads.push_back(std::this_thread::get_id());
+		});
+		EXPECT_FALSE(err);
+
+		// MVI A,1; OUT 10h; OUT FFh; HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PgHTENP/dg==","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true})");
+		EXPECT_FALSE(err);
+
+		for (int i = 0; i < 3; i++)
+		{
+			auto controller = machine_->DetachIoController();
+			ASSERT_TRUE(controller);
+			controller.value()->Write(0xFD, 0, nullptr);
+			machine_->AttachIoController(std::move(controller.value()));
+			EXPECT_TRUE(machine_->Run());
+		}
+
+		// Every async run is serviced by the same worker thread
+		ASSERT_EQ(3, threads.size());
+		EXPECT_NE(std::this_thread::get_id(), threads[0]);
+		EXPECT_EQ(threads[0], threads[1]);
+		EXPECT_EQ(threads[0], threads[2]);
+
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, IdlePeriod)
+	{
+		int idleCount = 0;
+
+		auto err = machine_->SetOptions(R"(json://{"idlePeriod":-1})");
+		EXPECT_EQ(errc::json_config, err.value());
+
+		err = machine_->OnIdle([&idleCount]([[maybe_unused]] IController* ioController)
+		{
+			idleCount++;
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		// MVI A,1; OUT 10h; OUT FFh; HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PgHTENP/dg==","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true,"idlePeriod":5000})");
+		EXPECT_FALSE(err);
+
+		// The idle loop sleeps between the handler calls, the machine quitting must wake it well before the idle period elapses
+		auto start = std::chrono::steady_clock::now();
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_GT(std::chrono::milliseconds(1000), std::chrono::steady_clock::now() - start);
+		EXPECT_GE(2, idleCount);
+	}
+
+	TEST_F(MachineTest, ThreadOptions)
+	{
+		auto err = machine_->SetOptions(R"(json://{"cpuAffinity":[-1]})");
+		EXPECT_EQ(errc::json_config, err.value());
+		err = machine_->SetOptions(R"(json://{"cpuAffinity":0})");
+		EXPECT_EQ(errc::json_config, err.value());
+		err = machine_->SetOptions(R"(json://{"schedPolicy":"batch"})");
+		EXPECT_EQ(errc::json_config, err.value());
+		err = machine_->SetOptions(R"(json://{"schedPriority":-1})");
+		EXPECT_EQ(errc::json_config, err.value());
+
+		bool pinned = true;
+		bool available = true;
+		bool fifo = false;
+		bool canFifo = false;
+		bool locked = false;
+		bool canLock = false;
+#ifdef __linux__
+		// The affinity is left unrestricted when cpu 0 is not available to the process
+		cpu_set_t processAffinity;
+		CPU_ZERO(&processAffinity);
+		sched_getaffinity(0, sizeof(processAffinity), &processAffinity);
+		available = CPU_ISSET(0, &processAffinity);
+
+		// Probe the permissions on a thread of its own, the real time policy and memory lock fall back to the defaults without them
+		std::thread([&canFifo, &canLock]
+		{
+			sched_param param{ 10 };
+			canFifo = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+			canLock = mlockall(MCL_CURRENT) == 0;
+
+			if (canLock == true)
+			{
+				munlockall();
+			}
+		}).join();
+
+		// The memory locked by the process in kB
+		auto lockedMemory = []
+		{
+			std::ifstream status("/proc/self/status");
+			std::string line;
+
+			while (std::getline(status, line))
+			{
+				if (line.starts_with("VmLck:") == true)
+				{
+					return std::stoi(line.substr(strlen("VmLck:")));
+				}
+			}
+
+			return 0;
+		};
+#endif // __linux__
+
+		// MVI A,1; OUT 10h; OUT FFh; HLT
+		err = machine_->MapIoPort(0x10, nullptr, [&]([[maybe_unused]] uint8_t port, [[maybe_unused]] uint8_t value)
+		{
+#ifdef __linux__
+			cpu_set_t affinity;
+			CPU_ZERO(&affinity);
+			sched_getaffinity(0, sizeof(affinity), &affinity);
+			pinned = CPU_COUNT(&affinity) == 1 && CPU_ISSET(0, &affinity);
+
+			int policy = SCHED_OTHER;
+			sched_param param{};
+			pthread_getschedparam(pthread_self(), &policy, &param);
+			fifo = policy == SCHED_FIFO;
+			locked = lockedMemory() > 0;
+#endif // __linux__
+		});
+		EXPECT_FALSE(err);
+
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PgHTENP/dg==","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true,"cpuAffinity":[0],"schedPolicy":"fifo","schedPriority":10,"lockMemory":true})");
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_EQ(available, pinned);
+		EXPECT_EQ(canFifo, fifo);
+		EXPECT_EQ(canLock, locked);
+
+		// The worker thread is reused, a run without the options restores the defaults and releases the memory lock
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true,"cpuAffinity":[],"schedPolicy":"other","lockMemory":false})");
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_FALSE(fifo);
+		EXPECT_FALSE(locked);
+
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, RunLoopConfigurations)
+	{
+		uint8_t latch = 0;
+
+		auto err = machine_->MapIoPort(0x10, &latch);
+		EXPECT_FALSE(err);
+
+		// MVI B,0; INR B; JNZ 2; MVI A,5Ah; OUT 10h; OUT FFh; HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://BgAEwgIAPlrTENP/dg==","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// Each combination selects a different run loop, the program must run the same way in all of them
+		for (auto handlers : { true, false })
+		{
+			if (handlers == false)
+			{
+				// The program stays in memory, the machine runs it without a load handler
+				err = machine_->OnLoad(nullptr, nullptr);
+				EXPECT_FALSE(err);
+			}
+
+			for (auto options : { R"(json://{"runAsync":false,"clockSamplingFreq":-1})", R"(json://{"runAsync":true,"clockSamplingFreq":-1})",
+				R"(json://{"runAsync":false,"clockSamplingFreq":0})", R"(json://{"runAsync":true,"clockSamplingFreq":0})" })
+			{
+				err = machine_->SetOptions(options);
+				EXPECT_FALSE(err);
+
+				latch = 0;
+				auto ex = machine_->Run();
+				ASSERT_TRUE(ex);
+				EXPECT_EQ(0x5A, latch);
+				// The unthrottled clock is only ticked when the time is needed, the run time must still be reported
+				EXPECT_LT(0, ex.value());
+			}
+		}
+
+		machine_->SetOptions(R"(json://{"runAsync":false,"clockSamplingFreq":-1})");
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, RunFor)
+	{
+		std::vector<uint8_t> values;
+
+		auto err = machine_->MapIoPort(0x10, nullptr, [&values]([[maybe_unused]] uint8_t port, uint8_t value)
+		{
+			values.push_back(value);
+		});
+		EXPECT_FALSE(err);
+
+		// 25 cycles per iteration - INR A; OUT 10h; JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PNMQwwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto running = machine_->RunFor(250);
+		ASSERT_TRUE(running);
+		EXPECT_TRUE(running.value());
+		EXPECT_EQ(10, values.size());
+
+		// The machine is busy while the run is suspended
+		err = machine_->SetOptions(R"(json://{"isrFreq":1})");
+		EXPECT_EQ(errc::busy, err.value());
+
+		// Each call resumes where the last one stopped, the accumulator is not reset
+		running = machine_->RunFor(250);
+		EXPECT_TRUE(running.value_or(false));
+		ASSERT_EQ(20, values.size());
+		EXPECT_EQ(20, values.back());
+
+		// 125 microseconds at 2MHz is 250 cycles
+		running = machine_->RunFor(std::chrono::microseconds(125));
+		EXPECT_TRUE(running.value_or(false));
+		EXPECT_EQ(30, values.size());
+
+		running = machine_->RunFor(std::chrono::nanoseconds(-1));
+		EXPECT_EQ(errc::invalid_argument, running.error().value());
+
+		// Quit the suspended run
+		machine_->PostInterrupt(ISR::Quit);
+		running = machine_->RunFor(250);
+		ASSERT_TRUE(running);
+		EXPECT_FALSE(running.value());
+
+		err = machine_->UnmapIoPort(0x10);
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, RunForException)
+	{
+		std::vector<uint8_t> values;
+
+		auto err = machine_->MapIoPort(0x10, nullptr, [&values]([[maybe_unused]] uint8_t port, uint8_t value)
+		{
+			if (value == 5)
+			{
+				throw std::runtime_error("port handler failed");
+			}
+
+			values.push_back(value);
+		});
+		EXPECT_FALSE(err);
+
+		// INR A; OUT 10h; JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PNMQwwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		EXPECT_THROW(machine_->RunFor(250), std::runtime_error);
+		EXPECT_EQ(4, values.size());
+
+		// The run that threw is dropped, the machine is no longer busy
+		err = machine_->SetOptions(R"(json://{"isrFreq":1})");
+		EXPECT_FALSE(err);
+
+		err = machine_->UnmapIoPort(0x10);
+		EXPECT_FALSE(err);
+		err = machine_->MapIoPort(0x10, nullptr, [&values]([[maybe_unused]] uint8_t port, uint8_t value)
+		{
+			values.push_back(value);
+		});
+		EXPECT_FALSE(err);
+
+		// The next run starts afresh from the program in memory
+		values.clear();
+		auto running = machine_->RunFor(100);
+		EXPECT_TRUE(running.value_or(false));
+		ASSERT_EQ(4, values.size());
+		EXPECT_EQ(1, values.front());
+
+		machine_->PostInterrupt(ISR::Quit);
+		running = machine_->RunFor(100);
+		ASSERT_TRUE(running);
+		EXPECT_FALSE(running.value());
+
+		err = machine_->UnmapIoPort(0x10);
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, RunAwait)
+	{
+		// A minimal fire and forget coroutine
+		struct Task
+		{
+			struct promise_type
+			{
+				Task get_return_object() { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { std::terminate(); }
+			};
+		};
+
+		// A single threaded executor drained by the test
+		std::deque<std::function<void()>> tasks;
+		auto err = std::make_error_code(std::errc::operation_in_progress);
+		bool done = false;
+
+		// MVI B,0; DCR B; JNZ 2; OUT FFh; HLT - 3840 cycles
+		machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://BgAFwgIA0/92","offset":0}}}}}})"sv);
+		}, nullptr);
+
+		auto emulate = [&]() -> Task
+		{
+			err = co_await machine_->RunAwait([&tasks](std::function<void()>&& task)
+			{
+				tasks.push_back(std::move(task));
+			}, 1000);
+			done = true;
+		};
+
+		emulate();
+		// Nothing runs until the executor runs the first slice
+		EXPECT_FALSE(done);
+
+		int slices = 0;
+
+		while (tasks.empty() == false)
+		{
+			auto task = std::move(tasks.front());
+			tasks.pop_front();
+			task();
+			slices++;
+		}
+
+		EXPECT_TRUE(done);
+		EXPECT_FALSE(err);
+		EXPECT_EQ(4, slices);
+	}
+
+	TEST_F(MachineTest, PauseResume)
+	{
+		std::atomic_int count = 0;
+		std::atomic_int value = 0;
+
+		auto err = machine_->MapIoPort(0x10, nullptr, [&count, &value]([[maybe_unused]] uint8_t port, uint8_t v)
+		{
+			value = v;
+			count++;
+		});
+		EXPECT_FALSE(err);
+
+		// INR A; OUT 10h; JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PNMQwwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		int paused = -1;
+		bool resumed = false;
+
+		err = machine_->OnIdle([&]([[maybe_unused]] IController* ioController)
+		{
+			if (paused < 0 && count > 1000)
+			{
+				machine_->Pause();
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				paused = count;
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				// The run loop is held, nothing executes while paused
+				EXPECT_EQ(paused, count);
+				machine_->Resume();
+			}
+			else if (paused >= 0 && count > paused + 1000)
+			{
+				resumed = true;
+				return true;
+			}
+
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true})");
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+
+		EXPECT_LT(0, paused);
+		EXPECT_TRUE(resumed);
+		// The accumulator carried on counting from where it paused
+		EXPECT_EQ(count % 256, value);
+
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, PauseNotRunning)
+	{
+		// OUT FFh; HLT
+		auto err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://0/92","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// The pause is dropped when the run starts, the synchronous run would otherwise wait forever
+		err = machine_->Pause();
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+	}
+
+	TEST_F(MachineTest, PauseQuit)
+	{
+		std::atomic_int count = 0;
+
+		auto err = machine_->MapIoPort(0x10, nullptr, [&count]([[maybe_unused]] uint8_t port, [[maybe_unused]] uint8_t v)
+		{
+			count++;
+		});
+		EXPECT_FALSE(err);
+
+		// INR A; OUT 10h; JMP 0
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PNMQwwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		int paused = -1;
+		int pausedIdles = 0;
+
+		// The idle handler of a synchronous run is called while it is paused and can quit it
+		err = machine_->OnIdle([&]([[maybe_unused]] IController* ioController)
+		{
+			if (paused < 0 && count > 1000)
+			{
+				machine_->Pause();
+				paused = count;
+			}
+			else if (paused >= 0)
+			{
+				// Nothing executes while paused
+				EXPECT_EQ(paused, count);
+				return ++pausedIdles == 3;
+			}
+
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"idlePeriod":1})");
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_EQ(3, pausedIdles);
+
+		// A posted quit ends the pause of an asynchronous run
+		paused = -1;
+		count = 0;
+
+		err = machine_->OnIdle([&]([[maybe_unused]] IController* ioController)
+		{
+			if (paused < 0 && count > 1000)
+			{
+				machine_->Pause();
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				paused = count;
+				machine_->PostInterrupt(ISR::Quit);
+			}
+
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"runAsync":true})");
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->Run());
+		EXPECT_EQ(paused, count);
+
+		machine_->UnmapIoPort(0x10);
+	}
+
+	TEST_F(MachineTest, OnInit)
+	{
+		int initCount = 0;
+		
+		auto err = machine_->OnInit([&initCount]([[maybe_unused]] IController* ioController)
+		{
+			initCount++;
+			return meen::errc::no_error;
+		});
+		EXPECT_FALSE(err);
+
+		// Run the test more than once (in this case 5 times)
+		for(int i = 0; i < 5; i++)
+		{
+			RunTestSuite("8080PRE.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":0,"b":0,"c":9,"d":3,"e":50,"h":1,"l":0,"s":86},"pc":5,"sp":1280})", "8080 Preliminary tests complete", 0);
+		}
+		EXPECT_EQ(1, initCount);
+
+		err = machine_->OnInit(nullptr);
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, Tst8080)
+	{
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+	}
+
+#ifdef __linux__
+	TEST_F(MachineTest, MemfdController)
+	{
+		auto memfd = MemfdController::Make("meen_test");
+		ASSERT_TRUE(memfd);
+
+		// Swap out the test memory controller for the memfd backed controller
+		auto mc = machine_->DetachMemoryController();
+		ASSERT_TRUE(mc);
+		auto err = machine_->AttachMemoryController(std::move(memfd.value()));
+		EXPECT_FALSE(err);
+
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+
+		auto parent = machine_->DetachMemoryController();
+		ASSERT_TRUE(parent);
+		auto fd = static_cast<MemfdController*>(parent.value().get())->Fd();
+
+		// Zero copy view of the parent guest memory, writes are ignored
+		auto view = MemfdController::Map(fd, MemfdController::Mapping::ReadOnly);
+		ASSERT_TRUE(view);
+		EXPECT_EQ(0xC3, view.value()->Read(0x100, nullptr));
+		view.value()->Write(0x100, 0x00, nullptr);
+		EXPECT_EQ(0xC3, view.value()->Read(0x100, nullptr));
+		// The read only view can still be read directly
+		EXPECT_TRUE(view.value()->Memory().empty());
+		ASSERT_EQ(0x10000u, view.value()->MemoryView().size());
+		EXPECT_EQ(0xC3, view.value()->MemoryView()[0x100]);
+
+		// Snapshot of the parent guest memory
+		auto child = MemfdController::Map(fd, MemfdController::Mapping::Private);
+		ASSERT_TRUE(child);
+		EXPECT_NE(fd, child.value()->Fd());
+		EXPECT_EQ(0xC3, child.value()->Read(0x100, nullptr));
+		child.value()->Write(0x100, 0x00, nullptr);
+		EXPECT_EQ(0x00, child.value()->Read(0x100, nullptr));
+		EXPECT_EQ(0xC3, parent.value()->Read(0x100, nullptr));
+		child.value()->Write(0x100, 0xC3, nullptr);
+
+		// The parent writes after the snapshot are not seen by the child, including on pages the child has not written to
+		auto byte = parent.value()->Read(0x2000, nullptr);
+		parent.value()->Write(0x2000, byte + 1, nullptr);
+		EXPECT_EQ(byte, child.value()->Read(0x2000, nullptr));
+		parent.value()->Write(0x2000, byte, nullptr);
+
+		EXPECT_EQ(errc::invalid_argument, MemfdController::Map(-1, MemfdController::Mapping::Shared).error().value());
+
+		// Run the test suite again from the child memory without loading any of it
+		err = machine_->AttachMemoryController(std::move(child.value()));
+		EXPECT_FALSE(err);
+
+		// The save handler registered by RunTestSuite references state that has gone out of scope
+		err = machine_->OnSave(nullptr, nullptr);
+		EXPECT_TRUE(err.value() == errc::no_error || err.value() == errc::not_implemented);
+
+		machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","pc":256}},"memory":{{"uuid":"base64://yY62sVBKRjmgjz0cMuJp5A==","rom":{{"block":[{{"bytes":"memfd://","offset":0,"size":5}},{{"bytes":"memfd://","offset":5,"size":17}},{{"bytes":"memfd://","offset":256,"size":1471}}]}},"ram":{{"bytes":"memfd://"}}}}}})"sv);
+		}, nullptr);
+
+		cpmIoController_->Write(0xFD, 0, nullptr);
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		err = machine_->AttachIoController(std::move(cpmIoController_));
+		EXPECT_FALSE(err);
+		machine_->Run();
+		cpmIoController_ = std::move(machine_->DetachIoController().value());
+		ASSERT_TRUE(cpmIoController_);
+		EXPECT_EQ(74, ReadCpmIoControllerBuffer().find("CPU IS OPERATIONAL"));
+
+		// Restore the defacto test controllers
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+		err = machine_->AttachMemoryController(std::move(mc.value()));
+		EXPECT_FALSE(err);
+	}
+
+	// A 64k memory controller without direct memory access that counts the reads made by the machine rather than the cpu
+	class ReadCountingController final : public IController
+	{
+	private:
+		std::vector<uint8_t> memory_ = std::vector<uint8_t>(1 << 16);
+		DirtyPageMap dirtyPages_;
+	public:
+		int machineReads{};
+
+		std::array<uint8_t, 16> Uuid() const final
+		{
+			return {};
+		}
+
+		uint8_t Read(uint16_t address, IController* controller) final
+		{
+			if (controller == nullptr)
+			{
+				machineReads++;
+			}
+
+			return memory_[address];
+		}
+
+		void Write(uint16_t address, uint8_t value, [[maybe_unused]] IController* controller) final
+		{
+			memory_[address] = value;
+			dirtyPages_.set(address >> 8);
+		}
+
+		ISR GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller) final
+		{
+			return ISR::NoInterrupt;
+		}
+
+		DirtyPageMap* DirtyPages() final
+		{
+			return &dirtyPages_;
+		}
+	};
+
+	TEST_F(MachineTest, SaveReadsDirtyMemory)
+	{
+		std::vector<std::string> saves;
+
+		auto err = machine_->OnSave([]([[maybe_unused]] char* uri, int* uriLen, [[maybe_unused]] IController* ioController)
+		{
+			*uriLen = std::format_to_n(uri, *uriLen, "json://gtest").size;
+			return meen::errc::no_error;
+		}, [&saves]([[maybe_unused]] const char* location, const char* json, [[maybe_unused]] IController* ioController)
+		{
+			saves.emplace_back(json);
+			return meen::errc::no_error;
+		});
+
+		if (err.value() == errc::not_implemented)
+		{
+			GTEST_SKIP() << "save support is not enabled";
+		}
+
+		EXPECT_FALSE(err);
+
+		ReadCountingController memory;
+		auto mc = machine_->DetachMemoryController();
+		ASSERT_TRUE(mc);
+		err = machine_->AttachMemoryController(IControllerPtr(&memory, ControllerDeleter(false)));
+		EXPECT_FALSE(err);
+
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"{}","offset":0}}}}}})"sv, saveAndExit);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		// The first save reads back all of the ram
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		ASSERT_EQ(1, saves.size());
+		EXPECT_LT(0xFF00, memory.machineReads);
+
+		// The second run is not loaded, the ram has not changed since the last save so it is not read again
+		memory.machineReads = 0;
+		ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		ASSERT_EQ(2, saves.size());
+		EXPECT_EQ(0, memory.machineReads);
+		EXPECT_EQ(saves[0], saves[1]);
+
+		// Only the dirty page is read back
+		memory.machineReads = 0;
+		memory.Write(0x8000, 0xAA, nullptr);
+		ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		ASSERT_EQ(3, saves.size());
+		EXPECT_EQ(256, memory.machineReads);
+		EXPECT_NE(saves[1], saves[2]);
+
+		err = machine_->AttachMemoryController(std::move(mc.value()));
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, LoadBadRomMd5)
+	{
+		MemoryController memory;
+		auto mc = machine_->DetachMemoryController();
+		ASSERT_TRUE(mc);
+		auto err = machine_->AttachMemoryController(IControllerPtr(&memory, ControllerDeleter(false)));
+		EXPECT_FALSE(err);
+
+		std::error_code loadErr;
+
+		err = machine_->OnError([&loadErr](std::error_code ec, [[maybe_unused]] const char* fileName, [[maybe_unused]] const char* functionName, [[maybe_unused]] uint32_t line, [[maybe_unused]] uint32_t column, IController* ioController)
+		{
+			loadErr = ec;
+			ioController->Write(0xFF, 0, nullptr);
+		});
+		EXPECT_FALSE(err);
+
+		// OUT FFh; HLT
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://0/92","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_FALSE(loadErr);
+
+		// The ram would be cleared by the load if it were applied
+		memory.Write(0x8000, 0xAA, nullptr);
+		std::vector<uint8_t> expected(memory.Memory().begin(), memory.Memory().end());
+
+		// A rom block followed by an md5 that does not match, the load is rejected before the rom block is written
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"block":[{{"bytes":"base64://////","offset":256}},{{"bytes":"base64://md5://AAAAAAAAAAAAAAAAAAAAAA=="}}]}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+
+		ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_EQ(errc::incompatible_rom, loadErr.value());
+		EXPECT_TRUE(std::equal(expected.begin(), expected.end(), memory.Memory().begin()));
+
+		// The md5 covers the bytes of the rom blocks that precede it even though they have not been written yet
+		loadErr.clear();
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"block":[{{"bytes":"base64://0/92","offset":0}},{{"bytes":"base64://////","offset":256}},{{"bytes":"base64://md5://LFml/JJ11F4Ekl7L6L6uZw=="}}]}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+
+		ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_FALSE(loadErr);
+		EXPECT_EQ(0xFF, memory.Read(0x0100, nullptr));
+		EXPECT_EQ(0x00, memory.Read(0x8000, nullptr));
+
+		err = machine_->AttachMemoryController(std::move(mc.value()));
+		EXPECT_FALSE(err);
+	}
+
+	TEST_F(MachineTest, LoadAsyncError)
+	{
+		// JMP 0, quit once loaded
+		auto err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			machine_->PostInterrupt(ISR::Quit);
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://wwAA","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+
+		std::error_code loadErr;
+		std::thread::id errThread;
+
+		err = machine_->OnError([&loadErr, &errThread](std::error_code ec, [[maybe_unused]] const char* fileName, [[maybe_unused]] const char* functionName, [[maybe_unused]] uint32_t line, [[maybe_unused]] uint32_t column, IController* ioController)
+		{
+			loadErr = ec;
+			errThread = std::this_thread::get_id();
+			ioController->Write(0xFF, 0, nullptr);
+		});
+		EXPECT_FALSE(err);
+
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu")"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		err = machine_->SetOptions(R"(json://{"loadAsync":true})");
+		EXPECT_FALSE(err);
+
+		auto controller = machine_->DetachIoController();
+		ASSERT_TRUE(controller);
+		controller.value()->Write(0xFD, 0, nullptr);
+		err = machine_->AttachIoController(std::move(controller.value()));
+		EXPECT_FALSE(err);
+
+		// The state is decoded on the loader thread, the decode error is reported on the machine thread
+		ex = machine_->Run();
+		EXPECT_TRUE(ex);
+		EXPECT_EQ(errc::json_parse, loadErr.value());
+		EXPECT_EQ(std::this_thread::get_id(), errThread);
+	}
+
+	TEST_F(MachineTest, CpmDiskController)
+	{
+		using Port = CpmDiskController::Port;
+		using Status = CpmDiskController::Status;
+
+		const auto& geometry = CpmDiskController::ibm3740;
+		auto path = std::filesystem::temp_directory_path() / "meen_test.dsk";
+		std::vector<uint8_t> image(geometry.tracks * geometry.sectors * geometry.sectorSize);
+
+		// Fill each sector with its index
+		for (size_t i = 0; i < image.size(); i++)
+		{
+			image[i] = static_cast<uint8_t>(i / geometry.sectorSize);
+		}
+
+		std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+
+		CpmDiskController disk;
+		MemoryController memoryController;
+
+		EXPECT_EQ(errc::invalid_argument, disk.Mount(CpmDiskController::MaxDrives, path.c_str(), geometry).value());
+		EXPECT_EQ(errc::invalid_argument, disk.Mount(0, path.c_str(), CpmDiskController::hd4Mb).value());
+		// The track and sector ports can not address these
+		EXPECT_EQ(errc::invalid_argument, disk.Mount(0, path.c_str(), { 257, 1, 128, 0 }).value());
+		EXPECT_EQ(errc::invalid_argument, disk.Mount(0, path.c_str(), { 1, 256, 128, 1 }).value());
+		EXPECT_EQ(errc::io_controller, disk.Mount(0, "meen_test_missing.dsk", geometry).value());
+		ASSERT_FALSE(disk.Mount(0, path.c_str(), geometry));
+		ASSERT_FALSE(disk.Mount(1, path.c_str(), geometry, true));
+
+		// The controller is attached to ports 20h to 27h
+		auto out = [&disk, &memoryController](Port port, uint8_t value)
+		{
+			disk.Write(0x20 + static_cast<uint8_t>(port), value, &memoryController);
+		};
+
+		auto status = [&disk]()
+		{
+			return static_cast<Status>(disk.Read(0x20 + static_cast<uint8_t>(Port::Status), nullptr));
+		};
+
+		// Read the last 2 sectors of track 0 and the first sector of track 1 into 1000h
+		out(Port::Drive, 0);
+		out(Port::Track, 0);
+		out(Port::Sector, 25);
+		out(Port::Count, 3);
+		out(Port::DmaLo, 0x00);
+		out(Port::DmaHi, 0x10);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Read));
+		EXPECT_EQ(Status::Ok, status());
+		EXPECT_EQ(24, memoryController.Read(0x1000, nullptr));
+		EXPECT_EQ(25, memoryController.Read(0x10FF, nullptr));
+		EXPECT_EQ(26, memoryController.Read(0x1100, nullptr));
+
+		// Write them to the start of track 2
+		out(Port::Track, 2);
+		out(Port::Sector, 1);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Write));
+		EXPECT_EQ(Status::Ok, status());
+
+		out(Port::Track, 77);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Read));
+		EXPECT_EQ(Status::BadTrack, status());
+		out(Port::Track, 76);
+		out(Port::Sector, 0);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Read));
+		EXPECT_EQ(Status::BadSector, status());
+		// The transfer runs past the end of the disk
+		out(Port::Sector, 26);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Read));
+		EXPECT_EQ(Status::BadSector, status());
+		out(Port::Drive, 1);
+		out(Port::Track, 0);
+		out(Port::Sector, 1);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Write));
+		EXPECT_EQ(Status::ReadOnly, status());
+		out(Port::Drive, 2);
+		out(Port::Command, static_cast<uint8_t>(CpmDiskController::Command::Read));
+		EXPECT_EQ(Status::NoDrive, status());
+
+		EXPECT_FALSE(disk.Unmount(0));
+		EXPECT_FALSE(disk.Unmount(1));
+		EXPECT_EQ(errc::invalid_argument, disk.Unmount(0).value());
+
+		std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(image.data()), image.size());
+		auto track2 = 2 * geometry.sectors * geometry.sectorSize;
+		EXPECT_EQ(24, image[track2]);
+		EXPECT_EQ(25, image[track2 + geometry.sectorSize]);
+		EXPECT_EQ(26, image[track2 + 2 * geometry.sectorSize]);
+		EXPECT_EQ(55, image[track2 + 3 * geometry.sectorSize]);
+		std::filesystem::remove(path);
+	}
+#endif // __linux__
+
+	TEST_F(MachineTest, MemoryProfile)
+	{
+		auto err = machine_->SetOptions(R"(json://{"memoryProfile":"bad"})");
+		EXPECT_EQ(errc::json_config, err.value());
+		err = machine_->SetOptions(R"(json://{"memoryProfile":"page"})");
+		EXPECT_FALSE(err);
+
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+
+		uint64_t stackWrites = 0;
+		uint64_t programFetches = 0;
+
+		err = machine_->MemoryProfile([&](uint16_t address, [[maybe_unused]] uint64_t reads, uint64_t writes, uint64_t fetches)
+		{
+			EXPECT_EQ(0, address & 0xFF);
+
+			// The stack resides in the page below the initial stack pointer (1981)
+			if (address == 0x0700)
+			{
+				stackWrites = writes;
+			}
+			else if (address == 0x0100)
+			{
+				programFetches = fetches;
+			}
+		});
+		EXPECT_FALSE(err);
+		EXPECT_LT(0, stackWrites);
+		EXPECT_LT(0, programFetches);
+
+		err = machine_->SetOptions(R"(json://{"memoryProfile":"address"})");
+		EXPECT_FALSE(err);
+
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+
+		uint64_t bdosFetches = 0;
+
+		err = machine_->MemoryProfile([&bdosFetches](uint16_t address, [[maybe_unused]] uint64_t reads, [[maybe_unused]] uint64_t writes, uint64_t fetches)
+		{
+			if (address == 0x0005)
+			{
+				bdosFetches = fetches;
+			}
+		});
+		EXPECT_FALSE(err);
+		// Two messages are printed via the CP/M BDOS entry point
+		EXPECT_EQ(2, bdosFetches);
+
+		// Clear the error handler registered by RunTestSuite, it treats all errors as failures
+		err = machine_->OnError(nullptr);
+		EXPECT_FALSE(err);
+		err = machine_->MemoryProfile(nullptr);
+		EXPECT_EQ(errc::invalid_argument, err.value());
+	}
+
+	TEST_F(MachineTest, DirectMemoryAccess)
+	{
+		CpmConsoleController console;
+		int readHits = 0;
+
+		auto err = machine_->AttachIoController(IControllerPtr(&console, ControllerDeleter(false)), 0x00, 0x02, 0);
+		EXPECT_FALSE(err);
+		err = machine_->SetOptions(R"(json://{"memoryProfile":"address"})");
+		EXPECT_FALSE(err);
+		err = machine_->ArmWatchpoint(0x0020, Watch::Read);
+		EXPECT_FALSE(err);
+		err = machine_->OnWatch([&readHits]([[maybe_unused]] uint16_t address, [[maybe_unused]] Watch watch, [[maybe_unused]] IController* ioController)
+		{
+			readHits++;
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		// MVI A,09h; OUT 00h; MVI A,00h; OUT 01h; MVI A,20h; OUT 02h; OUT FFh; HLT - BDOS function 9 prints the string at 20h
+		err = machine_->OnLoad([](char* json, int* jsonLen, [[maybe_unused]] IController* ioController)
+		{
+			return LoadProgram(json, jsonLen, R"(json://{{"cpu":{{"pc":0}},"memory":{{"rom":{{"bytes":"base64://PgnTAD4A0wE+INMC0/92AAAAAAAAAAAAAAAAAAAAAABIaSQ=","offset":0}}}}}})"sv);
+		}, nullptr);
+		EXPECT_FALSE(err);
+
+		auto ex = machine_->Run();
+		EXPECT_TRUE(ex);
+
+		auto output = console.Output();
+		EXPECT_EQ("Hi", std::string(output.begin(), output.end()));
+
+		// The console reads the string directly from the memory controller, it is not a cpu access
+		uint64_t stringReads = 0;
+
+		err = machine_->MemoryProfile([&stringReads](uint16_t address, uint64_t reads, [[maybe_unused]] uint64_t writes, [[maybe_unused]] uint64_t fetches)
+		{
+			if (address >= 0x0020 && address <= 0x0022)
+			{
+				stringReads += reads;
+			}
+		});
+		EXPECT_FALSE(err);
+		EXPECT_EQ(0, stringReads);
+		EXPECT_EQ(0, readHits);
+
+		err = machine_->DisarmWatchpoint(0x0020, Watch::Read);
+		EXPECT_FALSE(err);
+		EXPECT_TRUE(machine_->DetachIoController(0x00));
+	}
+
+	TEST_F(MachineTest, Watchpoints)
+	{
+		int execHits = 0;
+		int writeHits = 0;
+
+		// The CP/M BDOS entry point and the byte below the initial stack
+		auto err = machine_->ArmWatchpoint(0x0005, Watch::Exec);
+		EXPECT_FALSE(err);
+		err = machine_->ArmWatchpoint(1980, Watch::Write);
+		EXPECT_FALSE(err);
+		err = machine_->ArmWatchpoint(0x0000, static_cast<Watch>(3));
+		EXPECT_EQ(errc::invalid_argument, err.value());
+
+		err = machine_->OnWatch([&](uint16_t address, Watch watch, [[maybe_unused]] IController* ioController)
+		{
+			if (watch == Watch::Exec)
+			{
+				EXPECT_EQ(0x0005, address);
+				execHits++;
+			}
+			else
+			{
+				EXPECT_EQ(Watch::Write, watch);
+				EXPECT_EQ(1980, address);
+				writeHits++;
+			}
+
+			return false;
+		});
+		EXPECT_FALSE(err);
+
+		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+		EXPECT_EQ(2, execHits);
+		EXPECT_LT(0, writeHits);
+
+		err = machine_->DisarmWatchpoint(0x0005, Watch::Exec);
+		EXPECT_FALSE(err);
+		err = machine_->DisarmWatchpoint(1980, Watch::Write);
+		EXPECT_FALSE(err);
+
+		// No watchpoints are armed, the handler must not be called
+		execHits = 0;
+		writeHits = 0;
 		RunTestSuite("TST8080.COM", R"({"uuid":"base64://O+hPH516S3ClRdnzSRL8rQ==","registers":{"a":170,"b":170,"c":9,"d":170,"e":170,"h":170,"l":170,"s":86},"pc":5,"sp":1981})", "CPU IS OPERATIONAL", 74);
+		EXPECT_EQ(0, execHits);
+		EXPECT_EQ(0, writeHits);
 	}
 
 	TEST_F(MachineTest, 8080Pre)
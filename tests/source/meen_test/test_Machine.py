@@ -24,9 +24,13 @@ import re
 import sys
 import unittest
 
+from datetime import timedelta
 from meen_py import __version__
+from meen_py import Command
 from meen_py import ErrorCode
+from meen_py import ISR
 from meen_py import Make8080Machine
+from meen_py import Watch
 
 # Import Python controller modules (a port of the c++ modules are available below)
 # Always use the c++ memory controller module for performance reasons, the python module is available strictly for demonstration purposes
@@ -246,6 +250,191 @@ class MachineTest(unittest.TestCase):
         err = self.machine.OnInit(None)
         self.assertEqual(err, ErrorCode.NoError)
 
+    def LoadProgram(self, program, offset):
+        # Write to the 'load device', the value doesn't matter (use 0)
+        self.testIoController.Write(0xFD, 0, None)
+        err = self.machine.OnLoad(lambda ioc: r'json://{"cpu":{"pc":' + str(offset) + r',"sp":' + str(offset) + r'},"memory":{"rom":{"bytes":"' + program + r'","offset":' + str(offset) + r'}}}', None)
+        self.assertEqual(err, ErrorCode.NoError)
+
+    def test_MapIoPort(self):
+        values = []
+
+        err = self.machine.MapIoPort(0x10, None, None)
+        self.assertEqual(err, ErrorCode.InvalidArgument)
+        err = self.machine.MapIoPort(0x10, None, lambda port, value: values.append(value))
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.MapIoPort(0x11, lambda port: 0x33, None)
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # MVI A,5Ah; OUT 10h; IN 11h; OUT 10h; OUT FFh; HLT
+        self.LoadProgram('base64://PlrTENsR0xDT/3Y=', 0)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertEqual([0x5A, 0x33], values)
+
+        for port in range(0x10, 0x12):
+            err = self.machine.UnmapIoPort(port)
+            self.assertEqual(err, ErrorCode.NoError)
+
+    def test_RunFor(self):
+        values = []
+
+        err = self.machine.MapIoPort(0x10, None, lambda port, value: values.append(value))
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # 25 cycles per iteration - INR A; OUT 10h; JMP 0
+        self.LoadProgram('base64://PNMQwwAA', 0)
+        self.assertTrue(self.machine.RunFor(250))
+        self.assertGreater(len(values), 0)
+
+        # The machine is busy while the run is suspended
+        err = self.machine.SetOptions(r'json://{"isrFreq":1}')
+        self.assertEqual(err, ErrorCode.Busy)
+
+        # Each call resumes where the last one stopped
+        count = len(values)
+        self.assertTrue(self.machine.RunFor(timedelta(microseconds=125)))
+        self.assertGreater(len(values), count)
+
+        # Quit the suspended run
+        err = self.machine.PostInterrupt(ISR.Quit)
+        self.assertEqual(err, ErrorCode.NoError)
+        self.assertFalse(self.machine.RunFor(250))
+
+    def test_PostCommand(self):
+        command = Command()
+        command.type = Command.Type.Interrupt
+        command.isr = ISR.NoInterrupt
+        err = self.machine.PostCommand(command)
+        self.assertEqual(err, ErrorCode.InvalidArgument)
+        err = self.machine.PostInterrupt(ISR.NoInterrupt)
+        self.assertEqual(err, ErrorCode.InvalidArgument)
+
+        # A program that never exits on its own: JMP 0x0000
+        self.LoadProgram('base64://wwAA', 0)
+
+        command.type = Command.Type.ClockSamplingFreq
+        command.clockSamplingFreq = -1
+        err = self.machine.PostCommand(command)
+        self.assertEqual(err, ErrorCode.NoError)
+        command.type = Command.Type.Quit
+        err = self.machine.PostCommand(command)
+        self.assertEqual(err, ErrorCode.NoError)
+        # The queued quit ends the run
+        self.assertGreaterEqual(self.machine.Run(), 0)
+
+    def test_PauseResume(self):
+        # A pause requested while the machine is not running is dropped when the next run starts
+        err = self.machine.Pause()
+
+        if err == ErrorCode.NotImplemented:
+            self.skipTest("Machine.Pause is not supported")
+
+        self.assertEqual(err, ErrorCode.NoError)
+        self.LoadProgram('base64://wwAA', 0)
+        self.idleCount = 0
+
+        def OnIdle(ioController):
+            self.idleCount += 1
+
+            if self.idleCount == 1:
+                self.assertEqual(self.machine.Pause(), ErrorCode.NoError)
+            elif self.idleCount == 2:
+                self.assertEqual(self.machine.Resume(), ErrorCode.NoError)
+
+            return self.idleCount > 2
+
+        err = self.machine.OnIdle(OnIdle)
+        self.assertEqual(err, ErrorCode.NoError)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertGreater(self.idleCount, 2)
+
+    def test_InterruptMask(self):
+        err = self.machine.SetInterruptMask(0xFE)
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.SetInterruptPriority(ISR.Three)
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.SetInterruptPriority(ISR.Load)
+        self.assertEqual(err, ErrorCode.InvalidArgument)
+
+    def test_OnTrap(self):
+        values = []
+
+        def OnTrap(registers, memoryController):
+            self.assertEqual(0x0103, registers.pc)
+            registers.a = 0x42
+            return 0
+
+        err = self.machine.OnTrap(0x0005, OnTrap)
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.MapIoPort(0x10, None, lambda port, value: values.append(value))
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # CALL 0005h; OUT 10h; OUT FFh; HLT - the trap runs in place of the call and its register changes are written back to the cpu
+        self.LoadProgram('base64://zQUA0xDT/3Y=', 256)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertEqual([0x42], values)
+        err = self.machine.OnTrap(0x0005, None)
+        self.assertEqual(err, ErrorCode.NoError)
+
+    def test_OnWatch(self):
+        hits = []
+
+        err = self.machine.ArmWatchpoint(0x0080, Watch.Write)
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.ArmWatchpoint(0x0100, Watch.Exec)
+        self.assertEqual(err, ErrorCode.NoError)
+
+        def OnWatch(address, watch, ioController):
+            hits.append((address, watch))
+            return False
+
+        err = self.machine.OnWatch(OnWatch)
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # MVI A,5Ah; STA 0080h; OUT FFh; HLT
+        self.LoadProgram('base64://PloygADT/3Y=', 256)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertCountEqual([(0x0100, Watch.Exec), (0x0080, Watch.Write)], hits)
+
+        err = self.machine.DisarmWatchpoint(0x0080, Watch.Write)
+        self.assertEqual(err, ErrorCode.NoError)
+        err = self.machine.DisarmWatchpoint(0x0100, Watch.Exec)
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # No watchpoints are armed, the handler must not be called
+        hits.clear()
+        self.LoadProgram('base64://PloygADT/3Y=', 256)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertEqual([], hits)
+        err = self.machine.OnWatch(None)
+        self.assertEqual(err, ErrorCode.NoError)
+
+    def test_MemoryProfile(self):
+        err = self.machine.SetOptions(r'json://{"memoryProfile":"address"}')
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # MVI A,5Ah; STA 0080h; OUT FFh; HLT
+        self.LoadProgram('base64://PloygADT/3Y=', 256)
+        self.assertGreater(self.machine.Run(), 0)
+
+        profile = { address: (reads, writes, fetches) for address, reads, writes, fetches in self.machine.MemoryProfile() }
+        self.assertEqual((0, 1, 0), profile[0x0080])
+        self.assertEqual((0, 0, 1), profile[0x0100])
+
+    def test_AttachIoControllerPortRange(self):
+        portRangeController = TestIoController()
+        err = self.machine.AttachIoController(portRangeController, 0x20, 0x10, 0)
+        self.assertEqual(err, ErrorCode.InvalidArgument)
+        err = self.machine.AttachIoController(portRangeController, 0x00, 0x0F, 0)
+        self.assertEqual(err, ErrorCode.NoError)
+
+        # MVI A,5Ah; OUT 00h; OUT FFh; HLT - the port 0 write is routed to the controller attached to port range 00h - 0Fh
+        self.LoadProgram('base64://PlrTANP/dg==', 0)
+        self.assertGreater(self.machine.Run(), 0)
+        self.assertEqual(0x5A, portRangeController.Read(0x00, None))
+        # The default io controller did not see the write
+        self.assertEqual(0xAA, self.testIoController.Read(0x00, None))
+
 class i8080Test(unittest.TestCase):
     def setUp(self):
         self.programsDir = MachineTestDeps.programsDir
@@ -32,14 +32,16 @@ namespace meen
 
 	uint8_t CpmIoController::Read([[maybe_unused]] uint16_t deviceNumber, [[maybe_unused]] IController* controller)
 	{
-		if (output_.empty() == true)
+		auto output = console_.Output();
+
+		if (output.empty() == true)
 		{
 			return 0x04; // ascii end of transmission
 		}
 		else
 		{
-			auto byte = output_.front();
-			output_.pop_front();
+			auto byte = output.front();
+			console_.Consume(1);
 			return byte;
 		}
 	}
@@ -49,41 +51,10 @@ namespace meen
 		switch (deviceNumber)
 		{
 			case 0:
-			{
-				printMode_ = value;
-				break;
-			}
 			case 1:
-			{
-				addrHi_ = value;
-				break;
-			}
 			case 2:
 			{
-				switch (printMode_)
-				{
-					case 9:
-					{
-						uint16_t addr = (addrHi_ << 8) | value;
-						uint8_t aChar = memoryController->Read(addr, nullptr);
-
-						while (aChar != '$')
-						{
-							output_.push_back(aChar);
-							aChar = memoryController->Read(++addr, nullptr);
-						}
-						break;
-					}
-					case 2:
-					{
-						output_.push_back(value);
-						break;
-					}
-					default:
-					{
-						//assert(0);
-					}
-				}
+				console_.Write(deviceNumber, value, memoryController);
 				break;
 			}
 			default:
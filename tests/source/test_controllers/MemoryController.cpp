@@ -50,11 +50,23 @@ namespace meen
 	void MemoryController::Write(uint16_t addr, uint8_t data, [[maybe_unused]] IController* controller)
 	{
 		memory_[addr] = data;
+		dirtyPages_[addr >> 8] = true;
 	}
 
 	void MemoryController::Clear()
 	{
 		memory_.assign(memory_.size(), 0);
+		dirtyPages_.set();
+	}
+
+	DirtyPageMap* MemoryController::DirtyPages()
+	{
+		return &dirtyPages_;
+	}
+
+	std::span<uint8_t> MemoryController::Memory()
+	{
+		return memory_;
 	}
 
 	ISR MemoryController::GenerateInterrupt([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles, [[maybe_unused]] IController* controller)
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2021-2025 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "meen/IScheduler.h"
+#include "test_controllers/ScheduledIoController.h"
+
+namespace meen
+{
+	std::array<uint8_t, 16> ScheduledIoController::Uuid() const
+	{
+		return{ 0x4B, 0x1E, 0x93, 0x07, 0xC2, 0x5D, 0x4A, 0x61, 0x9F, 0x28, 0x7C, 0xE4, 0x33, 0xA0, 0x56, 0xD9 };
+	}
+
+	uint8_t ScheduledIoController::Read([[maybe_unused]] uint16_t deviceNumber, [[maybe_unused]] IController* controller)
+	{
+		return 0x00;
+	}
+
+	void ScheduledIoController::Write(uint16_t deviceNumber, uint8_t value, IController* controller)
+	{
+		BaseIoController::Write(deviceNumber, value, controller);
+
+		// The signal ports, have the machine poll us at the next instruction boundary
+		if (scheduler_ != nullptr && deviceNumber >= 0xFD && deviceNumber <= 0xFF)
+		{
+			scheduler_->Wake();
+		}
+	}
+
+	ISR ScheduledIoController::GenerateInterrupt(uint64_t currTime, uint64_t cycles, IController* controller)
+	{
+		nextPoll_ = currTime + 1000000000; // 1 second in nanos
+		return BaseIoController::GenerateInterrupt(currTime, cycles, controller);
+	}
+
+	void ScheduledIoController::SetScheduler(IScheduler* scheduler)
+	{
+		scheduler_ = scheduler;
+
+		if (scheduler != nullptr && saveCycle_ >= 0)
+		{
+			scheduler->Schedule(saveCycle_, ISR::Save);
+		}
+	}
+
+	uint64_t ScheduledIoController::NextPoll([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles)
+	{
+		return nextPoll_;
+	}
+
+	void ScheduledIoController::ScheduleSaveOn(int64_t cycleCount)
+	{
+		saveCycle_ = cycleCount;
+	}
+} // namespace meen